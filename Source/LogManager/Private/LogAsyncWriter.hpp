@@ -11,128 +11,1236 @@
 #include "HAL/Event.h"
 #include "HAL/PlatformTime.h"
 #include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTLS.h"
 #include "HAL/PlatformOutputDevices.h"
-#include "HAL/Runnable.h"
-#include "HAL/RunnableThread.h"
 #include "HAL/ThreadSafeCounter.h"
 #include "Serialization/Archive.h"
 
-class FLogAsyncWriter : public FRunnable, public FArchive
+#include "LogBinaryFormat.h"
+#include "LogIndexFormat.h"
+#include "LogIOScheduler.h"
+#include "LogLineFormatter.hpp"
+#include "LogLineRecord.hpp"
+#include "LogOverflowQueue.hpp"
+#include "LogRateLimiter.hpp"
+#include "LogRepeatTable.hpp"
+#include "LogRingBuffer.hpp"
+#include "LogRotatingArchive.h"
+#include "LogStagingBuffer.hpp"
+#include "LogWriterCounters.hpp"
+#include "LogWriterSettings.hpp"
+
+class FLogAsyncWriter : public FArchive
 {
     enum EConstants
     {
-        InitialBufferSize = 128 * 1024
-    };
+        StagingBufferSize = 16 * 1024,
+        /** Minimum time between two "lines dropped" markers */
+        DropReportIntervalSec = 1
+    };
+
+    /** How far the writer has to get before everything queued at some point has been written */
+    struct FFlushTarget
+    {
+        /** Ring buffer position that has to be released */
+        int64 ReleasePos;
+        /** Flush request that has to be completed */
+        int32 FlushRequest;
+        /** Number of overflow queue drains that have to be done */
+        int32 OverflowDrain;
+    };
+
+    /** A client waiting for the writer to get somewhere, its event is triggered once all targets are reached */
+    struct FFlushWaiter
+    {
+        FFlushTarget Target;
+        /** Every durable flush with a ticket up to this one has to be on disk, 0 for none */
+        int64 TargetTicket;
+        FEvent* Event;
+    };
+
+    /** Shared I/O threads serializing the ring buffer to disk, nullptr if the platform doesn't support multithreading */
+    FLogIOScheduler* Scheduler;
+    /** The I/O thread serving this writer */
+    FLogIOWorker* IOWorker;
+    /** [CLIENT/WRITER THREAD] Set once the I/O thread has been woken up for new data, cleared when it starts a pass */
+    volatile int32 bWakeupPending;
+    /** [CLIENT/WRITER THREAD] Clients blocked in FlushBuffer or on a full ring buffer, guarded by FlushWaitersCritical */
+    TArray<FFlushWaiter> FlushWaiters;
+    /** [CLIENT/WRITER THREAD] Sync object for the FlushWaiters array */
+    FCriticalSection FlushWaitersCritical;
+    /**
+     * [CLIENT/WRITER THREAD] Asynchronous flushes, merged into one: the highest ticket requested and how far the writer has to
+     * get for every request so far, each raised with a CAS max. Complete once the target is reached and the archive flushed.
+     */
+    volatile int64 RequestedFlushTicket;
+    volatile int64 DurableReleasePos;
+    volatile int32 DurableFlushRequest;
+    volatile int32 DurableOverflowDrain;
+    /** [CLIENT/WRITER THREAD] Every durable flush with a ticket up to this one is on disk */
+    volatile int64 CompletedFlushTicket;
+    /** [CLIENT/WRITER THREAD] Set when a durable flush is requested, cleared by the writer when it takes the target */
+    volatile int32 bDurableFlushPending;
+
+    /** Writer archive, owned by the writer */
+    FLogRotatingArchive* Ar;
+    /** [CLIENT/WRITER THREAD] Lock-free data ring buffer, clients reserve and commit, the writer consumes */
+    FLogRingBuffer Buffer;
+    /** [CLIENT/WRITER THREAD] Guards the archive. Held by the writer while serializing and by clients flushing the archive. */
+    FCriticalSection ArchiveCritical;
+
+    /** [WRITER THREAD] Whether data was written to the archive since it was last flushed. Guarded by ArchiveCritical. */
+    bool bArchiveDirty;
+
+    /** [CLIENT THREAD] What to do with a line when the ring buffer is full */
+    ELogBackpressure::Type BackpressurePolicy;
+    /** [CLIENT THREAD] How long the Block policy waits for room before dropping the line */
+    uint32 BlockTimeoutMs;
+    /** [CLIENT/WRITER THREAD] Records spilled over by the Grow policy */
+    FLogOverflowQueue Overflow;
+    /** [WRITER THREAD] Records taken from the overflow queue in the current pass */
+    TArray<uint8> DrainedOverflow;
+    /** [CLIENT/WRITER THREAD] Lines dropped since the last "lines dropped" marker */
+    volatile int32 DroppedLines;
+    /** [CLIENT/WRITER THREAD] FPlatformTime::Cycles64 of the last "lines dropped" marker, a reporter claims the next window with a CAS */
+    volatile int64 LastDropReportCycles;
+    /** [CLIENT THREAD] Rate limit and sampling applied before lines are formatted, rejected lines are reported with the dropped ones */
+    FLogRateLimiter RateLimiter;
+    /** [CLIENT/WRITER THREAD] Telemetry, see ILogManager::GetWriterStats */
+    FLogWriterCounters Counters;
+
+    /** Whether clients stage their lines in per-thread buffers and hand them over in batches (-LOGTHREADSTAGING) */
+    bool bUseStaging;
+    /** [CLIENT THREAD] Staged bytes that trigger a hand-off to the writer */
+    int32 StagingBatchSize;
+    /** [CLIENT/WRITER THREAD] Maximum time a line may stay staged before it's handed off or stolen by the writer */
+    double StagingBatchIntervalSec;
+    /** TLS slot holding the calling thread's staging buffer for this writer */
+    uint32 StagingTlsSlot;
+    /** [CLIENT/WRITER THREAD] Every staging buffer created for this writer, guarded by StagingCritical */
+    TArray<FLogStagingBuffer*> StagingBuffers;
+    /** [CLIENT/WRITER THREAD] Sync object for the StagingBuffers array */
+    FCriticalSection StagingCritical;
+    /** [CLIENT THREAD] Next line sequence number, defines the output order across threads */
+    volatile int64 LineSequence;
+    /** [CLIENT/WRITER THREAD] Number of flush requests made by clients */
+    FThreadSafeCounter FlushRequestCounter;
+    /** [CLIENT/WRITER THREAD] Number of flush requests completed by the writer */
+    FThreadSafeCounter FlushCompletedCounter;
+    /** [WRITER THREAD] Lines held back until every line before them has arrived, plus lines stolen from staging buffers */
+    TArray<uint8> PendingLines;
+    /** [WRITER THREAD] Scratch storage used while merging batches */
+    TArray<uint8> NextPendingLines;
+    /** [WRITER THREAD] Scratch array of the lines merged in one pass */
+    TArray<FLogStagedLine> MergedLines;
+
+    /** Whether clients queue raw FLogLineRecords and the writer thread formats them (-LOGDEFERFORMAT) */
+    bool bDeferFormatting;
+    /** Whether clients queue an FLogLineTag ahead of each formatted line, so the writer indexes lines without parsing the text back */
+    bool bTagLines;
+    /** Millisecond aligned ticks FLogLineTag times are relative to */
+    int64 TagBaseTicks;
+    /** [WRITER THREAD] Frame counter of the last tag read, the frames of the next tags are restored near it */
+    uint64 LastTagFrame;
+    /** [WRITER THREAD] Encoding buffer for deferred records, only grows so steady state logging doesn't allocate */
+    TArray<uint8> EncodeScratch;
+
+    /** Whether the file holds FLogBinaryFormat records instead of text, implies deferred formatting */
+    bool bBinary;
+    /** [WRITER THREAD] Binary encoder of the current segment, guarded by ArchiveCritical */
+    FLogBinaryEncoder BinaryEncoder;
+    /** [WRITER THREAD] Segment BinaryEncoder is encoding for, a new segment starts a new dictionary */
+    int32 BinarySegmentIndex;
+
+    /** [WRITER THREAD] Sidecar index of the text file, nullptr if it isn't indexed. Guarded by ArchiveCritical. */
+    FLogIndexWriter* SidecarIndex;
+    /** [WRITER THREAD] Segment SidecarIndex is indexing, guarded by ArchiveCritical */
+    int32 SidecarSegmentIndex;
+
+    /** [CLIENT/WRITER THREAD] Last line of every category logged to this file and its repeats held back, nullptr unless -LOGCOALESCE is set */
+    FLogRepeatTable* Repeats;
+    /** Longest time repeats are held back */
+    double RepeatIntervalSec;
+
+    static FString GetRepeatMessage(int32 NumHeld)
+    {
+        return FString::Printf(TEXT("Previous message repeated %d times"), NumHeld);
+    }
+
+    /** Longest GetRepeatMessage */
+    static int32 GetMaxRepeatMessageLength()
+    {
+        return GetRepeatMessage(FLogRepeatTable::MaxHeld).Len();
+    }
+
+    /**
+     * [WRITER THREAD] Queues the repeat counts held back for RepeatIntervalSec behind everything queued so far, the way a
+     * client queues a line, so they are written after the line they repeat and in order with staged lines. Never waits
+     * for room: a count that doesn't fit stays held and is queued on a later pass.
+     */
+    void QueueDueRepeats()
+    {
+        const uint64 NowCycles = FPlatformTime::Cycles64();
+        const uint64 IntervalCycles = (uint64)(RepeatIntervalSec / FPlatformTime::GetSecondsPerCycle64());
+
+        for (int32 RunIndex = 0; RunIndex < Repeats->GetNumRuns(); ++RunIndex)
+        {
+            FLogHeldRepeats Held;
+            uint64 FirstHeldCycles = 0;
+            if (!Repeats->PeekHeld(RunIndex, Held, FirstHeldCycles) || NowCycles - FirstHeldCycles < IntervalCycles)
+            {
+                continue;
+            }
+
+            // Taken once it has somewhere to go, a client ending the run in the meantime wrote the count itself
+            auto FillRepeatLine = [this, RunIndex](uint8* Dest)
+            {
+                FLogHeldRepeats Taken;
+                if (!Repeats->TakeHeld(RunIndex, Taken))
+                {
+                    return FillEmptyLine(Dest);
+                }
+
+                const FString Message = GetRepeatMessage(Taken.NumHeld);
+                return FillLine(Dest, *Message, Message.Len(), (ELogVerbosity::Type)Taken.Verbosity, Taken.PrintedCategory,
+                    -1.0, FLogTimestampCache::NowTicks(), GFrameCounter, true);
+            };
+
+            const int64 MaxLength = GetMaxLineLength(Held.PrintedCategory, GetMaxRepeatMessageLength());
+            if (bUseStaging)
+            {
+                // Numbered after every line announced so far, the merge puts it behind the ones still staged
+                const int32 Offset = PendingLines.AddUninitialized(FLogStagingBuffer::GetLineSpan(MaxLength));
+                const int32 Span = FLogStagingBuffer::WriteLineWith(PendingLines.GetData() + Offset, NextSequence(), FillRepeatLine);
+                PendingLines.SetNum(Offset + Span, false);
+                continue;
+            }
+
+            // Lines spilling over have to be written first
+            FLogRingBuffer::FReservation Reservation;
+            if (Overflow.IsActive() || MaxLength > Buffer.GetMaxRecordLength() || !Buffer.Reserve((int32)MaxLength, Reservation))
+            {
+                break;
+            }
+            Reservation.Length = FillRepeatLine(Reservation.Data);
+            Buffer.Commit(Reservation);
+        }
+    }
+
+    /** Upper bound of the bytes FillLine writes for a message of MessageLength characters */
+    int64 GetMaxLineLength(const class FName& Category, int32 MessageLength) const
+    {
+        if (bDeferFormatting)
+        {
+            return FLogLineRecord::GetRecordLength(MessageLength * sizeof(TCHAR));
+        }
+
+        const int64 MaxEncodedLength = FLogLineFormatter::GetMaxEncodedLength(Category, MessageLength);
+        return bTagLines ? sizeof(FLogLineTag) + MaxEncodedLength : MaxEncodedLength;
+    }
+
+    /**
+     * Writes a line as queued: formatted as UTF-8, behind an FLogLineTag when the file is indexed, or as a raw
+     * record when formatting is deferred. Returns the bytes written.
+     */
+    int32 FillLine(uint8* Dest, const TCHAR* Data, int32 MessageLength, ELogVerbosity::Type Verbosity, const class FName& Category,
+        const double Time, int64 Ticks, uint64 FrameCounter, bool bLineTerminator) const
+    {
+        if (!bDeferFormatting)
+        {
+            int32 TagLength = 0;
+            if (bTagLines)
+            {
+                const FLogLineTag Tag = FLogLineTag::Make(TagBaseTicks, Ticks, FrameCounter, Verbosity);
+                FMemory::Memcpy(Dest, &Tag, sizeof(FLogLineTag));
+                TagLength = sizeof(FLogLineTag);
+            }
+            return TagLength + FLogLineFormatter::EncodeLogLine(Dest + TagLength, Verbosity, Category, Data, MessageLength, Ticks, FrameCounter, bLineTerminator);
+        }
+
+        FLogLineRecord* Record = (FLogLineRecord*)Dest;
+        Record->Ticks = Ticks;
+        Record->FrameCounter = FrameCounter;
+        Record->Category = Category;
+        Record->Time = Time;
+        Record->Verbosity = (uint8)Verbosity;
+
+        const int32 PayloadLength = MessageLength * sizeof(TCHAR);
+        Record->PayloadLength = PayloadLength;
+        Record->Flags = bLineTerminator ? FLogLineRecord::LineTerminator : 0;
+        FMemory::Memcpy(Record->GetPayload(), Data, PayloadLength);
+        return (int32)FLogLineRecord::GetRecordLength(PayloadLength);
+    }
+
+    /** Writes a queued line that writes nothing, for a slot reserved before knowing it would be needed. Returns the bytes written. */
+    int32 FillEmptyLine(uint8* Dest) const
+    {
+        if (!bDeferFormatting)
+        {
+            return 0;
+        }
+
+        FLogLineRecord* Record = (FLogLineRecord*)Dest;
+        FMemory::Memzero(Record, sizeof(FLogLineRecord));
+        Record->Flags = FLogLineRecord::Preformatted;
+        return (int32)FLogLineRecord::GetRecordLength(0);
+    }
+
+    /** [WRITER THREAD] Gets the binary encoder ready for a record of the current segment. Must be called with ArchiveCritical held. */
+    void BeginBinaryRecord()
+    {
+        if (Ar->GetSegmentIndex() != BinarySegmentIndex)
+        {
+            BinaryEncoder.Reset();
+            BinarySegmentIndex = Ar->GetSegmentIndex();
+        }
+        EncodeScratch.Reset();
+    }
+
+    /** [WRITER THREAD] Writes a line as a binary record. Must be called with ArchiveCritical held. */
+    void WriteBinaryLine(ELogVerbosity::Type Verbosity, const class FName& Category, const TCHAR* Message, int32 MessageLength,
+        int64 Ticks, uint64 FrameCounter, bool bLineTerminator)
+    {
+        BeginBinaryRecord();
+        BinaryEncoder.EncodeLine(EncodeScratch, Verbosity, Category, Message, MessageLength, Ticks, FrameCounter, bLineTerminator);
+        SerializeToArchive(EncodeScratch.GetData(), EncodeScratch.Num());
+        Ar->RotateIfDue();
+    }
+
+    /** [WRITER THREAD] Adds the line about to be written to the sidecar index. Must be called with ArchiveCritical held. */
+    void IndexLine(int64 Length, ELogVerbosity::Type Verbosity, int64 Ticks, uint64 FrameCounter)
+    {
+        if (Ar->GetSegmentIndex() != SidecarSegmentIndex)
+        {
+            SidecarSegmentIndex = Ar->GetSegmentIndex();
+            SidecarIndex->BeginFile(Ar->GetSegmentFilename());
+        }
+        SidecarIndex->AddLine(Ar->GetSegmentOffset(), Length, Verbosity, Ticks, FrameCounter);
+    }
+
+    /** [WRITER THREAD] Hands one line to the archive and counts it. Must be called with ArchiveCritical held. */
+    void SerializeToArchive(const uint8* Data, int64 Length)
+    {
+        Ar->Serialize((void*)Data, Length);
+        Counters.AddWrite(Length);
+    }
+
+    /** [CLIENT/WRITER THREAD] Flushes the archive, all the way to disk if bDurable, and times it. Must be called with ArchiveCritical held. */
+    void FlushArchiveLocked(bool bDurable)
+    {
+        const uint64 StartCycles = FPlatformTime::Cycles64();
+        if (bDurable)
+        {
+            Ar->Flush();
+        }
+        else
+        {
+            Ar->FlushBuffers();
+        }
+        if (SidecarIndex)
+        {
+            SidecarIndex->Flush();
+        }
+        Counters.AddArchiveFlush(FPlatformTime::Cycles64() - StartCycles);
+        bArchiveDirty = false;
+    }
+
+    /** [WRITER THREAD] Writes one queued line to the archive, formatting it first if it is a deferred record. Must be called with ArchiveCritical held. */
+    void WriteLinePayload(const uint8* Data, int32 Length)
+    {
+        // A repeat count slot a client beat the writer to
+        if (Length == 0)
+        {
+            return;
+        }
+
+        bArchiveDirty = true;
+
+        if (!bDeferFormatting)
+        {
+            if (bTagLines)
+            {
+                FLogLineTag Tag;
+                FMemory::Memcpy(&Tag, Data, sizeof(FLogLineTag));
+                Data += sizeof(FLogLineTag);
+                Length -= sizeof(FLogLineTag);
+
+                // Raw bytes aren't indexed, the block around them covers them
+                const ELogVerbosity::Type Verbosity = Tag.GetVerbosity();
+                if (Verbosity != ELogVerbosity::NoLogging)
+                {
+                    LastTagFrame = Tag.GetFrameCounter(LastTagFrame);
+                    IndexLine(Length, Verbosity, Tag.GetTicks(TagBaseTicks), LastTagFrame);
+                }
+            }
+            SerializeToArchive(Data, Length);
+            Ar->RotateIfDue();
+            return;
+        }
+
+        const FLogLineRecord* Record = (const FLogLineRecord*)Data;
+        if (Record->Flags & FLogLineRecord::Preformatted)
+        {
+            if (Record->PayloadLength == 0)
+            {
+                return;
+            }
+
+            if (bBinary)
+            {
+                BeginBinaryRecord();
+                BinaryEncoder.EncodeRaw(EncodeScratch, Record->GetPayload(), Record->PayloadLength);
+                SerializeToArchive(EncodeScratch.GetData(), EncodeScratch.Num());
+            }
+            else
+            {
+                // Raw bytes aren't indexed, the block around them covers them
+                SerializeToArchive(Record->GetPayload(), Record->PayloadLength);
+            }
+            Ar->RotateIfDue();
+            return;
+        }
+
+        const TCHAR* Message = (const TCHAR*)Record->GetPayload();
+        const int32 MessageLength = Record->PayloadLength / sizeof(TCHAR);
+
+        if (bBinary)
+        {
+            WriteBinaryLine((ELogVerbosity::Type)Record->Verbosity, Record->Category, Message, MessageLength,
+                Record->Ticks, Record->FrameCounter, (Record->Flags & FLogLineRecord::LineTerminator) != 0);
+            return;
+        }
+
+        const int32 MaxLength = FLogLineFormatter::GetMaxEncodedLength(Record->Category, MessageLength);
+        if (EncodeScratch.Num() < MaxLength)
+        {
+            EncodeScratch.SetNumUninitialized(MaxLength, false);
+            ++Counters.BufferResizes;
+        }
+
+        const int32 EncodedLength = FLogLineFormatter::EncodeLogLine(EncodeScratch.GetData(), (ELogVerbosity::Type)Record->Verbosity,
+            Record->Category, Message, MessageLength, Record->Ticks, Record->FrameCounter, (Record->Flags & FLogLineRecord::LineTerminator) != 0);
+        if (SidecarIndex)
+        {
+            IndexLine(EncodedLength, (ELogVerbosity::Type)Record->Verbosity, Record->Ticks, Record->FrameCounter);
+        }
+        SerializeToArchive(EncodeScratch.GetData(), EncodedLength);
+        Ar->RotateIfDue();
+    }
+
+    /**
+     * [WRITER THREAD] Serialize the contents of the ring buffer to disk
+     * @return true if anything was written
+     */
+    bool SerializeBufferToArchive()
+    {
+        if (bUseStaging)
+        {
+            return SerializeStagedLinesToArchive();
+        }
+
+        FScopeLock ArchiveLock(&ArchiveCritical);
+
+        bool bWroteData = false;
+        const uint8* RecordData = nullptr;
+        int32 RecordLength = 0;
+        while (Buffer.Peek(RecordData, RecordLength))
+        {
+            WriteLinePayload(RecordData, RecordLength);
+            Buffer.Pop();
+            bWroteData = true;
+
+            // Don't keep the producers waiting for space until the whole backlog is written
+            if (Buffer.GetUnreleasedSize() >= Buffer.GetCapacity() / 4)
+            {
+                Buffer.Release();
+            }
+        }
+        Buffer.Release();
+
+        // Lines only spill over once the ring buffer is full, so they come after everything written above
+        if (Overflow.Drain(DrainedOverflow))
+        {
+            FLogOverflowQueue::ForEachRecord(DrainedOverflow, [this](const uint8* Data, int32 Length)
+            {
+                WriteLinePayload(Data, Length);
+            });
+            bWroteData = true;
+        }
+
+        return bWroteData;
+    }
+
+    /**
+     * [WRITER THREAD] Merges the batches handed off by the clients, the lines stolen from idle staging buffers and
+     * the lines held back by previous passes, and serializes them in sequence order.
+     * A line is only written once no staging buffer can still hold a line with a smaller sequence number.
+     * @return true if anything was written
+     */
+    bool SerializeStagedLinesToArchive()
+    {
+        const int32 FlushRequests = FlushRequestCounter.GetValue();
+        const bool bForce = FlushRequests != FlushCompletedCounter.GetValue();
+
+        // Every line numbered below this has at least been announced in its staging buffer
+        const int64 SequenceLimit = LoadSequence();
+        int64 EmitLimit = SequenceLimit;
+        bool bCollectedAll = true;
+        {
+            FScopeLock StagingLock(&StagingCritical);
+
+            const uint64 NowCycles = FPlatformTime::Cycles64();
+            for (FLogStagingBuffer* Staging : StagingBuffers)
+            {
+                if (Staging->IsEmpty())
+                {
+                    continue;
+                }
+
+                const bool bStale = (NowCycles - Staging->GetFirstStagedCycles()) * FPlatformTime::GetSecondsPerCycle64() >= StagingBatchIntervalSec;
+                if (bForce || bStale)
+                {
+                    if (Staging->TryAcquire(FLogStagingBuffer::Stealing))
+                    {
+                        PendingLines.Append(Staging->GetData(), Staging->GetUsed());
+                        Staging->Reset();
+                        Staging->Release();
+                    }
+                    else
+                    {
+                        bCollectedAll = false;
+                    }
+                }
+            }
+
+            for (FLogStagingBuffer* Staging : StagingBuffers)
+            {
+                EmitLimit = FMath::Min(EmitLimit, Staging->GetFirstStagedSequence());
+            }
+        }
+
+        // A flush request is only complete once nothing numbered before it can be left behind
+        if (bForce && bCollectedAll)
+        {
+            EmitLimit = SequenceLimit;
+        }
+
+        MergedLines.Reset();
+        FLogStagingBuffer::ParseLines(PendingLines.GetData(), PendingLines.Num(), MergedLines);
+
+        const uint8* RecordData = nullptr;
+        int32 RecordLength = 0;
+        while (Buffer.Peek(RecordData, RecordLength))
+        {
+            FLogStagingBuffer::ParseLines(RecordData, RecordLength, MergedLines);
+            Buffer.Pop();
+        }
+
+        // Spilled over batches, DrainedOverflow stays untouched until the next pass
+        if (Overflow.Drain(DrainedOverflow))
+        {
+            FLogOverflowQueue::ForEachRecord(DrainedOverflow, [this](const uint8* Data, int32 Length)
+            {
+                FLogStagingBuffer::ParseLines(Data, Length, MergedLines);
+            });
+        }
+
+        MergedLines.Sort([](const FLogStagedLine& Lhs, const FLogStagedLine& Rhs)
+        {
+            return Lhs.Sequence < Rhs.Sequence;
+        });
+
+        bool bWroteData = false;
+        {
+            FScopeLock ArchiveLock(&ArchiveCritical);
+
+            for (const FLogStagedLine& Line : MergedLines)
+            {
+                if (Line.Sequence < EmitLimit)
+                {
+                    WriteLinePayload(Line.Data, Line.Length);
+                    bWroteData = true;
+                }
+                else
+                {
+                    const int32 Offset = NextPendingLines.AddUninitialized(FLogStagingBuffer::GetLineSpan(Line.Length));
+                    FLogStagingBuffer::WriteLine(NextPendingLines.GetData() + Offset, Line.Sequence, Line.Data, Line.Length);
+                }
+            }
+        }
+
+        // The merged lines may point into the ring buffer, only release it once they are written or copied
+        Buffer.Release();
+        Exchange(PendingLines, NextPendingLines);
+        NextPendingLines.Reset();
+
+        if (bForce && bCollectedAll)
+        {
+            FlushCompletedCounter.Set(FlushRequests);
+        }
+
+        return bWroteData;
+    }
+
+    /**
+     * [CLIENT THREAD] Gets how far the writer has to get to have written everything queued before the call.
+     * In staging mode the calling thread's staged lines are handed off and a flush request is made.
+     */
+    FFlushTarget MakeFlushTarget()
+    {
+        FFlushTarget Target{ 0, 0, 0 };
+        if (bUseStaging)
+        {
+            FLogStagingBuffer* Staging = GetThreadStagingBuffer();
+            AcquireStagingBuffer(Staging);
+            HandOffStagedLines(Staging);
+            Staging->Release();
+
+            Target.FlushRequest = FlushRequestCounter.Increment();
+        }
+        else
+        {
+            Target.ReleasePos = Buffer.GetReservePos();
+            Target.OverflowDrain = Overflow.GetDrainTarget();
+        }
+        return Target;
+    }
+
+    /** [CLIENT THREAD] Flush the memory buffer (doesn't force the archive to flush). Waits for every record reserved before the call. */
+    void FlushBuffer()
+    {
+        if (!Scheduler)
+        {
+            const int64 TargetPos = Buffer.GetReservePos();
+            if (Buffer.GetReleasePos() < TargetPos)
+            {
+                const uint64 StartCycles = FPlatformTime::Cycles64();
+                while (Buffer.GetReleasePos() < TargetPos)
+                {
+                    SerializeBufferToArchive();
+                }
+                Counters.AddFlushStall(FPlatformTime::Cycles64() - StartCycles);
+            }
+            return;
+        }
+
+        const FFlushTarget Target = MakeFlushTarget();
+        if (bUseStaging || Buffer.GetReleasePos() < Target.ReleasePos || Overflow.GetDrainCount() < Target.OverflowDrain)
+        {
+            const uint64 StartCycles = FPlatformTime::Cycles64();
+            WaitForWriter(Target, 0, MAX_uint32);
+            Counters.AddFlushStall(FPlatformTime::Cycles64() - StartCycles);
+        }
+    }
+
+    /** [CLIENT THREAD] Wakes the I/O thread if this is the first data queued since its last pass */
+    void NotifyWriter()
+    {
+        // Plain read first so a busy producer doesn't bounce the cache line. Commit was a full barrier,
+        // and the writer clears the flag before it looks at the queue, so no data is ever left unnoticed.
+        if (IOWorker && bWakeupPending == 0 && FPlatformAtomics::InterlockedExchange(&bWakeupPending, 1) == 0)
+        {
+            IOWorker->Wake();
+        }
+    }
+
+    /**
+     * [CLIENT THREAD] Blocks until the writer reached Target and has every durable flush up to TargetTicket on disk.
+     * @return false if WaitTimeMs ran out first
+     */
+    bool WaitForWriter(const FFlushTarget& Target, int64 TargetTicket, uint32 WaitTimeMs)
+    {
+        FEvent* Event = FPlatformProcess::GetSynchEventFromPool(false);
+        {
+            FScopeLock WaitersLock(&FlushWaitersCritical);
+            FlushWaiters.Add(FFlushWaiter{ Target, TargetTicket, Event });
+        }
+
+        IOWorker->Wake();
+        bool bCompleted = Event->Wait(WaitTimeMs);
+        if (!bCompleted)
+        {
+            FScopeLock WaitersLock(&FlushWaitersCritical);
+            const int32 Index = FlushWaiters.IndexOfByPredicate([Event](const FFlushWaiter& Waiter)
+            {
+                return Waiter.Event == Event;
+            });
+
+            if (Index != INDEX_NONE)
+            {
+                FlushWaiters.RemoveAtSwap(Index, 1, false);
+            }
+            else
+            {
+                // Completed right after the timeout, consume the trigger so the pooled event goes back reset
+                Event->Wait();
+                bCompleted = true;
+            }
+        }
+
+        FPlatformProcess::ReturnSynchEventToPool(Event);
+        return bCompleted;
+    }
+
+    /** Raises Value to NewValue unless it's already as high, returns the value it held before */
+    template<typename T>
+    static T InterlockedMax(volatile T* Value, T NewValue)
+    {
+        T Current = *Value;
+        while (Current < NewValue)
+        {
+            const T Previous = FPlatformAtomics::InterlockedCompareExchange(Value, NewValue, Current);
+            if (Previous == Current)
+            {
+                break;
+            }
+            Current = Previous;
+        }
+        return Current;
+    }
+
+    /** Lowers Value to NewValue unless it's already as low */
+    template<typename T>
+    static void InterlockedMin(volatile T* Value, T NewValue)
+    {
+        T Current = *Value;
+        while (Current > NewValue)
+        {
+            const T Previous = FPlatformAtomics::InterlockedCompareExchange(Value, NewValue, Current);
+            if (Previous == Current)
+            {
+                break;
+            }
+            Current = Previous;
+        }
+    }
+
+    /** Whether every durable flush requested with a ticket up to Ticket is on disk */
+    bool IsTicketFlushed(int64 Ticket) const
+    {
+        const int64 Requested = RequestedFlushTicket;
+        FPlatformMisc::MemoryBarrier();
+        return CompletedFlushTicket >= FMath::Min(Ticket, Requested);
+    }
+
+    /** [WRITER THREAD] Flushes the archive once the lines of every durable flush requested have been written, then wakes the clients whose targets have been reached */
+    void CompleteFlushWaiters()
+    {
+        const FFlushTarget Reached{ Buffer.GetReleasePos(), FlushCompletedCounter.GetValue(), Overflow.GetDrainCount() };
+
+        auto IsReached = [&Reached](const FFlushTarget& Target)
+        {
+            return Reached.ReleasePos >= Target.ReleasePos && Reached.FlushRequest >= Target.FlushRequest &&
+                Reached.OverflowDrain >= Target.OverflowDrain;
+        };
+
+        if (bDurableFlushPending && FPlatformAtomics::InterlockedExchange(&bDurableFlushPending, 0) != 0)
+        {
+            // Requests publish their target, then their ticket. Read backwards, a request whose target is missed here
+            // either raises the ticket past Requested, or lowers the completed ticket and fails the exchange below.
+            const int64 Completed = CompletedFlushTicket;
+            FPlatformMisc::MemoryBarrier();
+            const int64 Requested = RequestedFlushTicket;
+            FPlatformMisc::MemoryBarrier();
+            const FFlushTarget Target{ DurableReleasePos, DurableFlushRequest, DurableOverflowDrain };
+
+            if (IsReached(Target))
+            {
+                // One archive flush covers every request so far
+                {
+                    FScopeLock ArchiveLock(&ArchiveCritical);
+                    FlushArchiveLocked(true);
+                }
+                FPlatformAtomics::InterlockedCompareExchange(&CompletedFlushTicket, Requested, Completed);
+            }
+            else
+            {
+                // Lines still being written by their producers, tried again on the next pass
+                FPlatformAtomics::InterlockedExchange(&bDurableFlushPending, 1);
+            }
+        }
+
+        FScopeLock WaitersLock(&FlushWaitersCritical);
+
+        for (int32 Index = FlushWaiters.Num() - 1; Index >= 0; --Index)
+        {
+            const FFlushWaiter& Waiter = FlushWaiters[Index];
+            if (IsReached(Waiter.Target) && IsTicketFlushed(Waiter.TargetTicket))
+            {
+                Waiter.Event->Trigger();
+                FlushWaiters.RemoveAtSwap(Index, 1, false);
+            }
+        }
+    }
+
+    /**
+     * [CLIENT/WRITER THREAD] Writes "lines dropped" markers if lines were dropped by the backpressure policy, or rejected by
+     * the rate limit or sampling, and the last markers are old enough, or bForce is set
+     */
+    void ReportDroppedLines(bool bForce)
+    {
+        if (DroppedLines == 0 && !RateLimiter.HasRejectedLines())
+        {
+            return;
+        }
+
+        const int64 NowCycles = (int64)FPlatformTime::Cycles64();
+        if (bForce)
+        {
+            FPlatformAtomics::InterlockedExchange(&LastDropReportCycles, NowCycles);
+        }
+        else
+        {
+            // Only the thread moving the window on writes the markers, the others leave the counts to it
+            const int64 LastCycles = LastDropReportCycles;
+            if ((NowCycles - LastCycles) * FPlatformTime::GetSecondsPerCycle64() < DropReportIntervalSec ||
+                FPlatformAtomics::InterlockedCompareExchange(&LastDropReportCycles, NowCycles, LastCycles) != LastCycles)
+            {
+                return;
+            }
+        }
+
+        const int32 NumDropped = FPlatformAtomics::InterlockedExchange(&DroppedLines, 0);
+        if (NumDropped != 0)
+        {
+            FPlatformAtomics::InterlockedAdd(&Counters.DroppedLines, NumDropped);
+            WriteManagerLine(FString::Printf(TEXT("%d lines dropped by the %s backpressure policy"),
+                NumDropped, FLogWriterSettings::GetPolicyName(BackpressurePolicy)));
+        }
+
+        const int32 NumRejected = RateLimiter.TakeRejectedLines();
+        const int32 NumSampledOut = RateLimiter.TakeSampledOutLines();
+        if (NumRejected != 0 || NumSampledOut != 0)
+        {
+            FPlatformAtomics::InterlockedAdd(&Counters.RejectedLines, NumRejected);
+            FPlatformAtomics::InterlockedAdd(&Counters.SampledOutLines, NumSampledOut);
+            WriteManagerLine(FString::Printf(TEXT("%d lines rejected by the rate limit, %d lines sampled out"), NumRejected, NumSampledOut));
+        }
+    }
+
+    /** [CLIENT/WRITER THREAD] Writes a warning of the plugin itself straight to the archive */
+    void WriteManagerLine(const FString& Message)
+    {
+        static const FName LogManagerCategory(TEXT("LogManager"));
+
+        WriteDirectLine(ELogVerbosity::Warning, LogManagerCategory, Message);
+    }
+
+    /** [CLIENT/WRITER THREAD] Writes a line straight to the archive, after everything the writer has written so far */
+    void WriteDirectLine(ELogVerbosity::Type Verbosity, const class FName& Category, const FString& Message)
+    {
+        const int64 Ticks = FLogTimestampCache::NowTicks();
+        const uint64 FrameCounter = GFrameCounter;
+
+        if (bBinary)
+        {
+            FScopeLock ArchiveLock(&ArchiveCritical);
+            WriteBinaryLine(Verbosity, Category, *Message, Message.Len(), Ticks, FrameCounter, true);
+            bArchiveDirty = true;
+            return;
+        }
+
+        // A few times a second at most, a local buffer keeps this safe to call from any thread
+        TArray<uint8> Line;
+        Line.AddUninitialized(FLogLineFormatter::GetMaxEncodedLength(Category, Message.Len()));
+        const int32 LineLength = FLogLineFormatter::EncodeLogLine(Line.GetData(), Verbosity, Category,
+            *Message, Message.Len(), Ticks, FrameCounter, true);
+
+        FScopeLock ArchiveLock(&ArchiveCritical);
+        if (SidecarIndex)
+        {
+            IndexLine(LineLength, Verbosity, Ticks, FrameCounter);
+        }
+        SerializeToArchive(Line.GetData(), LineLength);
+        Ar->RotateIfDue();
+        bArchiveDirty = true;
+    }
+
+    /** [CLIENT THREAD] Counts lines lost to the backpressure policy, the writer reports them in the log */
+    void DropLines(int32 NumLines)
+    {
+        FPlatformAtomics::InterlockedAdd(&DroppedLines, NumLines);
+        NotifyWriter();
+    }
+
+    /** [CLIENT THREAD] Whether the DropLowestVerbosity policy sheds a line of this verbosity at the current ring buffer occupancy */
+    bool ShouldShedLine(ELogVerbosity::Type Verbosity) const
+    {
+        if (BackpressurePolicy != ELogBackpressure::DropLowestVerbosity || !Scheduler)
+        {
+            return false;
+        }
+
+        int32 MaxOccupancyPercent = 50;
+        switch (Verbosity & ELogVerbosity::VerbosityMask)
+        {
+        case ELogVerbosity::Fatal:
+        case ELogVerbosity::Error:
+            return false;
+        case ELogVerbosity::Warning:
+            MaxOccupancyPercent = 90;
+            break;
+        case ELogVerbosity::Display:
+        case ELogVerbosity::Log:
+            MaxOccupancyPercent = 75;
+            break;
+        default:
+            break;
+        }
 
-    /** Thread to run the worker FRunnable on. Serializes the ring buffer to disk. */
-    FRunnableThread* Thread;
-    /** Stops this thread */
-    FThreadSafeCounter StopTaskCounter;
+        const int64 Occupancy = Buffer.GetReservePos() - Buffer.GetReleasePos();
+        return Occupancy * 100 >= (int64)Buffer.GetCapacity() * MaxOccupancyPercent;
+    }
 
-    /** Writer archive */
-    FArchive& Ar;
-    /** Data ring buffer */
-    TArray<uint8> Buffer;
-    /** [WRITER THREAD] Position where the unserialized data starts in the buffer */
-    int32 BufferStartPos;
-    /** [CLIENT THREAD] Position where the unserialized data ends in the buffer (such as if (BufferEndPos > BufferStartPos) Length = BufferEndPos - BufferStartPos; */
-    int32 BufferEndPos;
-    /** [CLIENT THREAD] Sync object for the buffer pos */
-    FCriticalSection BufferPosCritical;
-    /** [CLIENT/WRITER THREAD] Outstanding serialize request counter. This is to make sure we flush all requests. */
-    FThreadSafeCounter SerializeRequestCounter;
+    /** [CLIENT THREAD] Writes a record too big for the ring buffer straight to the archive, behind everything queued before it */
+    template<typename FillerType>
+    void SerializeOversized(int64 MaxLength, FillerType&& Fill)
+    {
+        TArray<uint8> Record;
+        Record.AddUninitialized(MaxLength);
+        const int32 Length = Fill(Record.GetData());
 
-    /** [WRITER THREAD] Last time the archive was flushed. used in threaded situations to flush the underlying archive at a certain maximum rate. */
-    double LastArchiveFlushTime;
+        FlushBuffer();
 
-    /** [WRITER THREAD] Archive flush interval. */
-    double ArchiveFlushIntervalSec;
+        FScopeLock ArchiveLock(&ArchiveCritical);
+        WriteLinePayload(Record.GetData(), Length);
+    }
 
-    /** [WRITER THREAD] Serialize the contents of the ring buffer to disk */
-    void SerializeBufferToArchive()
+    /**
+     * [CLIENT THREAD] Reserves a ring buffer record, waiting for the writer to make room if the backpressure policy says so
+     * @return false if the line has to be spilled over or dropped
+     */
+    bool ReserveRecord(int32 Length, ELogVerbosity::Type Verbosity, FLogRingBuffer::FReservation& OutReservation)
     {
-        while (SerializeRequestCounter.GetValue() > 0)
+        const ELogBackpressure::Type Policy = BackpressurePolicy;
+
+        // Once lines spill over they keep doing so until the writer caught up, so they stay in order
+        if (Policy == ELogBackpressure::Grow && Overflow.IsActive())
         {
-            // Grab a local copy of the end pos. It's ok if it changes on the client thread later on.
-            // We won't be modifying it anyway and will later serialize new data in the next iteration.
-            // Here we only serialize what we know exists at the beginning of this function.
-            int32 ThisThreadEndPos = BufferEndPos;
+            return false;
+        }
 
-            if (ThisThreadEndPos >= BufferStartPos)
+        const bool bBlock = Policy == ELogBackpressure::Block ||
+            (Policy == ELogBackpressure::DropLowestVerbosity && (Verbosity & ELogVerbosity::VerbosityMask) <= ELogVerbosity::Error);
+        const double StartTime = FPlatformTime::Seconds();
+
+        for (;;)
+        {
+            // Sampled before trying, so a release racing with the failed attempt still satisfies the wait below
+            const int64 ReleasePos = Buffer.GetReleasePos();
+            if (Buffer.Reserve(Length, OutReservation))
             {
-                Ar.Serialize(Buffer.GetData() + BufferStartPos, ThisThreadEndPos - BufferStartPos);
+                return true;
             }
-            else
+
+            // The ring buffer is full, wait for the writer to make some room
+            if (!Scheduler)
+            {
+                SerializeBufferToArchive();
+                continue;
+            }
+
+            Counters.UpdatePeakOccupancy(Buffer.GetCapacity());
+
+            if (!bBlock)
             {
-                // Data is wrapped around the ring buffer
-                Ar.Serialize(Buffer.GetData() + BufferStartPos, Buffer.Num() - BufferStartPos);
-                Ar.Serialize(Buffer.GetData(), BufferEndPos);
+                return false;
             }
-            // Modify the start pos. Only the worker thread modifies this value so it's ok to not guard it with a critical section.
-            BufferStartPos = ThisThreadEndPos;
 
-            // Flush the archive periodically if running on a separate thread
-            if (Thread)
+            uint32 WaitTimeMs = BlockTimeoutMs;
+            if (WaitTimeMs != MAX_uint32)
             {
-                if ((FPlatformTime::Seconds() - LastArchiveFlushTime) > ArchiveFlushIntervalSec)
+                const uint32 ElapsedMs = (uint32)((FPlatformTime::Seconds() - StartTime) * 1000.0);
+                if (ElapsedMs >= WaitTimeMs)
                 {
-                    Ar.Flush();
-                    LastArchiveFlushTime = FPlatformTime::Seconds();
+                    return false;
                 }
+                WaitTimeMs -= ElapsedMs;
             }
 
-            // Decrement the request counter, we now know we serialized at least one request.
-            // We might have serialized more requests but it's irrelevant, the counter will go down to 0 eventually
-            SerializeRequestCounter.Decrement();
+            const uint64 WaitStartCycles = FPlatformTime::Cycles64();
+            const bool bMadeRoom = WaitForWriter(FFlushTarget{ ReleasePos + 1, 0, 0 }, 0, WaitTimeMs);
+            Counters.AddFullBufferWait(FPlatformTime::Cycles64() - WaitStartCycles);
+
+            if (!bMadeRoom)
+            {
+                return false;
+            }
         }
     }
 
-    /** [CLIENT THREAD] Flush the memory buffer (doesn't force the archive to flush). Can only be used from inside of BufferPosCritical lock. */
-    void FlushBuffer()
+    /**
+     * [CLIENT THREAD] Queues a record holding NumLines lines, written by Fill(uint8* Dest), in the ring buffer or the overflow
+     * queue, or drops it as the backpressure policy says.
+     */
+    template<typename FillerType>
+    void QueueRecord(int64 MaxLength, ELogVerbosity::Type Verbosity, int32 NumLines, FillerType&& Fill)
     {
-        SerializeRequestCounter.Increment();
-        if (!Thread)
+        FLogRingBuffer::FReservation Reservation;
+        if (ReserveRecord((int32)MaxLength, Verbosity, Reservation))
         {
-            SerializeBufferToArchive();
+            Reservation.Length = Fill(Reservation.Data);
+            Buffer.Commit(Reservation);
         }
-        while (SerializeRequestCounter.GetValue() != 0)
+        else if (BackpressurePolicy == ELogBackpressure::Grow && Overflow.AppendWith(MaxLength, Fill))
+        {
+            FPlatformAtomics::InterlockedIncrement(&Counters.OverflowRecords);
+        }
+        else
+        {
+            DropLines(NumLines);
+        }
+    }
+
+    /** [CLIENT THREAD] Gets the calling thread's staging buffer, creating it on first use */
+    FLogStagingBuffer* GetThreadStagingBuffer()
+    {
+        FLogStagingBuffer* Staging = (FLogStagingBuffer*)FPlatformTLS::GetTlsValue(StagingTlsSlot);
+        if (!Staging)
+        {
+            Staging = new FLogStagingBuffer(StagingBufferSize);
+            FPlatformTLS::SetTlsValue(StagingTlsSlot, Staging);
+
+            FScopeLock StagingLock(&StagingCritical);
+            StagingBuffers.Add(Staging);
+        }
+        return Staging;
+    }
+
+    /** [CLIENT THREAD] Takes the calling thread's staging buffer back from the writer, which only holds it for a memcpy */
+    static void AcquireStagingBuffer(FLogStagingBuffer* Staging)
+    {
+        while (!Staging->TryAcquire(FLogStagingBuffer::Producing))
         {
             FPlatformProcess::SleepNoStats(0);
         }
-        // Make sure there's been no unexpected concurrency
-        check(SerializeRequestCounter.GetValue() == 0);
+    }
+
+    /** [CLIENT THREAD] Hands the staged lines to the writer as a single ring buffer record. Staging must be acquired. */
+    void HandOffStagedLines(FLogStagingBuffer* Staging)
+    {
+        if (!Staging->IsEmpty())
+        {
+            // A batch mixes verbosities, DropLowestVerbosity treats it like an error and only drops it on timeout
+            QueueRecord(Staging->GetUsed(), ELogVerbosity::Error, Staging->GetNumLines(), [Staging](uint8* Dest)
+            {
+                FMemory::Memcpy(Dest, Staging->GetData(), Staging->GetUsed());
+                return Staging->GetUsed();
+            });
+
+            // Only forget the lines once they are visible to the writer (or dropped), the writer relies on it for ordering
+            Staging->Reset();
+            NotifyWriter();
+        }
+    }
+
+    /** [CLIENT THREAD] Stages a line in the calling thread's buffer, handing the batch to the writer when it is due */
+    template<typename FillerType>
+    void SerializeStaged(ELogVerbosity::Type Verbosity, int64 MaxLength, FillerType&& Fill)
+    {
+        FLogStagingBuffer* Staging = GetThreadStagingBuffer();
+        AcquireStagingBuffer(Staging);
+
+        if (!Staging->HasRoomFor(MaxLength))
+        {
+            HandOffStagedLines(Staging);
+        }
+
+        const uint64 NowCycles = FPlatformTime::Cycles64();
+        if (Staging->HasRoomFor(MaxLength))
+        {
+            const bool bFirstStagedLine = Staging->IsEmpty();
+            Staging->BeginLine(LoadSequence(), NowCycles);
+            Staging->AppendWith(NextSequence(), Fill);
+
+            if (Staging->GetUsed() >= StagingBatchSize ||
+                (NowCycles - Staging->GetFirstStagedCycles()) * FPlatformTime::GetSecondsPerCycle64() >= StagingBatchIntervalSec)
+            {
+                HandOffStagedLines(Staging);
+            }
+            else if (bFirstStagedLine)
+            {
+                // Let the writer know it has to come back for this batch if the thread goes quiet
+                NotifyWriter();
+            }
+            Staging->Release();
+        }
+        else if (FLogStagingBuffer::GetLineSpan(MaxLength) <= Buffer.GetMaxRecordLength())
+        {
+            // Too big for the staging buffer, hand it to the writer as a batch of its own
+            Staging->BeginLine(LoadSequence(), NowCycles);
+
+            QueueRecord(FLogStagingBuffer::GetLineSpan(MaxLength), Verbosity, 1, [this, &Fill](uint8* Dest)
+            {
+                return FLogStagingBuffer::WriteLineWith(Dest, NextSequence(), Fill);
+            });
+
+            Staging->Reset();
+            Staging->Release();
+            NotifyWriter();
+        }
+        else
+        {
+            Staging->Release();
+            SerializeOversized(MaxLength, Fill);
+        }
+    }
+
+    /**
+     * [CLIENT THREAD] Queues a line whose payload is written straight into the queue by Fill(uint8* Dest).
+     * Fill may write up to MaxLength bytes and returns the number of bytes it wrote. Verbosity drives the backpressure policy.
+     */
+    template<typename FillerType>
+    void SerializeWith(ELogVerbosity::Type Verbosity, int64 MaxLength, FillerType&& Fill)
+    {
+        if (ShouldShedLine(Verbosity))
+        {
+            DropLines(1);
+            return;
+        }
+
+        if (bUseStaging)
+        {
+            SerializeStaged(Verbosity, MaxLength, Fill);
+            return;
+        }
+
+        if (MaxLength > Buffer.GetMaxRecordLength())
+        {
+            SerializeOversized(MaxLength, Fill);
+            return;
+        }
+
+        QueueRecord(MaxLength, Verbosity, 1, Fill);
+
+        // No async thread? Serialize now.
+        if (!Scheduler)
+        {
+            SerializeBufferToArchive();
+        }
+        else
+        {
+            NotifyWriter();
+        }
+    }
+
+    int64 LoadSequence() const
+    {
+        const int64 Value = LineSequence;
+        FPlatformMisc::MemoryBarrier();
+        return Value;
+    }
+
+    int64 NextSequence()
+    {
+        return FPlatformAtomics::InterlockedIncrement(&LineSequence) - 1;
     }
 
 public:
 
-    FLogAsyncWriter(FArchive& InAr)
-        : Thread(nullptr)
+    /** Takes ownership of InAr */
+    FLogAsyncWriter(FLogRotatingArchive* InAr, FLogIOScheduler* InScheduler, const FLogWriterSettings& Settings)
+        : Scheduler(InScheduler)
+        , IOWorker(nullptr)
+        , bWakeupPending(0)
+        , RequestedFlushTicket(0)
+        , DurableReleasePos(0)
+        , DurableFlushRequest(0)
+        , DurableOverflowDrain(0)
+        , CompletedFlushTicket(0)
+        , bDurableFlushPending(0)
         , Ar(InAr)
-        , BufferStartPos(0)
-        , BufferEndPos(0)
-        , LastArchiveFlushTime(0.0)
-        , ArchiveFlushIntervalSec(0.2)
+        , Buffer(Settings.BufferSize)
+        , bArchiveDirty(false)
+        , BackpressurePolicy(Settings.BackpressurePolicy)
+        , BlockTimeoutMs(Settings.BlockTimeoutMs)
+        , Overflow(Settings.MaxOverflowSize)
+        , DroppedLines(0)
+        , LastDropReportCycles(0)
+        , bUseStaging(false)
+        , StagingBatchSize(StagingBufferSize / 2)
+        , StagingBatchIntervalSec(0.05)
+        , StagingTlsSlot(0)
+        , LineSequence(0)
+        , bDeferFormatting(Settings.bBinary || FParse::Param(FCommandLine::Get(), TEXT("LOGDEFERFORMAT")))
+        , bTagLines(false)
+        , TagBaseTicks(FLogTimestampCache::NowTicks() / ETimespan::TicksPerMillisecond * ETimespan::TicksPerMillisecond)
+        , LastTagFrame(GFrameCounter)
+        , bBinary(Settings.bBinary)
+        , BinarySegmentIndex(0)
+        , SidecarIndex(nullptr)
+        , SidecarSegmentIndex(INDEX_NONE)
+        , Repeats(nullptr)
+        , RepeatIntervalSec(Settings.RepeatIntervalSec)
     {
-        Buffer.AddUninitialized(InitialBufferSize);
+        if (Settings.bCoalesceRepeats)
+        {
+            Repeats = new FLogRepeatTable();
+        }
 
-        float CommandLineInterval = 0.0;
-        if (FParse::Value(FCommandLine::Get(), TEXT("LOGFLUSHINTERVAL="), CommandLineInterval))
+        // Binary files can't be decoded from the middle and compressed ones can't be seeked, only plain text is indexed
+        if (Settings.IndexBlockSize > 0 && !bBinary && !Settings.bCompressLive && !Settings.bCompressSegments)
         {
-            ArchiveFlushIntervalSec = CommandLineInterval;
+            SidecarIndex = new FLogIndexWriter(Settings.IndexBlockSize);
+            bTagLines = !bDeferFormatting;
         }
 
-        if (FPlatformProcess::SupportsMultithreading())
+        if (Scheduler)
         {
-            FString WriterName = FString::Printf(TEXT("FAsyncWriter_%s"), *FPaths::GetBaseFilename(Ar.GetArchiveName()));
-            Thread = FRunnableThread::Create(this, *WriterName, 0, TPri_BelowNormal);
+            // Staging only pays off when there's a writer thread to hand the batches to
+            bUseStaging = FParse::Param(FCommandLine::Get(), TEXT("LOGTHREADSTAGING"));
+            if (bUseStaging)
+            {
+                StagingTlsSlot = FPlatformTLS::AllocTlsSlot();
+
+                int32 CommandLineBatchSize = 0;
+                if (FParse::Value(FCommandLine::Get(), TEXT("LOGSTAGINGBATCH="), CommandLineBatchSize))
+                {
+                    StagingBatchSize = FMath::Clamp(CommandLineBatchSize, 1, (int32)StagingBufferSize);
+                }
+
+                float CommandLineBatchInterval = 0.0f;
+                if (FParse::Value(FCommandLine::Get(), TEXT("LOGSTAGINGINTERVAL="), CommandLineBatchInterval))
+                {
+                    StagingBatchIntervalSec = CommandLineBatchInterval;
+                }
+            }
+
+            IOWorker = Scheduler->RegisterWriter(this);
         }
     }
 
     virtual ~FLogAsyncWriter()
     {
         Flush();
-        delete Thread;
-        Thread = nullptr;
+
+        if (Scheduler)
+        {
+            // Waits for the I/O thread to be done with this writer
+            Scheduler->UnregisterWriter(this);
+            Scheduler = nullptr;
+            IOWorker = nullptr;
+        }
+
+        if (bUseStaging)
+        {
+            for (FLogStagingBuffer* Staging : StagingBuffers)
+            {
+                delete Staging;
+            }
+            StagingBuffers.Empty();
+            FPlatformTLS::FreeTlsSlot(StagingTlsSlot);
+        }
+
+        // Writes the entry of the last block
+        delete SidecarIndex;
+        SidecarIndex = nullptr;
+
+        delete Repeats;
+        Repeats = nullptr;
+
+        delete Ar;
+        Ar = nullptr;
     }
 
     /** [CLIENT THREAD] Serialize data to buffer that will later be saved to disk by the async thread */
@@ -145,93 +1253,340 @@ public:
 
         const uint8* Data = (uint8*)InData;
 
-        FScopeLock WriteLock(&BufferPosCritical);
+        if (bDeferFormatting)
+        {
+            // Raw bytes travel as preformatted records so the writer can tell them from queued lines
+            SerializeWith(ELogVerbosity::Error, FLogLineRecord::GetRecordLength(Length), [Data, Length](uint8* Dest)
+            {
+                FLogLineRecord* Record = (FLogLineRecord*)Dest;
+                FMemory::Memzero(Record, sizeof(FLogLineRecord));
+                Record->PayloadLength = (int32)Length;
+                Record->Flags = FLogLineRecord::Preformatted;
+                FMemory::Memcpy(Record->GetPayload(), Data, Length);
+                return (int32)FLogLineRecord::GetRecordLength(Length);
+            });
+            return;
+        }
 
-        // Store the local copy of the current buffer start pos. It may get moved by the worker thread but we don't
-        // care about it too much because we only modify BufferEndPos. Copy should be atomic enough. We only use it
-        // for checking the remaining space in the buffer so underestimating is ok.
+        if (bTagLines)
         {
-            const int32 ThisThreadStartPos = BufferStartPos;
-            // Calculate the remaining size in the ring buffer
-            const int32 BufferFreeSize = ThisThreadStartPos <= BufferEndPos ? (Buffer.Num() - BufferEndPos + ThisThreadStartPos) : (ThisThreadStartPos - BufferEndPos);
-            // Make sure the buffer is BIGGER than we require otherwise we may calculate the wrong (0) buffer EndPos for StartPos = 0 and Length = Buffer.Num()
-            if (BufferFreeSize <= Length)
+            // Raw bytes carry a NoLogging tag so the writer doesn't index them as a line
+            const FLogLineTag Tag = FLogLineTag::Make(TagBaseTicks, TagBaseTicks, 0, ELogVerbosity::NoLogging);
+            SerializeWith(ELogVerbosity::Error, sizeof(FLogLineTag) + Length, [Tag, Data, Length](uint8* Dest)
             {
-                // Force the async thread to call SerializeBufferToArchive even if it's currently empty
-                FlushBuffer();
+                FMemory::Memcpy(Dest, &Tag, sizeof(FLogLineTag));
+                FMemory::Memcpy(Dest + sizeof(FLogLineTag), Data, Length);
+                return (int32)(sizeof(FLogLineTag) + Length);
+            });
+            return;
+        }
 
-                // Resize the buffer if needed
-                if (Length >= Buffer.Num())
-                {
-                    // Keep the buffer bigger than we require so that % Buffer.Num() does not return 0 for Lengths = Buffer.Num()
-                    Buffer.SetNumUninitialized(Length + 1);
-                }
+        // Raw bytes (byte order marks, preformatted text) are never shed ahead of a full queue
+        SerializeWith(ELogVerbosity::Error, Length, [Data, Length](uint8* Dest)
+        {
+            FMemory::Memcpy(Dest, Data, Length);
+            return (int32)Length;
+        });
+    }
+
+    /**
+     * [CLIENT THREAD] Queues a log line. The line is encoded as UTF-8 straight into the queue, or queued as a raw
+     * record for the writer thread to format when formatting is deferred.
+     * @param Recorder - flight recorder to copy the encoded line to, may be nullptr
+     * @return true if Recorder got the line, it doesn't when formatting is deferred or the line is shed
+     */
+    bool SerializeLine(const TCHAR* Data, ELogVerbosity::Type Verbosity, const class FName& Category, const double Time, bool bLineTerminator,
+        FLogFlightRecorder* Recorder = nullptr)
+    {
+        const int32 MessageLength = FCString::Strlen(Data);
+        const int64 Ticks = FLogTimestampCache::NowTicks();
+        const uint64 FrameCounter = GFrameCounter;
+
+        bool bRecorded = false;
+        SerializeWith(Verbosity, GetMaxLineLength(Category, MessageLength), [&](uint8* Dest)
+        {
+            const int32 Length = FillLine(Dest, Data, MessageLength, Verbosity, Category, Time, Ticks, FrameCounter, bLineTerminator);
+            if (Recorder && !bDeferFormatting)
+            {
+                const int32 TagLength = bTagLines ? sizeof(FLogLineTag) : 0;
+                bRecorded = Recorder->RecordEncodedLine(Dest + TagLength, Length - TagLength, Ticks);
             }
+            return Length;
+        });
+        return bRecorded;
+    }
+
+    /**
+     * [CLIENT THREAD] Asks the writer to get everything queued so far to disk and returns right away.
+     * Ticket identifies the request for WaitForFlush, callers hand out increasing tickets.
+     */
+    void RequestFlush(int64 Ticket)
+    {
+        if (!Scheduler)
+        {
+            // Everything is written on the calling thread anyway
+            Flush();
+            return;
         }
 
-        // We now know there's enough space in the buffer to copy data
-        const int32 WritePos = BufferEndPos;
-        if ((WritePos + Length) <= Buffer.Num())
+        const FFlushTarget Target = MakeFlushTarget();
+        InterlockedMax(&DurableReleasePos, Target.ReleasePos);
+        InterlockedMax(&DurableFlushRequest, Target.FlushRequest);
+        InterlockedMax(&DurableOverflowDrain, Target.OverflowDrain);
+
+        // Behind a higher ticket the writer may have taken the target without this request's part, so it isn't complete either
+        if (InterlockedMax(&RequestedFlushTicket, Ticket) >= Ticket)
         {
-            // Copy straight into the ring buffer
-            FMemory::Memcpy(Buffer.GetData() + WritePos, Data, Length);
+            InterlockedMin(&CompletedFlushTicket, Ticket - 1);
         }
-        else
+
+        if (bDurableFlushPending == 0)
         {
-            // Wrap around the ring buffer
-            int32 BufferSizeToEnd = Buffer.Num() - WritePos;
-            FMemory::Memcpy(Buffer.GetData() + WritePos, Data, BufferSizeToEnd);
-            FMemory::Memcpy(Buffer.GetData(), Data + BufferSizeToEnd, Length - BufferSizeToEnd);
+            FPlatformAtomics::InterlockedExchange(&bDurableFlushPending, 1);
         }
 
-        // Update the end position and let the async thread know we need to write to disk
-        BufferEndPos = (BufferEndPos + Length) % Buffer.Num();
-        SerializeRequestCounter.Increment();
+        // A pass already due takes the request along
+        NotifyWriter();
+    }
 
-        // No async thread? Serialize now.
-        if (!Thread)
+    /**
+     * [CLIENT THREAD] Waits until every flush requested with a ticket up to Ticket is on disk
+     * @return false if WaitTimeMs ran out first
+     */
+    bool WaitForFlush(int64 Ticket, uint32 WaitTimeMs)
+    {
+        if (!Scheduler)
         {
-            SerializeBufferToArchive();
+            return true;
+        }
+
+        if (IsTicketFlushed(Ticket))
+        {
+            return true;
+        }
+
+        return WaitForWriter(FFlushTarget{ 0, 0, 0 }, Ticket, WaitTimeMs);
+    }
+
+    /**
+     * [CLIENT THREAD] Holds the line back if it repeats the previous line of its category, lock-free. A line ending a
+     * run of repeats queues the repeat count first. Lines are compared by a hash of the message, before any formatting.
+     * @param PrintedCategory - category the line is written with, NAME_None if the file leaves it out
+     * @return true if the line is a repeat and must not be written
+     */
+    bool CoalesceRepeat(const TCHAR* Data, ELogVerbosity::Type Verbosity, const class FName& Category, const class FName& PrintedCategory)
+    {
+        if (!Repeats)
+        {
+            return false;
+        }
+
+        FLogHeldRepeats EndedRun;
+        bool bFirstHeld = false;
+        if (Repeats->Coalesce(Category, PrintedCategory, Verbosity, Data, FCString::Strlen(Data), EndedRun, bFirstHeld))
+        {
+            if (bFirstHeld)
+            {
+                // Nothing else may come to wake the writer before the count is due
+                NotifyWriter();
+            }
+            return true;
+        }
+
+        if (EndedRun.NumHeld > 0)
+        {
+            const FString Message = GetRepeatMessage(EndedRun.NumHeld);
+            SerializeLine(*Message, (ELogVerbosity::Type)EndedRun.Verbosity, EndedRun.PrintedCategory, -1.0, true);
+        }
+        return false;
+    }
+
+    /** [CLIENT THREAD] Queues the repeat counts of every category, before the file is flushed or closed */
+    void QueueHeldRepeats()
+    {
+        if (!Repeats)
+        {
+            return;
         }
+
+        for (int32 RunIndex = 0; RunIndex < Repeats->GetNumRuns(); ++RunIndex)
+        {
+            FLogHeldRepeats Held;
+            if (Repeats->TakeHeld(RunIndex, Held))
+            {
+                const FString Message = GetRepeatMessage(Held.NumHeld);
+                SerializeLine(*Message, (ELogVerbosity::Type)Held.Verbosity, Held.PrintedCategory, -1.0, true);
+            }
+        }
+    }
+
+    /**
+     * [CLIENT THREAD] Whether a new line passes the rate limit and sampling, checked before the line is formatted.
+     * Rejected lines don't wake the writer, the admitted lines of the same storm do and it reports them then.
+     */
+    bool AdmitLine()
+    {
+        return RateLimiter.Admit();
+    }
+
+    /** [CLIENT THREAD] Limits the sustained rate of lines, LinesPerSecond 0 or less removes the limit */
+    void SetRateLimit(float LinesPerSecond, int32 Burst)
+    {
+        RateLimiter.SetRateLimit(LinesPerSecond, Burst);
+    }
+
+    /** [CLIENT THREAD] Keeps a random KeepRatio share of the lines */
+    void SetSampling(float KeepRatio)
+    {
+        RateLimiter.SetSampling(KeepRatio);
+    }
+
+    /** [CLIENT THREAD] Counts a line dropped because the filter writing to this file is disabled */
+    void CountDisabledLine()
+    {
+        FPlatformAtomics::InterlockedIncrement(&Counters.DisabledLines);
+    }
+
+    /** Path of the segment currently written, doesn't wait for the writer to finish what it's writing */
+    FString GetFilename() const
+    {
+        return Ar->GetSegmentFilenameSnapshot();
+    }
+
+    /** Takes a snapshot of the counters, Category is left to the caller */
+    void GetStats(FLogWriterStats& OutStats)
+    {
+        Counters.GetStats(OutStats);
+        OutStats.BufferCapacity = Buffer.GetCapacity();
+
+        // Not reported yet, but dropped all the same
+        OutStats.DroppedLines += DroppedLines;
+
+        OutStats.Filename = GetFilename();
+    }
+
+    /** [CLIENT THREAD] Changes what happens to new lines when the ring buffer is full */
+    void SetBackpressurePolicy(ELogBackpressure::Type Policy)
+    {
+        BackpressurePolicy = Policy;
     }
 
     /** Flush all buffers to disk */
     void Flush()
     {
-        FScopeLock WriteLock(&BufferPosCritical);
+        QueueHeldRepeats();
         FlushBuffer();
-        // At this point the serialize queue should be empty and the writer thread should no longer
-        // be accessing the Archive so we should be safe to flush it from here.
-        Ar.Flush();
+        ReportDroppedLines(true);
+
+        // At this point everything queued before the call has been handed to the archive, the writer thread
+        // only touches the archive while holding ArchiveCritical so we should be safe to flush it from here.
+        FScopeLock ArchiveLock(&ArchiveCritical);
+        FlushArchiveLocked(true);
     }
 
-    //~ Begin FRunnable Interface.
-    virtual bool Init()
+    /**
+     * [WRITER THREAD] Called by the I/O thread to write everything queued so far to the archive.
+     * @return true if anything was written
+     */
+    bool ServiceQueue()
     {
-        return true;
+        // Cleared before looking at the queue, anything committed from here on wakes the thread up again
+        FPlatformAtomics::InterlockedExchange(&bWakeupPending, 0);
+
+        Counters.UpdatePeakOccupancy(Buffer.GetReservePos() - Buffer.GetReleasePos());
+
+        // Runs still going on, queued first so this pass writes them
+        if (Repeats)
+        {
+            QueueDueRepeats();
+        }
+
+        const bool bWroteData = SerializeBufferToArchive();
+        ReportDroppedLines(false);
+
+        CompleteFlushWaiters();
+        return bWroteData;
     }
-    virtual uint32 Run()
+
+    /**
+     * [WRITER THREAD] How soon the I/O thread has to come back to this writer without being woken up
+     * @return delay in seconds, negative if the next wakeup can wait for new data
+     */
+    double GetNextServiceDelay()
     {
-        while (StopTaskCounter.GetValue() == 0)
         {
-            if (SerializeRequestCounter.GetValue() > 0)
+            // A waiter left behind is waiting on a record or a staging buffer still being written by its producer
+            FScopeLock WaitersLock(&FlushWaitersCritical);
+            if (FlushWaiters.Num() > 0)
             {
-                SerializeBufferToArchive();
+                return 0.001;
+            }
+        }
+
+        // A durable flush behind a record is taken along by the pass its commit wakes up, staged lines wake nobody
+        if (bDurableFlushPending && bUseStaging)
+        {
+            return 0.001;
+        }
+
+        double Delay = -1.0;
+        if (DroppedLines != 0 || RateLimiter.HasRejectedLines())
+        {
+            const double SinceReportSec = ((int64)FPlatformTime::Cycles64() - LastDropReportCycles) * FPlatformTime::GetSecondsPerCycle64();
+            Delay = FMath::Max(0.0, DropReportIntervalSec - SinceReportSec);
+        }
+
+        if (Repeats)
+        {
+            const uint64 NowCycles = FPlatformTime::Cycles64();
+            for (int32 RunIndex = 0; RunIndex < Repeats->GetNumRuns(); ++RunIndex)
+            {
+                FLogHeldRepeats Held;
+                uint64 FirstHeldCycles = 0;
+                if (Repeats->PeekHeld(RunIndex, Held, FirstHeldCycles))
+                {
+                    const double HeldSec = (double)(int64)(NowCycles - FirstHeldCycles) * FPlatformTime::GetSecondsPerCycle64();
+                    const double RepeatDelay = FMath::Max(0.0, RepeatIntervalSec - HeldSec);
+                    Delay = Delay < 0.0 ? RepeatDelay : FMath::Min(Delay, RepeatDelay);
+                }
             }
-            else if ((FPlatformTime::Seconds() - LastArchiveFlushTime) > ArchiveFlushIntervalSec)
+        }
+
+        if (bUseStaging)
+        {
+            bool bHasStagedLines = PendingLines.Num() > 0;
+            if (!bHasStagedLines)
             {
-                SerializeRequestCounter.Increment();
+                FScopeLock StagingLock(&StagingCritical);
+                for (FLogStagingBuffer* Staging : StagingBuffers)
+                {
+                    bHasStagedLines |= !Staging->IsEmpty();
+                }
             }
-            else
+
+            if (bHasStagedLines)
             {
-                FPlatformProcess::Sleep(0.01f);
+                Delay = Delay < 0.0 ? StagingBatchIntervalSec : FMath::Min(Delay, StagingBatchIntervalSec);
             }
         }
-        return 0;
+
+        return Delay;
+    }
+
+    /** [WRITER THREAD] Whether the archive has data that hasn't been flushed yet */
+    bool IsArchiveDirty()
+    {
+        FScopeLock ArchiveLock(&ArchiveCritical);
+        return bArchiveDirty;
     }
-    virtual void Stop()
+
+    /** [WRITER THREAD] Called by the I/O thread on its flush cadence, flushes the archive if anything was written since the last flush */
+    void FlushArchive()
     {
-        StopTaskCounter.Increment();
+        FScopeLock ArchiveLock(&ArchiveCritical);
+        if (bArchiveDirty)
+        {
+            FlushArchiveLocked(false);
+        }
     }
-    //~ End FRunnable Interface
 };
@@ -0,0 +1,467 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#include "LogManagerPrivatePCH.h"
+
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+
+namespace
+{
+    /** Counts the allocations made while a benchmark measures, and separately those made by its producer threads */
+    class FLogBenchmarkMalloc : public FMalloc
+    {
+    public:
+        FLogBenchmarkMalloc(FMalloc* InInnerMalloc)
+            : InnerMalloc(InInnerMalloc)
+            , ProducerTlsSlot(FPlatformTLS::AllocTlsSlot())
+            , bCounting(0)
+            , Allocations(0)
+            , ProducerAllocations(0)
+        {
+        }
+
+        /** Marks the calling thread as a producer, its allocations are counted on their own */
+        void SetProducerThread()
+        {
+            FPlatformTLS::SetTlsValue(ProducerTlsSlot, this);
+        }
+
+        /** Zeroes the counters and starts counting */
+        void BeginCounting()
+        {
+            Allocations = 0;
+            ProducerAllocations = 0;
+            FPlatformAtomics::InterlockedExchange(&bCounting, 1);
+        }
+
+        void EndCounting()
+        {
+            FPlatformAtomics::InterlockedExchange(&bCounting, 0);
+        }
+
+        int64 GetAllocations() const
+        {
+            return Allocations;
+        }
+
+        int64 GetProducerAllocations() const
+        {
+            return ProducerAllocations;
+        }
+
+        virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+        {
+            CountAllocation();
+            return InnerMalloc->Malloc(Count, Alignment);
+        }
+
+        virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+        {
+            CountAllocation();
+            return InnerMalloc->Realloc(Original, Count, Alignment);
+        }
+
+        virtual void Free(void* Original) override
+        {
+            InnerMalloc->Free(Original);
+        }
+
+        virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override
+        {
+            return InnerMalloc->QuantizeSize(Count, Alignment);
+        }
+
+        virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+        {
+            return InnerMalloc->GetAllocationSize(Original, SizeOut);
+        }
+
+        virtual void Trim() override
+        {
+            InnerMalloc->Trim();
+        }
+
+        virtual void SetupTLSCachesOnCurrentThread() override
+        {
+            InnerMalloc->SetupTLSCachesOnCurrentThread();
+        }
+
+        virtual void ClearAndDisableTLSCachesOnCurrentThread() override
+        {
+            InnerMalloc->ClearAndDisableTLSCachesOnCurrentThread();
+        }
+
+        virtual void InitializeStatsMetadata() override
+        {
+            InnerMalloc->InitializeStatsMetadata();
+        }
+
+        virtual void UpdateStats() override
+        {
+            InnerMalloc->UpdateStats();
+        }
+
+        virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override
+        {
+            InnerMalloc->GetAllocatorStats(OutStats);
+        }
+
+        virtual void DumpAllocatorStats(FOutputDevice& Ar) override
+        {
+            InnerMalloc->DumpAllocatorStats(Ar);
+        }
+
+        virtual bool IsInternallyThreadSafe() const override
+        {
+            return InnerMalloc->IsInternallyThreadSafe();
+        }
+
+        virtual bool ValidateHeap() override
+        {
+            return InnerMalloc->ValidateHeap();
+        }
+
+        virtual const TCHAR* GetDescriptiveName() override
+        {
+            return InnerMalloc->GetDescriptiveName();
+        }
+
+    private:
+        void CountAllocation()
+        {
+            if (!bCounting)
+            {
+                return;
+            }
+
+            FPlatformAtomics::InterlockedIncrement(&Allocations);
+            if (FPlatformTLS::GetTlsValue(ProducerTlsSlot))
+            {
+                FPlatformAtomics::InterlockedIncrement(&ProducerAllocations);
+            }
+        }
+
+        FMalloc* InnerMalloc;
+        uint32 ProducerTlsSlot;
+        volatile int32 bCounting;
+        volatile int64 Allocations;
+        volatile int64 ProducerAllocations;
+    };
+
+    struct FLogBenchmarkCase
+    {
+        int32 NumThreads;
+        int32 MessageLength;
+        int32 NumCategories;
+        ELogVerbosity::Type FlushOn;
+    };
+
+    struct FLogBenchmarkResult
+    {
+        int64 NumLines;
+        int64 NumBytes;
+        /** Until the last producer returned */
+        double ProducerSeconds;
+        /** Until every line was on disk */
+        double DrainedSeconds;
+        double P50Us;
+        double P99Us;
+        double P999Us;
+        double MaxUs;
+        /** -1 if allocations aren't counted */
+        double AllocationsPerLine;
+        double ProducerAllocationsPerLine;
+    };
+
+    const TCHAR* GBenchmarkSink = TEXT("LogManagerBench");
+
+    /** Installed by FLogBenchmark::InstallAllocationCounter, nullptr if allocations aren't counted */
+    FLogBenchmarkMalloc* GBenchmarkMalloc = nullptr;
+
+    FString EscapeJson(const FString& Text)
+    {
+        return Text.Replace(TEXT("\\"), TEXT("\\\\")).Replace(TEXT("\""), TEXT("\\\""));
+    }
+
+    FLogBenchmarkResult RunBenchmarkCase(const FLogBenchmarkCase& Case, int32 LinesPerThread, FLogBenchmarkMalloc* CountingMalloc)
+    {
+        FLogManager& LogManager = static_cast<FLogManager&>(ILogManager::Get());
+
+        // The benchmark categories get a file of their own, opened and closed with the case
+        LogManager.AddRoute(FString::Printf(TEXT("%s*"), GBenchmarkSink), TArray<FString>{ GBenchmarkSink }, Case.FlushOn);
+
+        TArray<FName> Categories;
+        for (int32 CategoryIndex = 0; CategoryIndex < Case.NumCategories; ++CategoryIndex)
+        {
+            Categories.Add(FName(*FString::Printf(TEXT("%s%d"), GBenchmarkSink, CategoryIndex)));
+        }
+
+        // Distinct messages back to back, so repeat coalescing doesn't swallow them
+        const int32 NumMessages = 64;
+        TArray<FString> Messages;
+        for (int32 MessageIndex = 0; MessageIndex < NumMessages; ++MessageIndex)
+        {
+            FString Message = FString::Printf(TEXT("Message %02d "), MessageIndex);
+            while (Message.Len() < Case.MessageLength)
+            {
+                Message.AppendChar(TEXT('a') + (Message.Len() % 26));
+            }
+            Messages.Add(Message.Left(Case.MessageLength));
+        }
+
+        TArray<TArray<uint32>> ThreadCycles;
+        ThreadCycles.SetNum(Case.NumThreads);
+        for (TArray<uint32>& LineCycles : ThreadCycles)
+        {
+            LineCycles.AddUninitialized(LinesPerThread);
+        }
+
+        volatile int32 ReadyThreads = 0;
+        volatile int32 bStart = 0;
+
+        TArray<TFuture<void>> Producers;
+        for (int32 ThreadIndex = 0; ThreadIndex < Case.NumThreads; ++ThreadIndex)
+        {
+            TArray<uint32>* LineCycles = &ThreadCycles[ThreadIndex];
+            Producers.Add(Async<void>(EAsyncExecution::Thread, [&, ThreadIndex, LineCycles]()
+            {
+                if (CountingMalloc)
+                {
+                    CountingMalloc->SetProducerThread();
+                }
+
+                // Untimed, so the thread's staging buffer, the route cache and the repeat runs exist before anything is measured
+                for (int32 LineIndex = 0; LineIndex < NumMessages; ++LineIndex)
+                {
+                    const int32 Pick = LineIndex + ThreadIndex;
+                    LogManager.Serialize(*Messages[Pick % NumMessages], ELogVerbosity::Log, Categories[Pick % Case.NumCategories], -1.0);
+                }
+
+                FPlatformAtomics::InterlockedIncrement(&ReadyThreads);
+                while (!bStart)
+                {
+                    FPlatformProcess::Sleep(0.0f);
+                }
+
+                for (int32 LineIndex = 0; LineIndex < LinesPerThread; ++LineIndex)
+                {
+                    const int32 Pick = LineIndex + ThreadIndex;
+                    const uint32 StartCycles = FPlatformTime::Cycles();
+                    LogManager.Serialize(*Messages[Pick % NumMessages], ELogVerbosity::Log, Categories[Pick % Case.NumCategories], -1.0);
+                    (*LineCycles)[LineIndex] = FPlatformTime::Cycles() - StartCycles;
+                }
+            }));
+        }
+
+        while (ReadyThreads < Case.NumThreads)
+        {
+            FPlatformProcess::Sleep(0.0f);
+        }
+
+        if (CountingMalloc)
+        {
+            CountingMalloc->BeginCounting();
+        }
+
+        const double StartTime = FPlatformTime::Seconds();
+        FPlatformAtomics::InterlockedExchange(&bStart, 1);
+
+        for (TFuture<void>& Producer : Producers)
+        {
+            Producer.Wait();
+        }
+        const double ProducerTime = FPlatformTime::Seconds();
+
+        if (CountingMalloc)
+        {
+            CountingMalloc->EndCounting();
+        }
+
+        LogManager.WaitForFlush(LogManager.RequestFlush());
+        const double DrainedTime = FPlatformTime::Seconds();
+
+        LogManager.RemoveRoute(FString::Printf(TEXT("%s*"), GBenchmarkSink));
+        IFileManager::Get().Delete(*FString::Printf(TEXT("%s/%s.log"), *LogManager.GetCurrentLogDir(), GBenchmarkSink));
+        IFileManager::Get().Delete(*FString::Printf(TEXT("%s/%s%s"), *LogManager.GetCurrentLogDir(), GBenchmarkSink, FLogBinaryFormat::GetExtension()));
+
+        TArray<uint32> LineCycles;
+        for (const TArray<uint32>& Cycles : ThreadCycles)
+        {
+            LineCycles.Append(Cycles);
+        }
+        LineCycles.Sort();
+
+        auto Percentile = [&LineCycles](int32 PerThousand)
+        {
+            const int32 Index = FMath::Min((int32)((int64)LineCycles.Num() * PerThousand / 1000), LineCycles.Num() - 1);
+            return FPlatformTime::ToMilliseconds(LineCycles[Index]) * 1000.0;
+        };
+
+        FLogBenchmarkResult Result;
+        Result.NumLines = LineCycles.Num();
+        Result.NumBytes = Result.NumLines * FTCHARToUTF8(*Messages[0]).Length();
+        Result.ProducerSeconds = ProducerTime - StartTime;
+        Result.DrainedSeconds = DrainedTime - StartTime;
+        Result.P50Us = Percentile(500);
+        Result.P99Us = Percentile(990);
+        Result.P999Us = Percentile(999);
+        Result.MaxUs = FPlatformTime::ToMilliseconds(LineCycles.Last()) * 1000.0;
+        Result.AllocationsPerLine = CountingMalloc ? (double)CountingMalloc->GetAllocations() / Result.NumLines : -1.0;
+        Result.ProducerAllocationsPerLine = CountingMalloc ? (double)CountingMalloc->GetProducerAllocations() / Result.NumLines : -1.0;
+        return Result;
+    }
+}
+
+void FLogBenchmark::InstallAllocationCounter()
+{
+    if (!GBenchmarkMalloc && GMalloc && FParse::Param(FCommandLine::Get(), TEXT("LOGBENCHMARKALLOCS")))
+    {
+        // Blocks allocated before go back through the proxy to the allocator they came from
+        GBenchmarkMalloc = new FLogBenchmarkMalloc(GMalloc);
+        FPlatformMisc::MemoryBarrier();
+        GMalloc = GBenchmarkMalloc;
+    }
+}
+
+/**
+ * Measures the whole logging path under load, e.g. "LogManager.Benchmark Threads=8 Lines=50000".
+ * Every combination of thread count (doubling up to Threads), message length, category count and flush level
+ * is run through FLogManager::Serialize, results go to the output device and to a JSON file to compare builds with.
+ */
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogBenchmarkCommand(
+    TEXT("LogManager.Benchmark"),
+    TEXT("Measures logging throughput, producer latency and allocations per line, allocations need -LOGBENCHMARKALLOCS. Usage: LogManager.Benchmark [Threads=N] [Lines=PerThread] [NoAllocs] [Output=File.json]"),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+    {
+        const FString Params = FString::Join(Args, TEXT(" "));
+
+        int32 MaxThreads = FMath::Min(FPlatformMisc::NumberOfCoresIncludingHyperthreads(), 8);
+        int32 LinesPerThread = 20000;
+        FString OutputFilename = FPaths::GameSavedDir() / TEXT("Benchmarks") /
+            FString::Printf(TEXT("LogManager-%s.json"), *FDateTime::Now().ToString());
+        FParse::Value(*Params, TEXT("THREADS="), MaxThreads);
+        FParse::Value(*Params, TEXT("LINES="), LinesPerThread);
+        FParse::Value(*Params, TEXT("OUTPUT="), OutputFilename);
+        MaxThreads = FMath::Clamp(MaxThreads, 1, 64);
+        LinesPerThread = FMath::Clamp(LinesPerThread, 100, 10000000);
+
+        FLogBenchmarkMalloc* CaseMalloc = FParse::Param(*Params, TEXT("NOALLOCS")) ? nullptr : GBenchmarkMalloc;
+
+        const int32 MessageLengths[] = { 64, 1024 };
+        const int32 CategoryCounts[] = { 1, 16 };
+        const ELogVerbosity::Type FlushLevels[] = { ELogVerbosity::Warning, ELogVerbosity::All };
+
+        FString Runs;
+        Ar.Logf(TEXT("Log benchmark, up to %d threads, %d lines per thread"), MaxThreads, LinesPerThread);
+        if (!CaseMalloc)
+        {
+            Ar.Logf(TEXT("Allocations aren't counted, start with -LOGBENCHMARKALLOCS to count them"));
+        }
+
+        TArray<int32> ThreadCounts;
+        for (int32 NumThreads = 1; NumThreads < MaxThreads; NumThreads *= 2)
+        {
+            ThreadCounts.Add(NumThreads);
+        }
+        ThreadCounts.Add(MaxThreads);
+
+        for (int32 NumThreads : ThreadCounts)
+        {
+            for (int32 MessageLength : MessageLengths)
+            {
+                for (int32 NumCategories : CategoryCounts)
+                {
+                    for (ELogVerbosity::Type FlushOn : FlushLevels)
+                    {
+                        const FLogBenchmarkCase Case{ NumThreads, MessageLength, NumCategories, FlushOn };
+                        const FLogBenchmarkResult Result = RunBenchmarkCase(Case, LinesPerThread, CaseMalloc);
+                        const double MB = 1024.0 * 1024.0;
+
+                        Ar.Logf(TEXT("  %2d threads, %4d chars, %2d categories, flush on %-7s %9.0f lines/s, %7.1f MB/s, drained %9.0f lines/s, p50 %.2f us, p99 %.2f us, p999 %.2f us, max %.2f us, %.2f allocs/line (%.2f producer)"),
+                            NumThreads, MessageLength, NumCategories, ToString(FlushOn),
+                            Result.NumLines / Result.ProducerSeconds, Result.NumBytes / MB / Result.ProducerSeconds,
+                            Result.NumLines / Result.DrainedSeconds,
+                            Result.P50Us, Result.P99Us, Result.P999Us, Result.MaxUs,
+                            Result.AllocationsPerLine, Result.ProducerAllocationsPerLine);
+
+                        Runs += FString::Printf(TEXT("%s\n    {\"threads\": %d, \"message_length\": %d, \"categories\": %d, \"flush_on\": \"%s\", ")
+                            TEXT("\"lines\": %lld, \"lines_per_sec\": %.1f, \"bytes_per_sec\": %.1f, \"drained_lines_per_sec\": %.1f, ")
+                            TEXT("\"p50_us\": %.3f, \"p99_us\": %.3f, \"p999_us\": %.3f, \"max_us\": %.3f, ")
+                            TEXT("\"allocs_per_line\": %.4f, \"producer_allocs_per_line\": %.4f}"),
+                            Runs.IsEmpty() ? TEXT("") : TEXT(","),
+                            NumThreads, MessageLength, NumCategories, ToString(FlushOn),
+                            Result.NumLines, Result.NumLines / Result.ProducerSeconds, Result.NumBytes / Result.ProducerSeconds,
+                            Result.NumLines / Result.DrainedSeconds,
+                            Result.P50Us, Result.P99Us, Result.P999Us, Result.MaxUs,
+                            Result.AllocationsPerLine, Result.ProducerAllocationsPerLine);
+                    }
+                }
+            }
+        }
+
+        const FString Json = FString::Printf(
+            TEXT("{\n  \"build\": \"%s\",\n  \"platform\": \"%s\",\n  \"cores\": %d,\n  \"date\": \"%s\",\n  \"command_line\": \"%s\",\n  \"lines_per_thread\": %d,\n  \"runs\": [%s\n  ]\n}\n"),
+            *EscapeJson(FApp::GetBuildVersion()),
+            *EscapeJson(FPlatformProperties::PlatformName()),
+            FPlatformMisc::NumberOfCoresIncludingHyperthreads(),
+            *FDateTime::UtcNow().ToIso8601(),
+            *EscapeJson(FCommandLine::Get()),
+            LinesPerThread,
+            *Runs);
+
+        if (FFileHelper::SaveStringToFile(Json, *OutputFilename, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+        {
+            Ar.Logf(TEXT("Results written to %s"), *OutputFilename);
+        }
+        else
+        {
+            Ar.Logf(TEXT("Failed to write %s"), *OutputFilename);
+        }
+    }));
+
+/**
+ * Checks that logging a line doesn't touch the heap of the calling thread once it is warmed up, e.g. "LogManager.AllocationCheck".
+ * Runs single threaded benchmark cases and counts the allocations of the producer thread, needs -LOGBENCHMARKALLOCS.
+ */
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogAllocationCheckCommand(
+    TEXT("LogManager.AllocationCheck"),
+    TEXT("Checks that a log line makes no heap allocation on the calling thread in steady state, needs -LOGBENCHMARKALLOCS. Usage: LogManager.AllocationCheck [Lines=N]"),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+    {
+        if (!GBenchmarkMalloc)
+        {
+            Ar.Logf(TEXT("Allocations aren't counted, start with -LOGBENCHMARKALLOCS to run the check"));
+            return;
+        }
+
+        const FString Params = FString::Join(Args, TEXT(" "));
+        int32 NumLines = 10000;
+        FParse::Value(*Params, TEXT("LINES="), NumLines);
+        NumLines = FMath::Clamp(NumLines, 100, 10000000);
+
+        const int32 MessageLengths[] = { 64, 1024 };
+        const int32 CategoryCounts[] = { 1, 16 };
+
+        bool bPassed = true;
+        for (int32 MessageLength : MessageLengths)
+        {
+            for (int32 NumCategories : CategoryCounts)
+            {
+                const FLogBenchmarkCase Case{ 1, MessageLength, NumCategories, ELogVerbosity::Warning };
+                const FLogBenchmarkResult Result = RunBenchmarkCase(Case, NumLines, GBenchmarkMalloc);
+
+                // Exactly zero, a single allocation every few thousand lines is still a line that allocates
+                const bool bCasePassed = Result.ProducerAllocationsPerLine == 0.0;
+                bPassed &= bCasePassed;
+
+                Ar.Logf(TEXT("  %4d chars, %2d categories: %s, %.4f allocs/line on the calling thread, %.4f over every thread"),
+                    MessageLength, NumCategories, bCasePassed ? TEXT("passed") : TEXT("FAILED"),
+                    Result.ProducerAllocationsPerLine, Result.AllocationsPerLine);
+            }
+        }
+
+        Ar.Logf(TEXT("Allocation check %s, %d lines per case"), bPassed ? TEXT("passed") : TEXT("FAILED"), NumLines);
+    }));
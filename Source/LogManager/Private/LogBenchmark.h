@@ -0,0 +1,18 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+/**
+ * Hooks of the LogManager.Benchmark and LogManager.AllocationCheck console commands.
+ *
+ * Allocations are counted by an FMalloc proxy in front of GMalloc. GMalloc can't be swapped safely while other
+ * threads allocate, so the proxy is installed once, while the module loads at PostConfigInit before the engine
+ * starts its worker threads, and is never removed. It only counts while a benchmark measures, the rest of the
+ * time it costs one extra call per allocation. Without it the commands report allocations as not counted.
+ */
+class FLogBenchmark
+{
+public:
+    /** Puts the counting proxy in front of GMalloc if -LOGBENCHMARKALLOCS is on the command line, must be called before other threads start */
+    static void InstallAllocationCounter();
+};
@@ -0,0 +1,408 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#include "LogManagerPrivatePCH.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Misc/Crc.h"
+#include "Misc/FileHelper.h"
+
+namespace
+{
+    uint64 ZigZagEncode(int64 Value)
+    {
+        return ((uint64)Value << 1) ^ (uint64)(Value >> 63);
+    }
+
+    int64 ZigZagDecode(uint64 Value)
+    {
+        return (int64)(Value >> 1) ^ -(int64)(Value & 1);
+    }
+
+    /** Bounds checked cursor over a binary log file */
+    struct FLogBinaryReader
+    {
+        const uint8* Cursor;
+        const uint8* End;
+        bool bError;
+
+        FLogBinaryReader(const uint8* Data, int64 Length)
+            : Cursor(Data)
+            , End(Data + Length)
+            , bError(false)
+        {
+        }
+
+        bool AtEnd() const
+        {
+            return Cursor >= End;
+        }
+
+        uint8 ReadByte()
+        {
+            if (Cursor >= End)
+            {
+                bError = true;
+                return 0;
+            }
+            return *Cursor++;
+        }
+
+        uint64 ReadVarint()
+        {
+            uint64 Value = 0;
+            for (int32 Shift = 0; Shift < 64; Shift += 7)
+            {
+                const uint8 Byte = ReadByte();
+                Value |= (uint64)(Byte & 0x7F) << Shift;
+                if (!(Byte & 0x80))
+                {
+                    return Value;
+                }
+            }
+
+            bError = true;
+            return 0;
+        }
+
+        const uint8* ReadBytes(uint64 Length)
+        {
+            if (Length > (uint64)(End - Cursor))
+            {
+                bError = true;
+                return nullptr;
+            }
+
+            const uint8* Bytes = Cursor;
+            Cursor += Length;
+            return Bytes;
+        }
+    };
+}
+
+bool FLogBinaryFormat::IsBinaryLog(const uint8* Data, int64 Length)
+{
+    return Length >= (int64)sizeof(FFileHeader) && ((const FFileHeader*)Data)->Magic == Magic && ((const FFileHeader*)Data)->Version == Version;
+}
+
+bool FLogBinaryFormat::Decode(const uint8* Data, int64 Length, TArray<uint8>& OutText)
+{
+    if (!IsBinaryLog(Data, Length))
+    {
+        return false;
+    }
+
+    struct FDictionaryString
+    {
+        const uint8* Data;
+        int32 Length;
+    };
+
+    // Index 0 stands for "no category"
+    TArray<FDictionaryString> Dictionary;
+    Dictionary.Add(FDictionaryString{ nullptr, 0 });
+    TMap<uint32, FName> CategoryNames;
+
+    int64 Ticks = 0;
+    uint64 FrameCounter = 0;
+
+    FLogBinaryReader Reader(Data + sizeof(FFileHeader), Length - sizeof(FFileHeader));
+    while (!Reader.AtEnd())
+    {
+        const uint8 RecordType = Reader.ReadByte();
+        switch (RecordType)
+        {
+        case String:
+        {
+            const uint64 Id = Reader.ReadVarint();
+            const uint64 StringLength = Reader.ReadVarint();
+            const uint8* StringData = Reader.ReadBytes(StringLength);
+            if (Reader.bError || Id != (uint64)Dictionary.Num())
+            {
+                return false;
+            }
+            Dictionary.Add(FDictionaryString{ StringData, (int32)StringLength });
+            break;
+        }
+
+        case Line:
+        case InternedLine:
+        {
+            Ticks += ZigZagDecode(Reader.ReadVarint());
+            FrameCounter += (uint64)ZigZagDecode(Reader.ReadVarint());
+            const uint8 Flags = Reader.ReadByte();
+            const uint64 CategoryId = Reader.ReadVarint();
+
+            const uint8* MessageData = nullptr;
+            int32 MessageLength = 0;
+            if (RecordType == InternedLine)
+            {
+                const uint64 MessageId = Reader.ReadVarint();
+                if (MessageId == 0 || MessageId >= (uint64)Dictionary.Num())
+                {
+                    return false;
+                }
+                MessageData = Dictionary[MessageId].Data;
+                MessageLength = Dictionary[MessageId].Length;
+            }
+            else
+            {
+                const uint64 InlineLength = Reader.ReadVarint();
+                MessageData = Reader.ReadBytes(InlineLength);
+                MessageLength = (int32)InlineLength;
+            }
+
+            if (Reader.bError || CategoryId >= (uint64)Dictionary.Num())
+            {
+                return false;
+            }
+
+            FName Category = NAME_None;
+            if (CategoryId != 0)
+            {
+                FName* FoundName = CategoryNames.Find((uint32)CategoryId);
+                if (!FoundName)
+                {
+                    const FDictionaryString& Name = Dictionary[CategoryId];
+                    FUTF8ToTCHAR NameText((const ANSICHAR*)Name.Data, Name.Length);
+                    FoundName = &CategoryNames.Add((uint32)CategoryId, FName(*FString(NameText.Length(), NameText.Get())));
+                }
+                Category = *FoundName;
+            }
+
+            FUTF8ToTCHAR Message((const ANSICHAR*)MessageData, MessageLength);
+            const int32 Offset = OutText.AddUninitialized(FLogLineFormatter::GetMaxEncodedLength(Category, Message.Length()));
+            const int32 EncodedLength = FLogLineFormatter::EncodeLogLine(OutText.GetData() + Offset, (ELogVerbosity::Type)(Flags & VerbosityMask),
+                Category, Message.Get(), Message.Length(), Ticks, FrameCounter, (Flags & LineTerminator) != 0);
+            OutText.SetNum(Offset + EncodedLength, false);
+            break;
+        }
+
+        case Raw:
+        {
+            const uint64 RawLength = Reader.ReadVarint();
+            const uint8* RawData = Reader.ReadBytes(RawLength);
+            if (Reader.bError)
+            {
+                return false;
+            }
+            OutText.Append(RawData, (int32)RawLength);
+            break;
+        }
+
+        default:
+            return false;
+        }
+    }
+
+    return !Reader.bError;
+}
+
+bool FLogBinaryFormat::DecodeFile(const FString& BinaryFilename, const FString& TextFilename)
+{
+    TArray<uint8> FileData;
+    if (!FFileHelper::LoadFileToArray(FileData, *BinaryFilename))
+    {
+        return false;
+    }
+
+    // Segments compressed after rotation, or written compressed, decode up to their last complete frame
+    bool bComplete = true;
+    TArray<uint8> Decompressed;
+    if (FileData.Num() >= (int32)sizeof(FLogCompressedFormat::FFileHeader) &&
+        ((const FLogCompressedFormat::FFileHeader*)FileData.GetData())->Magic == FLogCompressedFormat::Magic)
+    {
+        bComplete = FLogCompressedFormat::Decompress(FileData.GetData(), FileData.Num(), Decompressed);
+        Exchange(FileData, Decompressed);
+    }
+
+    if (!IsBinaryLog(FileData.GetData(), FileData.Num()))
+    {
+        return false;
+    }
+
+    // Text log files start with a UTF-8 byte order mark
+    TArray<uint8> Text;
+    Text.Add(0xEF);
+    Text.Add(0xBB);
+    Text.Add(0xBF);
+    bComplete &= Decode(FileData.GetData(), FileData.Num(), Text);
+
+    return FFileHelper::SaveArrayToFile(Text, *TextFilename) && bComplete;
+}
+
+FLogBinaryEncoder::FLogBinaryEncoder()
+{
+    Reset();
+}
+
+void FLogBinaryEncoder::Reset()
+{
+    bHeaderWritten = false;
+    LastTicks = 0;
+    LastFrameCounter = 0;
+    NextStringId = 1;
+    CategoryIds.Reset();
+    Messages.Reset();
+    NumInternedMessages = 0;
+    InternedText.Reset();
+}
+
+void FLogBinaryEncoder::EncodeLine(TArray<uint8>& Out, ELogVerbosity::Type Verbosity, const class FName& Category, const TCHAR* Message, int32 MessageLength,
+    int64 Ticks, uint64 FrameCounter, bool bLineTerminator)
+{
+    BeginRecord(Out);
+
+    const uint32 CategoryId = Category == NAME_None ? 0 : InternCategory(Out, Category);
+
+    if (MessageScratch.Num() < MessageLength * FLogLineFormatter::MaxBytesPerChar)
+    {
+        MessageScratch.SetNumUninitialized(MessageLength * FLogLineFormatter::MaxBytesPerChar, false);
+    }
+    const int32 Utf8Length = (int32)(FLogLineFormatter::EncodeUTF8(MessageScratch.GetData(), Message, MessageLength) - MessageScratch.GetData());
+
+    const uint32 MessageId = Utf8Length <= FLogBinaryFormat::MaxInternedLength ? InternMessage(Out, MessageScratch.GetData(), Utf8Length) : 0;
+
+    Out.Add(MessageId != 0 ? FLogBinaryFormat::InternedLine : FLogBinaryFormat::Line);
+    WriteVarint(Out, ZigZagEncode(Ticks - LastTicks));
+    WriteVarint(Out, ZigZagEncode((int64)(FrameCounter - LastFrameCounter)));
+    Out.Add((uint8)((Verbosity & FLogBinaryFormat::VerbosityMask) | (bLineTerminator ? FLogBinaryFormat::LineTerminator : 0)));
+    WriteVarint(Out, CategoryId);
+
+    if (MessageId != 0)
+    {
+        WriteVarint(Out, MessageId);
+    }
+    else
+    {
+        WriteVarint(Out, Utf8Length);
+        Out.Append(MessageScratch.GetData(), Utf8Length);
+    }
+
+    LastTicks = Ticks;
+    LastFrameCounter = FrameCounter;
+}
+
+void FLogBinaryEncoder::EncodeRaw(TArray<uint8>& Out, const uint8* Data, int32 Length)
+{
+    BeginRecord(Out);
+
+    Out.Add(FLogBinaryFormat::Raw);
+    WriteVarint(Out, Length);
+    Out.Append(Data, Length);
+}
+
+void FLogBinaryEncoder::BeginRecord(TArray<uint8>& Out)
+{
+    if (!bHeaderWritten)
+    {
+        FLogBinaryFormat::FFileHeader Header{ FLogBinaryFormat::Magic, FLogBinaryFormat::Version };
+        Out.Append((const uint8*)&Header, sizeof(Header));
+        bHeaderWritten = true;
+    }
+}
+
+uint32 FLogBinaryEncoder::InternCategory(TArray<uint8>& Out, const class FName& Category)
+{
+    if (const uint32* FoundId = CategoryIds.Find(Category))
+    {
+        return *FoundId;
+    }
+
+    TArray<uint8> Name;
+    Name.AddUninitialized(FLogLineFormatter::GetMaxCategoryLength(Category));
+    const int32 NameLength = (int32)(FLogLineFormatter::EncodeCategory(Name.GetData(), Category) - Name.GetData());
+
+    const uint32 Id = NextStringId++;
+    CategoryIds.Add(Category, Id);
+    WriteString(Out, Id, Name.GetData(), NameLength);
+    return Id;
+}
+
+uint32 FLogBinaryEncoder::InternMessage(TArray<uint8>& Out, const uint8* Message, int32 Length)
+{
+    const uint32 Hash = FCrc::MemCrc32(Message, Length);
+
+    FInternedMessage* Found = Messages.Find(Hash);
+    if (!Found)
+    {
+        // One-off messages (most of them carry numbers) would only bloat the dictionary, remember it and wait for a repeat
+        if (Messages.Num() < FLogBinaryFormat::MaxInternCandidates)
+        {
+            Messages.Add(Hash, FInternedMessage{ 0, 0, 0 });
+        }
+        return 0;
+    }
+
+    if (Found->Id != 0)
+    {
+        const bool bSameMessage = Found->Length == Length && FMemory::Memcmp(InternedText.GetData() + Found->Offset, Message, Length) == 0;
+        return bSameMessage ? Found->Id : 0;
+    }
+
+    if (NumInternedMessages >= FLogBinaryFormat::MaxInternedMessages)
+    {
+        return 0;
+    }
+
+    Found->Id = NextStringId++;
+    Found->Offset = InternedText.Num();
+    Found->Length = Length;
+    InternedText.Append(Message, Length);
+    ++NumInternedMessages;
+
+    WriteString(Out, Found->Id, Message, Length);
+    return Found->Id;
+}
+
+void FLogBinaryEncoder::WriteString(TArray<uint8>& Out, uint32 Id, const uint8* Data, int32 Length)
+{
+    Out.Add(FLogBinaryFormat::String);
+    WriteVarint(Out, Id);
+    WriteVarint(Out, Length);
+    Out.Append(Data, Length);
+}
+
+void FLogBinaryEncoder::WriteVarint(TArray<uint8>& Out, uint64 Value)
+{
+    while (Value >= 0x80)
+    {
+        Out.Add((uint8)(Value | 0x80));
+        Value >>= 7;
+    }
+    Out.Add((uint8)Value);
+}
+
+/** Decodes a binary log file to text, e.g. "LogManager.DecodeBinaryLog Saved/Logs/Game/LogNet.binlog" writes Saved/Logs/Game/LogNet.log */
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogDecodeBinaryCommand(
+    TEXT("LogManager.DecodeBinaryLog"),
+    TEXT("Turns a binary log file back into text. Usage: LogManager.DecodeBinaryLog <BinaryFile> [TextFile]"),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+    {
+        if (Args.Num() < 1)
+        {
+            Ar.Log(TEXT("Usage: LogManager.DecodeBinaryLog <BinaryFile> [TextFile]"));
+            return;
+        }
+
+        const FString& BinaryFilename = Args[0];
+        FString TextFilename;
+        if (Args.Num() > 1)
+        {
+            TextFilename = Args[1];
+        }
+        else
+        {
+            TextFilename = BinaryFilename;
+            TextFilename.RemoveFromEnd(FLogCompressedFormat::GetExtension());
+            TextFilename = FPaths::ChangeExtension(TextFilename, TEXT(".log"));
+        }
+
+        if (ILogManager::Get().DecodeBinaryLog(BinaryFilename, TextFilename))
+        {
+            Ar.Logf(TEXT("Decoded %s to %s"), *BinaryFilename, *TextFilename);
+        }
+        else
+        {
+            Ar.Logf(TEXT("Failed to decode %s completely"), *BinaryFilename);
+        }
+    }));
@@ -0,0 +1,138 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "Containers/Array.h"
+#include "Containers/Map.h"
+#include "Containers/UnrealString.h"
+#include "Logging/LogVerbosity.h"
+#include "UObject/NameTypes.h"
+
+/**
+ * Compact binary format of log files, written instead of text for the categories picked with -LOGBINARY.
+ *
+ * A file header is followed by records, each starting with its ERecordType byte. Numbers are LEB128 varints,
+ * timestamps (FDateTime ticks) and frame counters are stored as zigzag deltas from the previous line. Category
+ * names, and messages seen at least twice, are added to a per-file dictionary once and referenced by id after
+ * that. Every rotated segment starts over with a new header and an empty dictionary, so each file decodes on its own.
+ */
+struct FLogBinaryFormat
+{
+    enum EConstants
+    {
+        /** 'LOGB' */
+        Magic = 0x42474F4C,
+        Version = 1,
+        /** Longest message interned in the dictionary, in UTF-8 bytes */
+        MaxInternedLength = 256,
+        /** Most messages interned per file */
+        MaxInternedMessages = 4096,
+        /** Most distinct messages remembered as interning candidates per file */
+        MaxInternCandidates = 16384
+    };
+
+    enum ERecordType
+    {
+        /** varint id, varint length, UTF-8 bytes: adds a category name or message to the dictionary */
+        String = 0,
+        /** Line with its message inline: ticks delta, frame delta, flags, category id, varint length, UTF-8 message */
+        Line = 1,
+        /** Line whose message is in the dictionary: ticks delta, frame delta, flags, category id, message id */
+        InternedLine = 2,
+        /** varint length, bytes written to the text as is */
+        Raw = 3
+    };
+
+    enum ELineFlags
+    {
+        /** ELogVerbosity::Type of the line */
+        VerbosityMask = 0x0F,
+        /** A line terminator is appended to the message */
+        LineTerminator = 0x10
+    };
+
+    struct FFileHeader
+    {
+        uint32 Magic;
+        uint32 Version;
+    };
+
+    /** Extension of binary log files */
+    static const TCHAR* GetExtension()
+    {
+        return TEXT(".binlog");
+    }
+
+    /** Whether Data starts with a binary log file header */
+    static bool IsBinaryLog(const uint8* Data, int64 Length);
+
+    /**
+     * Turns a binary log file held in memory back into the UTF-8 text the log file would have had
+     * @return false if the data isn't a binary log file or is truncated, OutText then holds the lines decoded up to the error
+     */
+    static bool Decode(const uint8* Data, int64 Length, TArray<uint8>& OutText);
+
+    /**
+     * Decodes BinaryFilename, compressed or not, into the text log TextFilename
+     * @return false if the file couldn't be read or decoded completely, the lines decoded so far are still written
+     */
+    static bool DecodeFile(const FString& BinaryFilename, const FString& TextFilename);
+};
+
+/**
+ * [WRITER THREAD] Encodes log lines as FLogBinaryFormat records.
+ * Keeps the dictionary and the last timestamp of the file being written, Reset() when a new file is started.
+ */
+class FLogBinaryEncoder
+{
+public:
+    FLogBinaryEncoder();
+
+    /** Forgets the dictionary and timestamps, the next record starts a new file with its header */
+    void Reset();
+
+    /** Appends the records of a log line, including any new dictionary strings, to Out */
+    void EncodeLine(TArray<uint8>& Out, ELogVerbosity::Type Verbosity, const class FName& Category, const TCHAR* Message, int32 MessageLength,
+        int64 Ticks, uint64 FrameCounter, bool bLineTerminator);
+
+    /** Appends a record of bytes written as they are, e.g. preformatted text */
+    void EncodeRaw(TArray<uint8>& Out, const uint8* Data, int32 Length);
+
+private:
+    struct FInternedMessage
+    {
+        /** Dictionary id, 0 while the message has been seen only once */
+        uint32 Id;
+        /** Location of the message in InternedText */
+        int32 Offset;
+        int32 Length;
+    };
+
+    /** Writes the file header if this is the first record of the file */
+    void BeginRecord(TArray<uint8>& Out);
+
+    /** Dictionary id of Category, adding it to the dictionary first if needed */
+    uint32 InternCategory(TArray<uint8>& Out, const class FName& Category);
+
+    /** Dictionary id of a UTF-8 message, or 0 if the message is written inline */
+    uint32 InternMessage(TArray<uint8>& Out, const uint8* Message, int32 Length);
+
+    /** Appends a dictionary string record */
+    void WriteString(TArray<uint8>& Out, uint32 Id, const uint8* Data, int32 Length);
+
+    static void WriteVarint(TArray<uint8>& Out, uint64 Value);
+
+    bool bHeaderWritten;
+    int64 LastTicks;
+    uint64 LastFrameCounter;
+    /** Next dictionary id, ids start at 1 so 0 can mean no category */
+    uint32 NextStringId;
+    TMap<FName, uint32> CategoryIds;
+    /** Messages by CRC, seen once or interned */
+    TMap<uint32, FInternedMessage> Messages;
+    int32 NumInternedMessages;
+    /** UTF-8 text of the interned messages, to make sure a CRC match is the same message */
+    TArray<uint8> InternedText;
+    /** UTF-8 scratch of the message being encoded */
+    TArray<uint8> MessageScratch;
+};
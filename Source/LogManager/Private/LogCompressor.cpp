@@ -0,0 +1,292 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#include "LogManagerPrivatePCH.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Compression.h"
+
+void FLogCompressedFormat::WriteFileHeader(FArchive& Ar)
+{
+    FFileHeader Header{ Magic, Version };
+    Ar.Serialize(&Header, sizeof(Header));
+}
+
+bool FLogCompressedFormat::AppendFrame(const uint8* Data, int32 Length, TArray<uint8>& OutFrames)
+{
+    const int32 Offset = OutFrames.Num();
+    int32 CompressedSize = FCompression::CompressMemoryBound(COMPRESS_ZLIB, Length);
+    OutFrames.AddUninitialized(sizeof(FFrameHeader) + CompressedSize);
+
+    if (!FCompression::CompressMemory(COMPRESS_ZLIB, OutFrames.GetData() + Offset + sizeof(FFrameHeader), CompressedSize, Data, Length))
+    {
+        OutFrames.SetNum(Offset, false);
+        return false;
+    }
+
+    FFrameHeader* Header = (FFrameHeader*)(OutFrames.GetData() + Offset);
+    Header->UncompressedSize = (uint32)Length;
+    Header->CompressedSize = (uint32)CompressedSize;
+    OutFrames.SetNum(Offset + sizeof(FFrameHeader) + CompressedSize, false);
+    return true;
+}
+
+bool FLogCompressedFormat::Decompress(const uint8* Data, int64 Length, TArray<uint8>& OutData)
+{
+    if (Length < (int64)sizeof(FFileHeader) || ((const FFileHeader*)Data)->Magic != Magic || ((const FFileHeader*)Data)->Version != Version)
+    {
+        return false;
+    }
+
+    int64 Offset = sizeof(FFileHeader);
+    while (Offset + (int64)sizeof(FFrameHeader) <= Length)
+    {
+        const FFrameHeader* Header = (const FFrameHeader*)(Data + Offset);
+        Offset += sizeof(FFrameHeader);
+        if (Offset + Header->CompressedSize > Length || Header->UncompressedSize > FrameSize)
+        {
+            // Truncated by a crash, everything before it is good
+            return false;
+        }
+
+        const int32 OutOffset = OutData.AddUninitialized(Header->UncompressedSize);
+        if (!FCompression::UncompressMemory(COMPRESS_ZLIB, OutData.GetData() + OutOffset, Header->UncompressedSize, Data + Offset, Header->CompressedSize))
+        {
+            OutData.SetNum(OutOffset, false);
+            return false;
+        }
+        Offset += Header->CompressedSize;
+    }
+
+    return Offset == Length;
+}
+
+bool FLogCompressedFormat::CompressFile(const FString& SourceFilename, const FString& DestFilename)
+{
+    TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*SourceFilename, FILEREAD_AllowWrite));
+    if (!Reader)
+    {
+        return false;
+    }
+
+    TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*DestFilename));
+    if (!Writer)
+    {
+        return false;
+    }
+
+    WriteFileHeader(*Writer);
+
+    TArray<uint8> FrameData;
+    FrameData.AddUninitialized(FrameSize);
+    TArray<uint8> CompressedFrame;
+
+    bool bSuccess = true;
+    int64 Remaining = Reader->TotalSize();
+    while (Remaining > 0 && bSuccess)
+    {
+        const int32 Length = (int32)FMath::Min<int64>(Remaining, FrameSize);
+        Reader->Serialize(FrameData.GetData(), Length);
+        Remaining -= Length;
+
+        CompressedFrame.Reset();
+        bSuccess = !Reader->IsError() && AppendFrame(FrameData.GetData(), Length, CompressedFrame);
+        if (bSuccess)
+        {
+            Writer->Serialize(CompressedFrame.GetData(), CompressedFrame.Num());
+        }
+    }
+
+    bSuccess &= Writer->Close() && !Writer->IsError();
+    Writer.Reset();
+
+    if (!bSuccess)
+    {
+        IFileManager::Get().Delete(*DestFilename);
+    }
+    return bSuccess;
+}
+
+FLogCompressedArchive::FLogCompressedArchive(FArchive* InInner)
+    : Inner(InInner)
+{
+    ArIsSaving = true;
+    FrameData.Reserve(FLogCompressedFormat::FrameSize);
+    FLogCompressedFormat::WriteFileHeader(*Inner);
+}
+
+FLogCompressedArchive::~FLogCompressedArchive()
+{
+    WriteFrame();
+    delete Inner;
+    Inner = nullptr;
+}
+
+void FLogCompressedArchive::Serialize(void* Data, int64 Length)
+{
+    const uint8* Source = (const uint8*)Data;
+    while (Length > 0)
+    {
+        const int32 Copied = (int32)FMath::Min<int64>(Length, FLogCompressedFormat::FrameSize - FrameData.Num());
+        FrameData.Append(Source, Copied);
+        Source += Copied;
+        Length -= Copied;
+
+        if (FrameData.Num() == FLogCompressedFormat::FrameSize)
+        {
+            WriteFrame();
+        }
+    }
+}
+
+void FLogCompressedArchive::Flush()
+{
+    WriteFrame();
+    Inner->Flush();
+}
+
+void FLogCompressedArchive::WriteFrame()
+{
+    if (FrameData.Num() == 0)
+    {
+        return;
+    }
+
+    CompressedFrame.Reset();
+    if (FLogCompressedFormat::AppendFrame(FrameData.GetData(), FrameData.Num(), CompressedFrame))
+    {
+        Inner->Serialize(CompressedFrame.GetData(), CompressedFrame.Num());
+    }
+    FrameData.Reset();
+}
+
+FLogCompressor::FLogCompressor()
+    : Thread(nullptr)
+    , WakeEvent(FPlatformProcess::GetSynchEventFromPool(false))
+{
+    Thread = FRunnableThread::Create(this, TEXT("LogCompressorThread"), 0, TPri_Lowest);
+}
+
+FLogCompressor::~FLogCompressor()
+{
+    if (Thread)
+    {
+        Thread->Kill(true);
+        delete Thread;
+        Thread = nullptr;
+    }
+
+    FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+    WakeEvent = nullptr;
+}
+
+void FLogCompressor::EnqueueFile(const FString& Filename)
+{
+    {
+        FScopeLock QueueLock(&QueueCritical);
+        Queue.Add(Filename);
+    }
+    WakeEvent->Trigger();
+}
+
+bool FLogCompressor::Init()
+{
+    return true;
+}
+
+uint32 FLogCompressor::Run()
+{
+    for (;;)
+    {
+        FString Filename;
+        {
+            FScopeLock QueueLock(&QueueCritical);
+            if (Queue.Num() > 0)
+            {
+                Filename = Queue[0];
+                Queue.RemoveAt(0);
+            }
+        }
+
+        if (Filename.IsEmpty())
+        {
+            // The last segments of the files are only queued when they are closed at shutdown, don't leave them behind
+            if (StopTaskCounter.GetValue() != 0)
+            {
+                break;
+            }
+
+            WakeEvent->Wait();
+            continue;
+        }
+
+        // The source is only deleted once its compressed copy is complete
+        if (FLogCompressedFormat::CompressFile(Filename, Filename + FLogCompressedFormat::GetExtension()))
+        {
+            IFileManager::Get().Delete(*Filename);
+        }
+    }
+    return 0;
+}
+
+void FLogCompressor::Stop()
+{
+    StopTaskCounter.Increment();
+    WakeEvent->Trigger();
+}
+
+/** Compares writing raw and compressed log text, e.g. "LogManager.CompressionBenchmark 64" for 64MB of text */
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogCompressionBenchmarkCommand(
+    TEXT("LogManager.CompressionBenchmark"),
+    TEXT("Measures raw and compressed log output throughput. Usage: LogManager.CompressionBenchmark [MB]"),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+    {
+        const int32 SizeMB = Args.Num() > 0 ? FMath::Clamp(FCString::Atoi(*Args[0]), 1, 1024) : 64;
+        const int64 Size = (int64)SizeMB * 1024 * 1024;
+
+        // Synthetic but log shaped text: repeated prefixes, varying numbers
+        TArray<uint8> Text;
+        Text.Reserve(Size + 256);
+        for (int32 LineIndex = 0; Text.Num() < Size; ++LineIndex)
+        {
+            const FString Line = FString::Printf(TEXT("[2017.01.01-12.00.%02d:%03d][%3d]LogNet: Warning: Actor %d replicated %d properties in %.3f ms\r\n"),
+                (LineIndex / 1000) % 60, LineIndex % 1000, LineIndex % 1000, LineIndex * 7 % 10007, LineIndex % 97, (LineIndex % 1000) * 0.013f);
+            FTCHARToUTF8 Utf8Line(*Line);
+            Text.Append((const uint8*)Utf8Line.Get(), Utf8Line.Length());
+        }
+
+        const FString RawFilename = FPaths::CreateTempFilename(*FPaths::GameSavedDir(), TEXT("LogBench"), TEXT(".log"));
+        const FString CompressedFilename = RawFilename + FLogCompressedFormat::GetExtension();
+
+        double StartTime = FPlatformTime::Seconds();
+        {
+            TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*RawFilename));
+            for (int64 Offset = 0; Writer && Offset < Text.Num(); Offset += FLogCompressedFormat::FrameSize)
+            {
+                Writer->Serialize(Text.GetData() + Offset, FMath::Min<int64>(FLogCompressedFormat::FrameSize, Text.Num() - Offset));
+            }
+        }
+        const double RawSeconds = FPlatformTime::Seconds() - StartTime;
+
+        StartTime = FPlatformTime::Seconds();
+        if (FArchive* CompressedFile = IFileManager::Get().CreateFileWriter(*CompressedFilename))
+        {
+            FLogCompressedArchive Writer(CompressedFile);
+            for (int64 Offset = 0; Offset < Text.Num(); Offset += FLogCompressedFormat::FrameSize)
+            {
+                Writer.Serialize(Text.GetData() + Offset, FMath::Min<int64>(FLogCompressedFormat::FrameSize, Text.Num() - Offset));
+            }
+        }
+        const double CompressedSeconds = FPlatformTime::Seconds() - StartTime;
+
+        const int64 RawBytes = IFileManager::Get().FileSize(*RawFilename);
+        const int64 CompressedBytes = IFileManager::Get().FileSize(*CompressedFilename);
+        IFileManager::Get().Delete(*RawFilename);
+        IFileManager::Get().Delete(*CompressedFilename);
+
+        const double MB = 1024.0 * 1024.0;
+        Ar.Logf(TEXT("Log compression benchmark, %d MB of text"), SizeMB);
+        Ar.Logf(TEXT("  raw:        %.1f MB/s in, %.1f MB/s out, %lld bytes"), Text.Num() / MB / RawSeconds, RawBytes / MB / RawSeconds, RawBytes);
+        Ar.Logf(TEXT("  compressed: %.1f MB/s in, %.1f MB/s out, %lld bytes, ratio %.1f:1"), Text.Num() / MB / CompressedSeconds,
+            CompressedBytes / MB / CompressedSeconds, CompressedBytes, CompressedBytes > 0 ? (double)RawBytes / CompressedBytes : 0.0);
+    }));
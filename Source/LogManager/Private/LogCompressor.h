@@ -0,0 +1,126 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "HAL/CriticalSection.h"
+#include "HAL/Event.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Containers/Array.h"
+#include "Containers/UnrealString.h"
+#include "Serialization/Archive.h"
+
+/**
+ * Framed zlib format of compressed log files.
+ *
+ * A file header is followed by frames of at most FrameSize uncompressed bytes. Every frame is compressed on its
+ * own, so a truncated file (a crash while the live stream is compressed) still decodes up to its last complete frame.
+ */
+struct FLogCompressedFormat
+{
+    enum EConstants
+    {
+        /** 'LOGZ' */
+        Magic = 0x5A474F4C,
+        Version = 1,
+        FrameSize = 256 * 1024
+    };
+
+    struct FFileHeader
+    {
+        uint32 Magic;
+        uint32 Version;
+    };
+
+    struct FFrameHeader
+    {
+        uint32 UncompressedSize;
+        uint32 CompressedSize;
+    };
+
+    /** Extension appended to the name of a compressed log file */
+    static const TCHAR* GetExtension()
+    {
+        return TEXT(".z");
+    }
+
+    /** Writes the file header to Ar */
+    static void WriteFileHeader(FArchive& Ar);
+
+    /**
+     * Compresses Data into a frame appended to OutFrames
+     * @return false if the engine failed to compress the data
+     */
+    static bool AppendFrame(const uint8* Data, int32 Length, TArray<uint8>& OutFrames);
+
+    /**
+     * Decompresses a whole compressed log file held in memory
+     * @return false if the data isn't a compressed log file, OutData then holds the frames decoded up to the error
+     */
+    static bool Decompress(const uint8* Data, int64 Length, TArray<uint8>& OutData);
+
+    /** Compresses SourceFilename into DestFilename, false if either file couldn't be used */
+    static bool CompressFile(const FString& SourceFilename, const FString& DestFilename);
+};
+
+/**
+ * Archive compressing everything written to it into independent frames of the inner archive.
+ * A frame is cut when FrameSize bytes are buffered and on every Flush(), so flushed data is always decodable.
+ * Small frames compress poorly, only call Flush() when the data has to be on disk.
+ */
+class FLogCompressedArchive : public FArchive
+{
+public:
+    /** Takes ownership of InInner */
+    explicit FLogCompressedArchive(FArchive* InInner);
+    virtual ~FLogCompressedArchive();
+
+    //~ Begin FArchive Interface.
+    virtual void Serialize(void* Data, int64 Length) override;
+    virtual void Flush() override;
+    //~ End FArchive Interface
+
+private:
+    /** Compresses the buffered bytes into a frame of the inner archive */
+    void WriteFrame();
+
+    FArchive* Inner;
+    /** Bytes of the frame being filled */
+    TArray<uint8> FrameData;
+    /** Compressed frame scratch */
+    TArray<uint8> CompressedFrame;
+};
+
+/**
+ * Low priority thread compressing closed log segments.
+ * Each file is compressed next to itself with FLogCompressedFormat::GetExtension() appended and then deleted.
+ * Stopping it finishes the files already queued first.
+ */
+class FLogCompressor : public FRunnable
+{
+public:
+    FLogCompressor();
+    virtual ~FLogCompressor();
+
+    /** Queues a closed file, callable from any thread */
+    void EnqueueFile(const FString& Filename);
+
+    //~ Begin FRunnable Interface.
+    virtual bool Init() override;
+    virtual uint32 Run() override;
+    virtual void Stop() override;
+    //~ End FRunnable Interface
+
+private:
+    /** Thread to run the worker FRunnable on */
+    FRunnableThread* Thread;
+    /** Stops this thread */
+    FThreadSafeCounter StopTaskCounter;
+    /** Triggered when a file is queued */
+    FEvent* WakeEvent;
+    /** Files waiting to be compressed, guarded by QueueCritical */
+    TArray<FString> Queue;
+    /** Sync object for the Queue array */
+    FCriticalSection QueueCritical;
+};
@@ -0,0 +1,104 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#include "LogManagerPrivatePCH.h"
+
+const uint64 FLogFilterTable::UncachedFiltersBit;
+
+void FLogFilterTable::RebuildIndices()
+{
+    CategoryIndices.Reset();
+    for (int32 Index = 1; Index < Filters.Num(); ++Index)
+    {
+        CategoryIndices.Add(FName(*Filters[Index].Category), Index);
+    }
+
+    for (FLogRouteRule& Rule : Rules)
+    {
+        Rule.SinkMask = 0;
+        Rule.UncachedSinks.Reset();
+        for (const FString& Sink : Rule.Sinks)
+        {
+            const int32* SinkIndex = CategoryIndices.Find(FName(*Sink));
+            if (!SinkIndex)
+            {
+                continue;
+            }
+
+            if (*SinkIndex < MaxCachedFilters)
+            {
+                Rule.SinkMask |= 1ull << *SinkIndex;
+            }
+            else
+            {
+                Rule.UncachedSinks.Add(*SinkIndex);
+            }
+        }
+    }
+}
+
+uint64 FLogFilterTable::ComputeRoute(const class FName& Category) const
+{
+    uint64 Route = 0;
+
+    const int32* FoundIndex = CategoryIndices.Find(Category);
+    if (FoundIndex && Filters[*FoundIndex].bSingleCategory)
+    {
+        Route |= *FoundIndex < MaxCachedFilters ? 1ull << *FoundIndex : UncachedFiltersBit;
+    }
+
+    if (Rules.Num() > 0)
+    {
+        const FString CategoryName = Category.ToString();
+        for (const FLogRouteRule& Rule : Rules)
+        {
+            if (CategoryName.MatchesWildcard(Rule.Pattern, ESearchCase::IgnoreCase))
+            {
+                Route |= Rule.SinkMask | (Rule.UncachedSinks.Num() > 0 ? UncachedFiltersBit : 0);
+            }
+        }
+    }
+
+    // Everything else goes to the default log file
+    if (Route == 0 && Filters.Num() > 0)
+    {
+        Route = 1;
+    }
+
+    return Route;
+}
+
+FLogFilterRegistry::FLogFilterRegistry()
+    : Table(new FLogFilterTable())
+    , Epoch(0)
+{
+    FMemory::Memzero(ReaderSlots);
+}
+
+FLogFilterRegistry::~FLogFilterRegistry()
+{
+    delete Table;
+    Table = nullptr;
+}
+
+void FLogFilterRegistry::Publish(FLogFilterTable* NewTable)
+{
+    FLogFilterTable* OldTable = (FLogFilterTable*)FPlatformAtomics::InterlockedExchangePtr((void**)&Table, NewTable);
+
+    // Two flips: a reader may have sampled the epoch before the first one and only counted itself after the first wait,
+    // it then loads the new table, but may still be reading the previous update's table on the next update
+    for (int32 Flip = 0; Flip < 2; ++Flip)
+    {
+        const int32 OldParity = Epoch & 1;
+        FPlatformAtomics::InterlockedIncrement(&Epoch);
+
+        for (int32 SlotIndex = 0; SlotIndex < NumReaderSlots; ++SlotIndex)
+        {
+            while (ReaderSlots[SlotIndex].Readers[OldParity] != 0)
+            {
+                FPlatformProcess::Sleep(0.0f);
+            }
+        }
+    }
+
+    delete OldTable;
+}
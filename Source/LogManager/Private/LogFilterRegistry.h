@@ -0,0 +1,338 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "Containers/Array.h"
+#include "Containers/Map.h"
+#include "Containers/UnrealString.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/PlatformAtomics.h"
+#include "HAL/PlatformTLS.h"
+#include "Logging/LogVerbosity.h"
+#include "Misc/ScopeLock.h"
+#include "UObject/NameTypes.h"
+
+class FLogAsyncWriter;
+class FLogFlightRecorder;
+
+/** Log file of a category (AddFilter) or of the categories routed to it (AddRoute) */
+struct FLogFilter
+{
+    /** Category of a single category filter, sink name of a routed one, empty for the default log file */
+    FString Category;
+    FLogAsyncWriter* AsyncWriter;
+    ELogVerbosity::Type FlushOn;
+    /** Lines of a disabled filter's category are dropped, its file stays open */
+    bool bEnabled;
+    /** Whether the file holds Category's lines only, they are written without the category name then */
+    bool bSingleCategory;
+
+    friend bool operator==(const FLogFilter& Lhs, const FLogFilter& Rhs)
+    {
+        return Lhs.Category.Equals(Rhs.Category, ESearchCase::IgnoreCase);
+    }
+};
+
+/** Sends the categories matching a wildcard pattern, e.g. "LogNet*", to one or more filters */
+struct FLogRouteRule
+{
+    /** Case-insensitive, '*' matches any run of characters and '?' a single one */
+    FString Pattern;
+    /** Names of the filters the lines go to */
+    TArray<FString> Sinks;
+    /** Bit per index in FLogFilterTable::Filters of the sinks below MaxCachedFilters, rebuilt with the table */
+    uint64 SinkMask;
+    /** Indices in FLogFilterTable::Filters of the other sinks, rebuilt with the table */
+    TArray<int32> UncachedSinks;
+};
+
+/**
+ * Routes of the categories seen so far, as a bit per filter index, in a fixed size open addressing hash table.
+ * Logging threads fill it lock-free the first time they meet a category, every line after that is a probe.
+ * When the table is full, or the probe runs too long, a category is routed afresh for every line.
+ */
+class FLogRouteCache
+{
+    enum EConstants
+    {
+        /** Power of two */
+        Capacity = 4096,
+        MaxProbes = 32
+    };
+
+    struct FEntry
+    {
+        /** MakeKey of the category, 0 for a free entry */
+        volatile int64 Key;
+        /** 0 until the claiming thread has stored the route */
+        volatile int64 Route;
+    };
+
+public:
+    FLogRouteCache()
+        : Entries(new FEntry[Capacity])
+    {
+        FMemory::Memzero(Entries, sizeof(FEntry) * Capacity);
+    }
+
+    /** A copied table may route differently, its cache starts out empty */
+    FLogRouteCache(const FLogRouteCache&)
+        : FLogRouteCache()
+    {
+    }
+
+    FLogRouteCache& operator=(const FLogRouteCache&) = delete;
+
+    ~FLogRouteCache()
+    {
+        delete[] Entries;
+    }
+
+    static uint64 MakeKey(const class FName& Category)
+    {
+        return (((uint64)(uint32)Category.GetNumber() << 32) | (uint32)Category.GetComparisonIndex()) + 1;
+    }
+
+    bool Find(uint64 Key, uint64& OutRoute) const
+    {
+        for (uint32 Probe = 0, Index = GetHomeIndex(Key); Probe < MaxProbes; ++Probe, Index = (Index + 1) & (Capacity - 1))
+        {
+            const uint64 EntryKey = (uint64)Entries[Index].Key;
+            if (EntryKey == Key)
+            {
+                OutRoute = (uint64)Entries[Index].Route;
+                return OutRoute != 0;
+            }
+
+            if (EntryKey == 0)
+            {
+                break;
+            }
+        }
+
+        return false;
+    }
+
+    /** Remembers a non-zero Route of Key, threads racing on the same category store the same route */
+    void Add(uint64 Key, uint64 Route)
+    {
+        for (uint32 Probe = 0, Index = GetHomeIndex(Key); Probe < MaxProbes; ++Probe, Index = (Index + 1) & (Capacity - 1))
+        {
+            const int64 EntryKey = FPlatformAtomics::InterlockedCompareExchange(&Entries[Index].Key, (int64)Key, 0);
+            if (EntryKey == 0)
+            {
+                FPlatformAtomics::InterlockedExchange(&Entries[Index].Route, (int64)Route);
+                return;
+            }
+
+            if ((uint64)EntryKey == Key)
+            {
+                return;
+            }
+        }
+    }
+
+private:
+    static uint32 GetHomeIndex(uint64 Key)
+    {
+        return (uint32)((Key * 0x9E3779B97F4A7C15ull) >> 52) & (Capacity - 1);
+    }
+
+    FEntry* Entries;
+};
+
+/** Immutable snapshot of the filters and routing rules, the first filter is the default log file */
+struct FLogFilterTable
+{
+    enum EConstants
+    {
+        /** Filters with a bit of their own in a route, lines going to the ones after them are matched again every time */
+        MaxCachedFilters = 63
+    };
+
+    /** Route bit set when a category goes to filters past MaxCachedFilters, see ForEachUncachedFilter */
+    static const uint64 UncachedFiltersBit = 1ull << MaxCachedFilters;
+
+    TArray<FLogFilter> Filters;
+    TArray<FLogRouteRule> Rules;
+    /** Maps a filter's category FName to its index in Filters */
+    TMap<FName, int32> CategoryIndices;
+    /** Owned by the manager, only deleted once a table without it is published, so a reader can use it for as long as it holds the table */
+    FLogFlightRecorder* FlightRecorder;
+    /** Bumped by every change */
+    uint64 Version;
+
+    FLogFilterTable()
+        : FlightRecorder(nullptr)
+        , Version(0)
+    {
+    }
+
+    /** Filter named Category, nullptr if there's none */
+    const FLogFilter* Find(const class FName& Category) const
+    {
+        const int32* FoundIndex = CategoryIndices.Find(Category);
+        return FoundIndex ? &Filters[*FoundIndex] : nullptr;
+    }
+
+    /**
+     * Filters Category's lines go to, bit N standing for Filters[N]: its own filter and the sinks of every rule matching it,
+     * the default log file if there are none. Matched once per category, looked up in the route cache after that.
+     * Filters past MaxCachedFilters share UncachedFiltersBit.
+     */
+    uint64 GetRoute(const class FName& Category) const
+    {
+        const uint64 Key = FLogRouteCache::MakeKey(Category);
+        uint64 Route = 0;
+
+        if (!Routes.Find(Key, Route))
+        {
+            Route = ComputeRoute(Category);
+            if (Route != 0)
+            {
+                Routes.Add(Key, Route);
+            }
+        }
+
+        return Route;
+    }
+
+    /** Calls Visit(int32 FilterIndex) once for every filter past MaxCachedFilters Category's lines go to, matching the rules afresh */
+    template<typename VisitorType>
+    void ForEachUncachedFilter(const class FName& Category, VisitorType&& Visit) const
+    {
+        TArray<int32, TInlineAllocator<8>> FilterIndices;
+
+        const int32* FoundIndex = CategoryIndices.Find(Category);
+        if (FoundIndex && *FoundIndex >= MaxCachedFilters && Filters[*FoundIndex].bSingleCategory)
+        {
+            FilterIndices.Add(*FoundIndex);
+        }
+
+        const FString CategoryName = Category.ToString();
+        for (const FLogRouteRule& Rule : Rules)
+        {
+            if (Rule.UncachedSinks.Num() > 0 && CategoryName.MatchesWildcard(Rule.Pattern, ESearchCase::IgnoreCase))
+            {
+                for (int32 SinkIndex : Rule.UncachedSinks)
+                {
+                    FilterIndices.AddUnique(SinkIndex);
+                }
+            }
+        }
+
+        for (int32 FilterIndex : FilterIndices)
+        {
+            Visit(FilterIndex);
+        }
+    }
+
+    /** Rebuilds CategoryIndices and the rules' sink masks after Filters or Rules changed */
+    void RebuildIndices();
+
+private:
+    uint64 ComputeRoute(const class FName& Category) const;
+
+    mutable FLogRouteCache Routes;
+};
+
+/**
+ * Filter table readable from any thread without locks, changed copy-on-write.
+ *
+ * Readers enter a read scope, which counts them in a per-thread slot of the current epoch, and load the table
+ * pointer. Updates are serialized: a private copy of the table is changed and published with an atomic pointer
+ * swap, then the epoch is flipped twice, waiting each time for the readers counted in the previous epoch to leave.
+ * After that no reader can still see the old table and it's deleted. Readers never wait, updates wait for the
+ * readers already in flight.
+ *
+ * An update must not be made while the calling thread is in a read scope, e.g. from inside a log callback.
+ */
+class FLogFilterRegistry
+{
+    enum EConstants
+    {
+        /** Reader counter slots, spread so logging threads don't share a cache line */
+        NumReaderSlots = 32
+    };
+
+    MS_ALIGN(PLATFORM_CACHE_LINE_SIZE) struct FReaderSlot
+    {
+        /** Readers in flight, by epoch parity */
+        volatile int32 Readers[2];
+    } GCC_ALIGN(PLATFORM_CACHE_LINE_SIZE);
+
+public:
+    /** Current table for as long as the scope lives */
+    class FReadScope
+    {
+    public:
+        explicit FReadScope(const FLogFilterRegistry& Registry)
+            : Slot(&Registry.ReaderSlots[FPlatformTLS::GetCurrentThreadId() % NumReaderSlots])
+            , Parity(Registry.Epoch & 1)
+        {
+            // Full barrier, the table can't be loaded before the reader is counted
+            FPlatformAtomics::InterlockedIncrement(&Slot->Readers[Parity]);
+            Table = Registry.Table;
+        }
+
+        ~FReadScope()
+        {
+            FPlatformAtomics::InterlockedDecrement(&Slot->Readers[Parity]);
+        }
+
+        const FLogFilterTable& operator*() const
+        {
+            return *Table;
+        }
+
+        const FLogFilterTable* operator->() const
+        {
+            return Table;
+        }
+
+    private:
+        FReaderSlot* Slot;
+        int32 Parity;
+        const FLogFilterTable* Table;
+    };
+
+    FLogFilterRegistry();
+    ~FLogFilterRegistry();
+
+    /**
+     * Changes the table. Modify gets a private copy of the current table and returns false to leave the table as it is.
+     * Returns once no reader can see the previous table any more.
+     */
+    template<typename FunctorType>
+    void Update(FunctorType&& Modify)
+    {
+        FScopeLock UpdateLock(&UpdateCritical);
+
+        FLogFilterTable* NewTable = new FLogFilterTable(*Table);
+        if (!Modify(*NewTable))
+        {
+            delete NewTable;
+            return;
+        }
+
+        NewTable->RebuildIndices();
+        ++NewTable->Version;
+        Publish(NewTable);
+    }
+
+    /** Current table, only stable while holding the update lock, i.e. from inside Update() */
+    const FLogFilterTable& GetTableForUpdate() const
+    {
+        return *Table;
+    }
+
+private:
+    /** Swaps NewTable in and deletes the old table once its readers are gone */
+    void Publish(FLogFilterTable* NewTable);
+
+    FLogFilterTable* volatile Table;
+    volatile int32 Epoch;
+    mutable FReaderSlot ReaderSlots[NumReaderSlots];
+    /** Serializes updates */
+    FCriticalSection UpdateCritical;
+};
@@ -0,0 +1,308 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#include "LogManagerPrivatePCH.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+
+#if LOGMANAGER_WITH_MMAP
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#elif PLATFORM_WINDOWS
+    #include "Windows/WindowsHWrapper.h"
+#endif // LOGMANAGER_WITH_MMAP
+
+namespace
+{
+    struct FRecordHeader
+    {
+        /** Payload bytes following the header */
+        uint32 Length;
+        /** FLogFlightRecorder::MakeCheck of the record position, written once the rest of the record is complete */
+        uint32 Check;
+        /** FDateTime ticks of the line, the rings are merged by them on recovery */
+        int64 Ticks;
+    };
+
+    /** Ring capacities and record positions are multiples of it, so a record header never wraps around the end of a ring */
+    const int64 RecordAlignment = 16;
+
+    int64 GetRecordSize(int64 Length)
+    {
+        return Align(sizeof(FRecordHeader) + Length, RecordAlignment);
+    }
+
+    /** A record found by Recover */
+    struct FRecoveredLine
+    {
+        int64 Ticks;
+        const uint8* Ring;
+        int64 PayloadOffset;
+        uint32 Length;
+    };
+}
+
+FLogFlightRecorder* FLogFlightRecorder::Create(const FString& Filename, int64 Capacity)
+{
+    const int64 RingCapacity = Align(FMath::Max<int64>(Capacity / NumRings, MaxRecordLength * 4), RecordAlignment);
+    const int64 FileSize = GetFileSize(RingCapacity);
+
+    void* Mapping = nullptr;
+#if LOGMANAGER_WITH_MMAP
+    IFileManager::Get().MakeDirectory(*FPaths::GetPath(Filename), true);
+
+    const FString AbsoluteFilename = IFileManager::Get().ConvertToAbsolutePathForExternalAppForWrite(*Filename);
+    const int32 FileHandle = open(TCHAR_TO_UTF8(*AbsoluteFilename), O_CREAT | O_RDWR | O_TRUNC | O_CLOEXEC, 0644);
+    if (FileHandle < 0)
+    {
+        return nullptr;
+    }
+
+    // Allocated up front, a sparse file would fault in the middle of a line once the disk is full
+    if (FLogMappedFileArchive::ReserveFileRange(FileHandle, 0, FileSize))
+    {
+        Mapping = mmap(nullptr, FileSize, PROT_READ | PROT_WRITE, MAP_SHARED, FileHandle, 0);
+        if (Mapping == MAP_FAILED)
+        {
+            Mapping = nullptr;
+        }
+    }
+
+    // The mapping keeps the file alive on its own
+    close(FileHandle);
+#elif PLATFORM_WINDOWS
+    IFileManager::Get().MakeDirectory(*FPaths::GetPath(Filename), true);
+
+    // Shared for reading and deleting, the crash reporter may read the file while the process is still around
+    const FString AbsoluteFilename = IFileManager::Get().ConvertToAbsolutePathForExternalAppForWrite(*Filename);
+    const HANDLE FileHandle = CreateFileW(*AbsoluteFilename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (FileHandle == INVALID_HANDLE_VALUE)
+    {
+        return nullptr;
+    }
+
+    // Sizing the mapping allocates the file, the view keeps the mapping and the file alive once the handles are closed
+    const HANDLE MappingHandle = CreateFileMappingW(FileHandle, nullptr, PAGE_READWRITE, (DWORD)(FileSize >> 32), (DWORD)FileSize, nullptr);
+    if (MappingHandle)
+    {
+        Mapping = MapViewOfFile(MappingHandle, FILE_MAP_WRITE, 0, 0, FileSize);
+        CloseHandle(MappingHandle);
+    }
+    CloseHandle(FileHandle);
+#endif // LOGMANAGER_WITH_MMAP
+
+    if (!Mapping)
+    {
+        IFileManager::Get().Delete(*Filename);
+        return nullptr;
+    }
+
+    // The file is created zeroed, every ring starts empty
+    FHeader* Header = (FHeader*)Mapping;
+    Header->Magic = Magic;
+    Header->Version = Version;
+    Header->RingCapacity = RingCapacity;
+    Header->NumRings = NumRings;
+    Header->ProcessId = FPlatformProcess::GetCurrentProcessId();
+    FPlatformMisc::MemoryBarrier();
+    Header->State = Live;
+
+    return new FLogFlightRecorder(Header, FileSize);
+}
+
+FLogFlightRecorder::FLogFlightRecorder(FHeader* InHeader, int64 InMappingSize)
+    : Header(InHeader)
+    , MappingSize(InMappingSize)
+    , RingHeaders((uint8*)InHeader + HeaderSize)
+    , Rings((uint8*)InHeader + HeaderSize + NumRings * RingHeaderSize)
+{
+}
+
+FLogFlightRecorder::~FLogFlightRecorder()
+{
+    Header->State = Closed;
+#if LOGMANAGER_WITH_MMAP
+    munmap(Header, MappingSize);
+#elif PLATFORM_WINDOWS
+    UnmapViewOfFile(Header);
+#endif // LOGMANAGER_WITH_MMAP
+    Header = nullptr;
+    RingHeaders = nullptr;
+    Rings = nullptr;
+}
+
+uint32 FLogFlightRecorder::MakeCheck(int64 Pos)
+{
+    const uint64 Hash = (uint64)Pos * 0x9E3779B97F4A7C15ull;
+    return (uint32)(Hash >> 32) ^ Magic;
+}
+
+void FLogFlightRecorder::RecordLine(ELogVerbosity::Type Verbosity, const class FName& Category, const TCHAR* Message, int64 Ticks, uint64 FrameCounter, bool bLineTerminator)
+{
+    // Cut long lines rather than let a single line wipe out the context before it
+    uint8 Line[MaxRecordLength];
+    const int32 MaxMessageLength = (MaxRecordLength - FLogLineFormatter::GetMaxEncodedLength(Category, 0)) / FLogLineFormatter::MaxBytesPerChar;
+    const int32 MessageLength = FMath::Min(FCString::Strlen(Message), FMath::Max(MaxMessageLength, 0));
+    const int32 Length = FLogLineFormatter::EncodeLogLine(Line, Verbosity, Category, Message, MessageLength, Ticks, FrameCounter, bLineTerminator);
+
+    WriteRecord(Line, Length, Ticks);
+}
+
+bool FLogFlightRecorder::RecordEncodedLine(const uint8* Line, int32 Length, int64 Ticks)
+{
+    if (Length > MaxRecordLength)
+    {
+        return false;
+    }
+
+    WriteRecord(Line, Length, Ticks);
+    return true;
+}
+
+void FLogFlightRecorder::WriteRecord(const uint8* Line, int32 Length, int64 Ticks)
+{
+    // A thread always writes to the same ring, its lines stay in order
+    const int32 RingIndex = FPlatformTLS::GetCurrentThreadId() % NumRings;
+    FRingHeader* RingHeader = (FRingHeader*)(RingHeaders + RingIndex * RingHeaderSize);
+    const int64 Capacity = Header->RingCapacity;
+    uint8* Ring = Rings + RingIndex * Capacity;
+
+    const int64 Pos = FPlatformAtomics::InterlockedAdd(&RingHeader->WritePos, GetRecordSize(Length));
+
+    // Only the payload may wrap around the end of the ring
+    FRecordHeader* Record = (FRecordHeader*)(Ring + Pos % Capacity);
+    Record->Length = Length;
+    Record->Ticks = Ticks;
+
+    const int64 PayloadOffset = (Pos + sizeof(FRecordHeader)) % Capacity;
+    const int64 FirstPart = FMath::Min<int64>(Length, Capacity - PayloadOffset);
+    FMemory::Memcpy(Ring + PayloadOffset, Line, FirstPart);
+    FMemory::Memcpy(Ring, Line + FirstPart, Length - FirstPart);
+
+    FPlatformMisc::MemoryBarrier();
+    Record->Check = MakeCheck(Pos);
+}
+
+bool FLogFlightRecorder::Recover(const FString& Filename, TArray<uint8>& OutText)
+{
+    TArray<uint8> FileData;
+    if (!FFileHelper::LoadFileToArray(FileData, *Filename) || FileData.Num() < HeaderSize)
+    {
+        return false;
+    }
+
+    const FHeader* FileHeader = (const FHeader*)FileData.GetData();
+    const int64 Capacity = FileHeader->RingCapacity;
+    if (FileHeader->Magic != Magic || FileHeader->Version != Version || FileHeader->NumRings != NumRings ||
+        Capacity <= 0 || Capacity % RecordAlignment != 0 || FileData.Num() < GetFileSize(Capacity))
+    {
+        return false;
+    }
+
+    TArray<FRecoveredLine> Lines;
+    for (int32 RingIndex = 0; RingIndex < NumRings; ++RingIndex)
+    {
+        const FRingHeader* RingHeader = (const FRingHeader*)(FileData.GetData() + HeaderSize + RingIndex * RingHeaderSize);
+        const uint8* FileRing = FileData.GetData() + HeaderSize + NumRings * RingHeaderSize + RingIndex * Capacity;
+        const int64 WritePos = RingHeader->WritePos;
+
+        // Only records that start and end within the last Capacity bytes are intact, anything else fails its check
+        int64 Pos = FMath::Max<int64>(0, WritePos - Capacity);
+        while (Pos + (int64)sizeof(FRecordHeader) <= WritePos)
+        {
+            const FRecordHeader* Record = (const FRecordHeader*)(FileRing + Pos % Capacity);
+            const int64 RecordSize = GetRecordSize(Record->Length);
+
+            if (Record->Check != MakeCheck(Pos) || Record->Length > MaxRecordLength || Pos + RecordSize > WritePos)
+            {
+                // Torn or overwritten, look for the next record
+                Pos += RecordAlignment;
+                continue;
+            }
+
+            Lines.Add(FRecoveredLine{ Record->Ticks, FileRing, (Pos + (int64)sizeof(FRecordHeader)) % Capacity, Record->Length });
+            Pos += RecordSize;
+        }
+    }
+
+    // Lines of the same thread keep their order, and so do lines logged in the same tick
+    Lines.StableSort([](const FRecoveredLine& A, const FRecoveredLine& B)
+    {
+        return A.Ticks < B.Ticks;
+    });
+
+    for (const FRecoveredLine& Line : Lines)
+    {
+        const int64 FirstPart = FMath::Min<int64>(Line.Length, Capacity - Line.PayloadOffset);
+        OutText.Append(Line.Ring + Line.PayloadOffset, (int32)FirstPart);
+        OutText.Append(Line.Ring, (int32)(Line.Length - FirstPart));
+    }
+
+    return true;
+}
+
+void FLogFlightRecorder::RecoverCrashedSessions(const FString& LogDir)
+{
+    // Recorders only ever live at the top of a session directory, nothing below them is listed
+    TArray<FString> SessionDirs;
+    IFileManager::Get().FindFiles(SessionDirs, *(LogDir / TEXT("*")), false, true);
+
+    for (const FString& SessionDir : SessionDirs)
+    {
+        const FString RecorderFile = LogDir / SessionDir / GetFilename();
+
+        FHeader FileHeader;
+        FMemory::Memzero(FileHeader);
+        {
+            TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*RecorderFile, FILEREAD_AllowWrite | FILEREAD_Silent));
+            if (!Reader || Reader->TotalSize() < (int64)sizeof(FileHeader))
+            {
+                continue;
+            }
+            Reader->Serialize(&FileHeader, sizeof(FileHeader));
+        }
+
+        if (FileHeader.Magic != Magic || FileHeader.Version != Version || FileHeader.State != Live || FPlatformProcess::IsApplicationRunning(FileHeader.ProcessId))
+        {
+            continue;
+        }
+
+        TArray<uint8> Text;
+        Text.Add(0xEF);
+        Text.Add(0xBB);
+        Text.Add(0xBF);
+        if (Recover(RecorderFile, Text) &&
+            FFileHelper::SaveArrayToFile(Text, *FPaths::ChangeExtension(RecorderFile, TEXT(".log"))))
+        {
+            IFileManager::Get().Delete(*RecorderFile);
+        }
+    }
+}
+
+/** Recovers a flight recorder file by hand, e.g. "LogManager.RecoverFlightRecorder Saved/Logs/Game/FlightRecorder.bin" */
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogRecoverFlightRecorderCommand(
+    TEXT("LogManager.RecoverFlightRecorder"),
+    TEXT("Writes the lines kept by a flight recorder file to a text log. Usage: LogManager.RecoverFlightRecorder <RecorderFile> [TextFile]"),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+    {
+        if (Args.Num() < 1)
+        {
+            Ar.Log(TEXT("Usage: LogManager.RecoverFlightRecorder <RecorderFile> [TextFile]"));
+            return;
+        }
+
+        const FString& RecorderFilename = Args[0];
+        const FString TextFilename = Args.Num() > 1 ? Args[1] : FPaths::ChangeExtension(RecorderFilename, TEXT(".log"));
+
+        if (ILogManager::Get().RecoverFlightRecorder(RecorderFilename, TextFilename))
+        {
+            Ar.Logf(TEXT("Recovered %s to %s"), *RecorderFilename, *TextFilename);
+        }
+        else
+        {
+            Ar.Logf(TEXT("Failed to recover %s"), *RecorderFilename);
+        }
+    }));
@@ -0,0 +1,122 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "Containers/Array.h"
+#include "Containers/UnrealString.h"
+#include "Logging/LogVerbosity.h"
+#include "UObject/NameTypes.h"
+
+#include "LogMappedFile.h"
+
+/**
+ * Last lines of every category, kept in fixed size rings inside a shared file mapping (mmap, or a file mapping
+ * on Windows).
+ *
+ * Lines are written lock-free from the logging threads straight into the mapping. Each thread writes to one of
+ * NumRings rings picked by its id, so threads logging at once rarely share a write position. Lines a log writer
+ * already encoded are copied as they are. The pages belong to the kernel, so they survive the process dying hard
+ * and Recover() can read them back from the file later, by a new session or by the crash reporter. The rings are
+ * merged by timestamp then. The file is deleted on a clean shutdown.
+ *
+ * Every record is 16-byte aligned and starts with its length, a check word derived from its position in its
+ * ring and the line's timestamp. The check word is written last, so a record being written when the process
+ * died, or one overwritten by a later lap of the ring, is skipped on recovery.
+ */
+class FLogFlightRecorder
+{
+public:
+    enum EConstants
+    {
+        /** 'LOGF' */
+        Magic = 0x46474F4C,
+        Version = 2,
+        /** Rings the threads are spread over */
+        NumRings = 8,
+        /** Bytes of the file header, followed by a cache line per ring holding its FRingHeader */
+        HeaderSize = 64,
+        RingHeaderSize = 64,
+        /** Longest record, longer lines are cut */
+        MaxRecordLength = 4096
+    };
+
+    enum EState
+    {
+        /** The process writing the file is, or was when it died, running */
+        Live = 1,
+        /** Shut down cleanly, nothing to recover */
+        Closed = 2
+    };
+
+    struct FHeader
+    {
+        uint32 Magic;
+        uint32 Version;
+        /** Size of each ring in bytes */
+        int64 RingCapacity;
+        int32 NumRings;
+        /** EState */
+        volatile int32 State;
+        uint32 ProcessId;
+    };
+
+    struct FRingHeader
+    {
+        /** Bytes written to the ring since it was created, the ring holds the last RingCapacity of them */
+        volatile int64 WritePos;
+    };
+
+    /** Name of the flight recorder file in a session directory */
+    static const TCHAR* GetFilename()
+    {
+        return TEXT("FlightRecorder.bin");
+    }
+
+    /** Creates the file and maps it, nullptr if the platform or the file doesn't allow it. Capacity is shared by the rings. */
+    static FLogFlightRecorder* Create(const FString& Filename, int64 Capacity);
+
+    /** Marks the file as closed, it's up to the owner to delete it */
+    ~FLogFlightRecorder();
+
+    /** Records a log line, callable from any thread at any time, including while crashing */
+    void RecordLine(ELogVerbosity::Type Verbosity, const class FName& Category, const TCHAR* Message, int64 Ticks, uint64 FrameCounter, bool bLineTerminator);
+
+    /**
+     * Records a line already encoded by FLogLineFormatter, callable like RecordLine
+     * @return false if the line is longer than MaxRecordLength, RecordLine cuts it
+     */
+    bool RecordEncodedLine(const uint8* Line, int32 Length, int64 Ticks);
+
+    /**
+     * Reads the lines of a flight recorder file back as UTF-8 text, oldest first
+     * @return false if the file couldn't be read or isn't a flight recorder file
+     */
+    static bool Recover(const FString& Filename, TArray<uint8>& OutText);
+
+    /**
+     * Turns the flight recorder files of sessions that died under LogDir into FlightRecorder.log files next to them
+     * and deletes the recorder files. Files of processes still running are left alone.
+     */
+    static void RecoverCrashedSessions(const FString& LogDir);
+
+private:
+    FLogFlightRecorder(FHeader* InHeader, int64 InMappingSize);
+
+    /** Bytes of the file holding rings of RingCapacity bytes */
+    static int64 GetFileSize(int64 RingCapacity)
+    {
+        return HeaderSize + NumRings * (RingHeaderSize + RingCapacity);
+    }
+
+    /** Position dependent check word of the record starting at Pos */
+    static uint32 MakeCheck(int64 Pos);
+
+    /** Copies a line into the ring of the calling thread */
+    void WriteRecord(const uint8* Line, int32 Length, int64 Ticks);
+
+    FHeader* Header;
+    int64 MappingSize;
+    /** The rings' headers and the rings themselves, inside the mapping */
+    uint8* RingHeaders;
+    uint8* Rings;
+};
@@ -0,0 +1,170 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#include "LogManagerPrivatePCH.h"
+
+FLogIOWorker::FLogIOWorker(int32 WorkerIndex, double InArchiveFlushIntervalSec)
+    : Thread(nullptr)
+    , WakeEvent(FPlatformProcess::GetSynchEventFromPool(false))
+    , LastArchiveFlushTime(0.0)
+    , ArchiveFlushIntervalSec(InArchiveFlushIntervalSec)
+{
+    Thread = FRunnableThread::Create(this, *FString::Printf(TEXT("LogIOThread_%d"), WorkerIndex), 0, TPri_BelowNormal);
+}
+
+FLogIOWorker::~FLogIOWorker()
+{
+    if (Thread)
+    {
+        Thread->Kill(true);
+        delete Thread;
+        Thread = nullptr;
+    }
+
+    FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+    WakeEvent = nullptr;
+}
+
+void FLogIOWorker::AddWriter(FLogAsyncWriter* Writer)
+{
+    FScopeLock WritersLock(&WritersCritical);
+    Writers.AddUnique(Writer);
+}
+
+bool FLogIOWorker::RemoveWriter(FLogAsyncWriter* Writer)
+{
+    FScopeLock WritersLock(&WritersCritical);
+    return Writers.Remove(Writer) > 0;
+}
+
+int32 FLogIOWorker::GetNumWriters()
+{
+    FScopeLock WritersLock(&WritersCritical);
+    return Writers.Num();
+}
+
+void FLogIOWorker::Wake()
+{
+    WakeEvent->Trigger();
+}
+
+bool FLogIOWorker::Init()
+{
+    return true;
+}
+
+uint32 FLogIOWorker::Run()
+{
+    while (StopTaskCounter.GetValue() == 0)
+    {
+        // Nothing owed to anyone: sleep until a writer wakes us up
+        double WaitSec = -1.0;
+        {
+            FScopeLock WritersLock(&WritersCritical);
+
+            for (FLogAsyncWriter* Writer : Writers)
+            {
+                Writer->ServiceQueue();
+            }
+
+            // All archives of this thread are flushed together
+            double Now = FPlatformTime::Seconds();
+            if ((Now - LastArchiveFlushTime) > ArchiveFlushIntervalSec)
+            {
+                for (FLogAsyncWriter* Writer : Writers)
+                {
+                    Writer->FlushArchive();
+                }
+                LastArchiveFlushTime = Now = FPlatformTime::Seconds();
+            }
+
+            for (FLogAsyncWriter* Writer : Writers)
+            {
+                double WriterWaitSec = Writer->GetNextServiceDelay();
+                if (Writer->IsArchiveDirty())
+                {
+                    const double FlushWaitSec = LastArchiveFlushTime + ArchiveFlushIntervalSec - Now;
+                    WriterWaitSec = WriterWaitSec < 0.0 ? FlushWaitSec : FMath::Min(WriterWaitSec, FlushWaitSec);
+                }
+
+                if (WriterWaitSec >= 0.0 && (WaitSec < 0.0 || WriterWaitSec < WaitSec))
+                {
+                    WaitSec = WriterWaitSec;
+                }
+            }
+        }
+
+        const uint32 WaitMs = WaitSec < 0.0 ? MAX_uint32 : (uint32)FMath::Max(1, FMath::CeilToInt((float)(WaitSec * 1000.0)));
+        WakeEvent->Wait(WaitMs);
+    }
+    return 0;
+}
+
+void FLogIOWorker::Stop()
+{
+    StopTaskCounter.Increment();
+    WakeEvent->Trigger();
+}
+
+FLogIOScheduler::FLogIOScheduler()
+{
+    int32 NumThreads = 1;
+    FParse::Value(FCommandLine::Get(), TEXT("LOGIOTHREADS="), NumThreads);
+    NumThreads = FMath::Clamp(NumThreads, 1, 16);
+
+    double ArchiveFlushIntervalSec = 0.2;
+    float CommandLineInterval = 0.0;
+    if (FParse::Value(FCommandLine::Get(), TEXT("LOGFLUSHINTERVAL="), CommandLineInterval))
+    {
+        ArchiveFlushIntervalSec = CommandLineInterval;
+    }
+
+    for (int32 WorkerIndex = 0; WorkerIndex < NumThreads; ++WorkerIndex)
+    {
+        Workers.Add(new FLogIOWorker(WorkerIndex, ArchiveFlushIntervalSec));
+    }
+}
+
+FLogIOScheduler::~FLogIOScheduler()
+{
+    for (FLogIOWorker* Worker : Workers)
+    {
+        delete Worker;
+    }
+    Workers.Empty();
+}
+
+FLogIOWorker* FLogIOScheduler::RegisterWriter(FLogAsyncWriter* Writer)
+{
+    FScopeLock WorkersLock(&WorkersCritical);
+
+    FLogIOWorker* LeastBusyWorker = nullptr;
+    int32 LeastNumWriters = MAX_int32;
+    for (FLogIOWorker* Worker : Workers)
+    {
+        const int32 NumWriters = Worker->GetNumWriters();
+        if (NumWriters < LeastNumWriters)
+        {
+            LeastBusyWorker = Worker;
+            LeastNumWriters = NumWriters;
+        }
+    }
+
+    if (LeastBusyWorker)
+    {
+        LeastBusyWorker->AddWriter(Writer);
+    }
+    return LeastBusyWorker;
+}
+
+void FLogIOScheduler::UnregisterWriter(FLogAsyncWriter* Writer)
+{
+    FScopeLock WorkersLock(&WorkersCritical);
+
+    for (FLogIOWorker* Worker : Workers)
+    {
+        if (Worker->RemoveWriter(Writer))
+        {
+            break;
+        }
+    }
+}
@@ -0,0 +1,86 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "HAL/CriticalSection.h"
+#include "HAL/Event.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/ThreadSafeCounter.h"
+
+class FLogAsyncWriter;
+
+/**
+ * One shared I/O thread, writes the queues of the writers assigned to it.
+ *
+ * The thread sleeps on WakeEvent. Writers trigger it when their queue goes from empty to non-empty or a client
+ * waits on them, and the thread only sets a timeout while it still owes an archive flush or has lines to come back
+ * for, so an idle process doesn't wake it up at all.
+ */
+class FLogIOWorker : public FRunnable
+{
+public:
+    FLogIOWorker(int32 WorkerIndex, double InArchiveFlushIntervalSec);
+    virtual ~FLogIOWorker();
+
+    void AddWriter(FLogAsyncWriter* Writer);
+
+    /** Removes Writer, waits for the current pass to finish if it's being serviced */
+    bool RemoveWriter(FLogAsyncWriter* Writer);
+
+    int32 GetNumWriters();
+
+    /** Wakes the thread up for another pass over its writers */
+    void Wake();
+
+    //~ Begin FRunnable Interface.
+    virtual bool Init() override;
+    virtual uint32 Run() override;
+    virtual void Stop() override;
+    //~ End FRunnable Interface
+
+private:
+    /** Thread to run the worker FRunnable on */
+    FRunnableThread* Thread;
+    /** Stops this thread */
+    FThreadSafeCounter StopTaskCounter;
+    /** Triggered when there is work for this thread */
+    FEvent* WakeEvent;
+    /** Writers served by this thread, guarded by WritersCritical */
+    TArray<FLogAsyncWriter*> Writers;
+    /** Held for a whole pass over the writers */
+    FCriticalSection WritersCritical;
+    /** [WORKER THREAD] Last time the archives were flushed */
+    double LastArchiveFlushTime;
+    /** Archive flush interval, shared by every writer of this thread */
+    double ArchiveFlushIntervalSec;
+};
+
+/**
+ * Shared I/O threads serving every log writer.
+ *
+ * Instead of one thread per log file, a small pool of threads (one by default, -LOGIOTHREADS=N) writes the
+ * queued lines of all writers in batches and flushes their archives together on a single cadence
+ * (-LOGFLUSHINTERVAL=seconds).
+ */
+class FLogIOScheduler
+{
+public:
+    FLogIOScheduler();
+    ~FLogIOScheduler();
+
+    /**
+     * Starts serving Writer on the least busy I/O thread
+     * @return the I/O thread serving Writer, the writer wakes it through FLogIOWorker::Wake()
+     */
+    FLogIOWorker* RegisterWriter(FLogAsyncWriter* Writer);
+
+    /** Stops serving Writer, waits until no I/O thread is working on it */
+    void UnregisterWriter(FLogAsyncWriter* Writer);
+
+private:
+    /** I/O threads */
+    TArray<FLogIOWorker*> Workers;
+    /** Sync object for assigning writers to workers */
+    FCriticalSection WorkersCritical;
+};
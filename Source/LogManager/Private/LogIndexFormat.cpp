@@ -0,0 +1,168 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#include "LogManagerPrivatePCH.h"
+
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+
+bool FLogIndexFormat::Query(const FString& LogFilename, const FLogIndexQuery& Query, TArray<FLogFileRange>& OutRanges)
+{
+    TArray<uint8> IndexData;
+    if (!FFileHelper::LoadFileToArray(IndexData, *(LogFilename + GetExtension()), FILEREAD_Silent) || IndexData.Num() < (int32)sizeof(FFileHeader))
+    {
+        return false;
+    }
+
+    const FFileHeader* Header = (const FFileHeader*)IndexData.GetData();
+    const int64 FileSize = IFileManager::Get().FileSize(*LogFilename);
+    if (Header->Magic != Magic || Header->Version != Version || FileSize < 0)
+    {
+        return false;
+    }
+
+    const int32 NumEntries = (IndexData.Num() - sizeof(FFileHeader)) / sizeof(FEntry);
+    const FEntry* Entries = (const FEntry*)(IndexData.GetData() + sizeof(FFileHeader));
+
+    const int64 FromTicks = Query.From.GetTicks();
+    const int64 ToTicks = Query.To.GetTicks();
+    const uint32 WantedVerbosities = ((1u << ((Query.MaxVerbosity & ELogVerbosity::VerbosityMask) + 1)) - 1) & ~1u;
+
+    // A block matching right after a matching one extends its range, over the raw bytes between them if any
+    bool bExtendLast = false;
+    int64 IndexedEnd = 0;
+    for (int32 Index = 0; Index < NumEntries; ++Index)
+    {
+        const FEntry& Entry = Entries[Index];
+        IndexedEnd = FMath::Max(IndexedEnd, Entry.EndOffset);
+
+        const bool bMatches = Entry.MinTicks <= ToTicks && Entry.MaxTicks >= FromTicks &&
+            Entry.MinFrame <= Query.LastFrame && Entry.MaxFrame >= Query.FirstFrame &&
+            (Entry.VerbosityMask & WantedVerbosities) != 0;
+
+        if (bMatches && bExtendLast)
+        {
+            FLogFileRange& Last = OutRanges.Last();
+            Last.Length = Entry.EndOffset - Last.Offset;
+        }
+        else if (bMatches)
+        {
+            OutRanges.Add(FLogFileRange{ Entry.Offset, Entry.EndOffset - Entry.Offset });
+        }
+        bExtendLast = bMatches;
+    }
+
+    // Lines written after the last entry, nothing is known about them
+    if (FileSize > IndexedEnd)
+    {
+        if (bExtendLast)
+        {
+            OutRanges.Last().Length = FileSize - OutRanges.Last().Offset;
+        }
+        else
+        {
+            OutRanges.Add(FLogFileRange{ IndexedEnd, FileSize - IndexedEnd });
+        }
+    }
+
+    return true;
+}
+
+FLogIndexWriter::FLogIndexWriter(int32 InBlockSize)
+    : BlockSize(FMath::Max(InBlockSize, 1))
+    , IndexAr(nullptr)
+    , NextBlockOffset(0)
+    , bDirty(false)
+{
+    FMemory::Memzero(Block);
+}
+
+FLogIndexWriter::~FLogIndexWriter()
+{
+    EndFile();
+}
+
+void FLogIndexWriter::BeginFile(const FString& InLogFilename)
+{
+    // A rotation that couldn't create the next segment keeps writing the same file
+    if (InLogFilename == LogFilename)
+    {
+        return;
+    }
+
+    EndFile();
+
+    LogFilename = InLogFilename;
+    NextBlockOffset = 0;
+    IndexAr = IFileManager::Get().CreateFileWriter(*(LogFilename + FLogIndexFormat::GetExtension()), FILEWRITE_AllowRead);
+    if (IndexAr)
+    {
+        FLogIndexFormat::FFileHeader Header{ FLogIndexFormat::Magic, FLogIndexFormat::Version, (uint32)BlockSize, 0 };
+        IndexAr->Serialize(&Header, sizeof(Header));
+        bDirty = true;
+    }
+}
+
+void FLogIndexWriter::AddLine(int64 Offset, int64 Length, ELogVerbosity::Type Verbosity, int64 Ticks, uint64 FrameCounter)
+{
+    if (Block.NumLines > 0 && Offset - Block.Offset >= BlockSize)
+    {
+        EndBlock(Offset);
+    }
+
+    if (Block.NumLines == 0)
+    {
+        Block.Offset = FMath::Min(NextBlockOffset, Offset);
+        Block.MinTicks = Ticks;
+        Block.MaxTicks = Ticks;
+        Block.MinFrame = FrameCounter;
+        Block.MaxFrame = FrameCounter;
+        Block.VerbosityMask = 0;
+    }
+    else
+    {
+        // Lines of different threads can be slightly out of order
+        Block.MinTicks = FMath::Min(Block.MinTicks, Ticks);
+        Block.MaxTicks = FMath::Max(Block.MaxTicks, Ticks);
+        Block.MinFrame = FMath::Min(Block.MinFrame, FrameCounter);
+        Block.MaxFrame = FMath::Max(Block.MaxFrame, FrameCounter);
+    }
+
+    Block.EndOffset = Offset + Length;
+    Block.VerbosityMask |= 1u << (Verbosity & ELogVerbosity::VerbosityMask);
+    ++Block.NumLines;
+}
+
+void FLogIndexWriter::Flush()
+{
+    if (IndexAr && bDirty)
+    {
+        IndexAr->Flush();
+        bDirty = false;
+    }
+}
+
+void FLogIndexWriter::EndBlock(int64 EndOffset)
+{
+    if (Block.NumLines > 0)
+    {
+        Block.EndOffset = FMath::Max(Block.EndOffset, EndOffset);
+        NextBlockOffset = Block.EndOffset;
+
+        if (IndexAr)
+        {
+            IndexAr->Serialize(&Block, sizeof(Block));
+            bDirty = true;
+        }
+        Block.NumLines = 0;
+    }
+}
+
+void FLogIndexWriter::EndFile()
+{
+    // What follows the last line is read as the unindexed tail
+    EndBlock(0);
+
+    delete IndexAr;
+    IndexAr = nullptr;
+    bDirty = false;
+}
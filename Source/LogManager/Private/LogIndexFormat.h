@@ -0,0 +1,107 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "Containers/Array.h"
+#include "Containers/UnrealString.h"
+#include "Logging/LogVerbosity.h"
+#include "Serialization/Archive.h"
+
+#include "ILogManager.h"
+
+/**
+ * Sidecar index of a text log file, written next to it with GetExtension() appended (Game.log.idx, Game.1.log.idx, ...).
+ *
+ * A file header is followed by one entry per block of about BlockSize bytes of lines. An entry holds the byte range
+ * of its lines, their time and frame counter ranges and which verbosities they have, so a reader can skip straight
+ * to the blocks that may hold what it looks for. Entries are only written once their block is full, the tail of
+ * a log file still being written, or left behind by a crash, isn't indexed and has to be read as is.
+ */
+struct FLogIndexFormat
+{
+    enum EConstants
+    {
+        /** 'LIDX' */
+        Magic = 0x5844494C,
+        Version = 1
+    };
+
+    struct FFileHeader
+    {
+        uint32 Magic;
+        uint32 Version;
+        /** Bytes of lines an entry covers before the next one starts */
+        uint32 BlockSize;
+        uint32 Reserved;
+    };
+
+    struct FEntry
+    {
+        /** Byte range of the block in the log file, from where the previous entry ended to where the next one starts */
+        int64 Offset;
+        int64 EndOffset;
+        /** Earliest and latest timestamp, FDateTime ticks */
+        int64 MinTicks;
+        int64 MaxTicks;
+        /** Earliest and latest frame counter */
+        uint64 MinFrame;
+        uint64 MaxFrame;
+        uint32 NumLines;
+        /** Bit 1 << ELogVerbosity::Type set for every verbosity in the block */
+        uint32 VerbosityMask;
+    };
+
+    /** Appended to the log filename */
+    static const TCHAR* GetExtension()
+    {
+        return TEXT(".idx");
+    }
+
+    /**
+     * Finds the byte ranges of LogFilename that may hold lines matching Query, adjacent blocks are merged
+     * @return false if the index is missing or isn't an index file
+     */
+    static bool Query(const FString& LogFilename, const FLogIndexQuery& Query, TArray<FLogFileRange>& OutRanges);
+};
+
+/**
+ * [WRITER THREAD] Builds the FLogIndexFormat index of a text log file as its lines are written.
+ * Costs a few compares per line, the index file is only written to once per block.
+ */
+class FLogIndexWriter
+{
+public:
+    explicit FLogIndexWriter(int32 InBlockSize);
+    ~FLogIndexWriter();
+
+    /** Starts the index of LogFilename, finishing the index of the previous file. Does nothing if it is the same file. */
+    void BeginFile(const FString& LogFilename);
+
+    /**
+     * Adds a line of Length bytes written at Offset of the current file. Blocks have no gaps between them, bytes written
+     * without a line of their own (raw bytes, a byte order mark) belong to the block around them.
+     */
+    void AddLine(int64 Offset, int64 Length, ELogVerbosity::Type Verbosity, int64 Ticks, uint64 FrameCounter);
+
+    /** Hands the entries written so far to the OS */
+    void Flush();
+
+private:
+    /** Writes the entry of the current block, if it has any line, extending it to EndOffset */
+    void EndBlock(int64 EndOffset);
+
+    /** Writes the last block and closes the index file */
+    void EndFile();
+
+    const int32 BlockSize;
+    /** Log file being indexed */
+    FString LogFilename;
+    /** Index file, nullptr if it couldn't be created */
+    FArchive* IndexAr;
+    /** Block being filled, NumLines is 0 until its first line */
+    FLogIndexFormat::FEntry Block;
+    /** Where the next block starts, the end of the last entry written */
+    int64 NextBlockOffset;
+    /** Whether entries were written since the last flush */
+    bool bDirty;
+};
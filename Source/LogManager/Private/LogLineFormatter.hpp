@@ -0,0 +1,380 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "CoreGlobals.h"
+#include "Misc/OutputDeviceHelper.h"
+#include "UObject/NameTypes.h"
+
+#include "LogTimestampCache.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define LOGMANAGER_WITH_SSE2 1
+#else
+    #define LOGMANAGER_WITH_SSE2 0
+#endif
+
+/**
+ * Builds the text of a log line. Shared by the calling threads and by the writer threads formatting
+ * deferred records, so it takes the timestamp (FDateTime ticks) and frame counter instead of sampling them.
+ *
+ * The line is encoded as UTF-8 straight into the destination buffer in a single pass, without any
+ * intermediate string, so formatting a line never touches the heap.
+ */
+class FLogLineFormatter
+{
+public:
+    enum EConstants
+    {
+        /** Longest "[YYYY.MM.DD-HH.MM.SS:mmm][fff]" prefix */
+        MaxPrefixLength = 32,
+        /** Length of the prefix with a four digit year, the only one read back */
+        PrefixLength = 30,
+        /** Longest "_<number>" suffix of a category FName */
+        MaxNameNumberLength = 12,
+        /** Longest ":<verbosity>: " fragment */
+        MaxVerbosityLength = 16,
+        /** Longest "Category:Verbosity:" looked at when reading a line back */
+        MaxNameLength = NAME_SIZE + MaxNameNumberLength + MaxVerbosityLength,
+        /** Longest line terminator */
+        MaxTerminatorLength = 2,
+        /** Most UTF-8 bytes a single TCHAR can turn into */
+        MaxBytesPerChar = sizeof(TCHAR) == 2 ? 3 : 4
+    };
+
+    /** Line terminator appended to every line when the output device auto emits them */
+    static const TCHAR* GetLineTerminator()
+    {
+#if PLATFORM_LINUX
+        return TEXT("\r\n");
+#else
+        return LINE_TERMINATOR;
+#endif // PLATFORM_LINUX
+    }
+
+    /** Upper bound of the bytes EncodeCategory writes for Category */
+    static int32 GetMaxCategoryLength(const class FName& Category)
+    {
+        const FNameEntry* NameEntry = Category.GetDisplayNameEntry();
+        const int32 CategoryLength = NameEntry->IsWide()
+            ? FCStringWide::Strlen(NameEntry->GetWideName()) * MaxBytesPerChar
+            : FCStringAnsi::Strlen(NameEntry->GetAnsiName());
+
+        return CategoryLength + MaxNameNumberLength;
+    }
+
+    /** Upper bound of the bytes EncodeLogLine writes for a message of MessageLength characters */
+    static int32 GetMaxEncodedLength(const class FName& Category, int32 MessageLength)
+    {
+        return MaxPrefixLength + GetMaxCategoryLength(Category) + MaxVerbosityLength + MessageLength * MaxBytesPerChar + MaxTerminatorLength;
+    }
+
+    /** Writes the category name as UTF-8, the same text as FName::ToString. Out must have room for GetMaxCategoryLength bytes. */
+    static uint8* EncodeCategory(uint8* Out, const class FName& Category)
+    {
+        return WriteCategory(Out, Category);
+    }
+
+    /** Encodes Length characters of Text as UTF-8. Out must have room for Length * MaxBytesPerChar bytes. */
+    static uint8* EncodeUTF8(uint8* Out, const TCHAR* Text, int32 Length)
+    {
+        return WriteUTF8(Out, Text, Length);
+    }
+
+    /**
+     * Writes the formatted line as UTF-8 to Dest, which must have room for GetMaxEncodedLength bytes.
+     * @return number of bytes written
+     */
+    static int32 EncodeLogLine(uint8* Dest, ELogVerbosity::Type Verbosity, const class FName& Category, const TCHAR* Message, int32 MessageLength,
+        int64 Ticks, uint64 FrameCounter, bool bLineTerminator)
+    {
+        const bool bShowCategory = GPrintLogCategory && Category != NAME_None;
+
+        uint8* Out = WriteTimestampPrefix(Dest, Ticks, FrameCounter);
+
+        if (bShowCategory)
+        {
+            Out = WriteCategory(Out, Category);
+            if (Verbosity != ELogVerbosity::Log)
+            {
+                *Out++ = ':';
+                Out = WriteAscii(Out, FOutputDeviceHelper::VerbosityToString(Verbosity));
+            }
+            Out = WriteAscii(Out, TEXT(": "));
+        }
+        else
+        {
+            if (Verbosity != ELogVerbosity::Log)
+            {
+#if !HACK_HEADER_GENERATOR
+                Out = WriteAscii(Out, FOutputDeviceHelper::VerbosityToString(Verbosity));
+                Out = WriteAscii(Out, TEXT(": "));
+#endif
+            }
+        }
+
+        Out = WriteUTF8(Out, Message, MessageLength);
+
+        if (bLineTerminator)
+        {
+            Out = WriteAscii(Out, GetLineTerminator());
+        }
+
+        return (int32)(Out - Dest);
+    }
+
+    /**
+     * Reads the timestamp, frame counter and verbosity back from a line written by EncodeLogLine
+     * @param OutFrameCounter - receives the frame counter modulo 1000, all the line holds
+     * @return false if Line doesn't start with a timestamp prefix, e.g. raw bytes
+     */
+    static bool ParseLinePrefix(const uint8* Line, int32 Length, int64& OutTicks, uint32& OutFrameCounter, ELogVerbosity::Type& OutVerbosity)
+    {
+        // "[YYYY.MM.DD-HH.MM.SS:mmm][fff]"
+        if (Length < PrefixLength || Line[0] != '[' || Line[24] != ']' || Line[25] != '[' || Line[PrefixLength - 1] != ']')
+        {
+            return false;
+        }
+
+        const int32 Year = ReadDigits(Line + 1, 4);
+        const int32 Month = ReadDigits(Line + 6, 2);
+        const int32 Day = ReadDigits(Line + 9, 2);
+        const int32 Hour = ReadDigits(Line + 12, 2);
+        const int32 Minute = ReadDigits(Line + 15, 2);
+        const int32 Second = ReadDigits(Line + 18, 2);
+        const int32 Millisecond = ReadDigits(Line + 21, 3);
+        if (!FDateTime::Validate(Year, Month, Day, Hour, Minute, Second, Millisecond))
+        {
+            return false;
+        }
+        OutTicks = FDateTime(Year, Month, Day, Hour, Minute, Second, Millisecond).GetTicks();
+
+        uint32 FrameCounter = 0;
+        for (int32 Index = 26; Index < PrefixLength - 1; ++Index)
+        {
+            if (Line[Index] >= '0' && Line[Index] <= '9')
+            {
+                FrameCounter = FrameCounter * 10 + (Line[Index] - '0');
+            }
+        }
+        OutFrameCounter = FrameCounter;
+
+        // "Category:Verbosity: ", "Category: " or "Verbosity: ", a Log line without category has none of them
+        OutVerbosity = ELogVerbosity::Log;
+        const int32 TokenEnd = FMath::Min(Length, PrefixLength + MaxNameLength);
+        int32 Space = PrefixLength;
+        while (Space < TokenEnd && Line[Space] != ' ')
+        {
+            ++Space;
+        }
+        if (Space == TokenEnd || Space == PrefixLength || Line[Space - 1] != ':')
+        {
+            return true;
+        }
+
+        int32 NameStart = Space - 1;
+        while (NameStart > PrefixLength && Line[NameStart - 1] != ':')
+        {
+            --NameStart;
+        }
+
+        for (int32 Verbosity = ELogVerbosity::Fatal; Verbosity <= ELogVerbosity::VeryVerbose; ++Verbosity)
+        {
+            if (EqualsAscii(Line + NameStart, Space - 1 - NameStart, FOutputDeviceHelper::VerbosityToString((ELogVerbosity::Type)Verbosity)))
+            {
+                OutVerbosity = (ELogVerbosity::Type)Verbosity;
+                break;
+            }
+        }
+        return true;
+    }
+
+private:
+    /** Reads Width decimal digits, -1 if one of them isn't a digit */
+    static int32 ReadDigits(const uint8* In, int32 Width)
+    {
+        int32 Value = 0;
+        for (int32 Index = 0; Index < Width; ++Index)
+        {
+            if (In[Index] < '0' || In[Index] > '9')
+            {
+                return -1;
+            }
+            Value = Value * 10 + (In[Index] - '0');
+        }
+        return Value;
+    }
+
+    /** Whether the Length bytes at In are the pure ASCII string Text */
+    static bool EqualsAscii(const uint8* In, int32 Length, const TCHAR* Text)
+    {
+        int32 Index = 0;
+        for (; Index < Length && Text[Index]; ++Index)
+        {
+            if (In[Index] != (uint8)Text[Index])
+            {
+                return false;
+            }
+        }
+        return Index == Length && !Text[Index];
+    }
+
+    /** Writes "[YYYY.MM.DD-HH.MM.SS:mmm][fff]", the same as "%Y.%m.%d-%H.%M.%S:%s" and "%3d" */
+    static uint8* WriteTimestampPrefix(uint8* Out, int64 Ticks, uint64 FrameCounter)
+    {
+        Out = FLogTimestampCache::WriteTimestamp(Out, Ticks);
+        *Out++ = '[';
+        Out = WriteFrameCounter(Out, FrameCounter);
+        *Out++ = ']';
+        return Out;
+    }
+
+    /** Writes FrameCounter % 1000 space padded to 3 characters, the same as "%3d" */
+    static uint8* WriteFrameCounter(uint8* Out, uint64 FrameCounter)
+    {
+        uint32 Value = (uint32)(FrameCounter % 1000);
+        for (int32 Index = 2; Index >= 0; --Index)
+        {
+            Out[Index] = (Value != 0 || Index == 2) ? (uint8)('0' + Value % 10) : (uint8)' ';
+            Value /= 10;
+        }
+        return Out + 3;
+    }
+
+    /** Writes a decimal number without padding */
+    static uint8* WriteNumber(uint8* Out, uint32 Value)
+    {
+        uint8 Digits[10];
+        int32 Count = 0;
+        do
+        {
+            Digits[Count++] = (uint8)('0' + Value % 10);
+            Value /= 10;
+        } while (Value != 0);
+
+        while (Count > 0)
+        {
+            *Out++ = Digits[--Count];
+        }
+        return Out;
+    }
+
+    /** Copies a pure ASCII string */
+    template<typename CharType>
+    static uint8* WriteAscii(uint8* Out, const CharType* Text)
+    {
+        while (*Text)
+        {
+            *Out++ = (uint8)*Text++;
+        }
+        return Out;
+    }
+
+    /** Writes the category name straight from the name table, the same text as FName::ToString */
+    static uint8* WriteCategory(uint8* Out, const class FName& Category)
+    {
+        const FNameEntry* NameEntry = Category.GetDisplayNameEntry();
+        if (NameEntry->IsWide())
+        {
+            const WIDECHAR* Name = NameEntry->GetWideName();
+            Out = WriteUTF8(Out, Name, FCStringWide::Strlen(Name));
+        }
+        else
+        {
+            // Names are only stored as ANSI when they are pure ASCII
+            Out = WriteAscii(Out, NameEntry->GetAnsiName());
+        }
+
+        if (Category.GetNumber() != NAME_NO_NUMBER_INTERNAL)
+        {
+            *Out++ = '_';
+            Out = WriteNumber(Out, NAME_INTERNAL_TO_EXTERNAL(Category.GetNumber()));
+        }
+        return Out;
+    }
+
+    /** Encodes Length characters of Text as UTF-8, vectorized over runs of ASCII */
+    template<typename CharType>
+    static uint8* WriteUTF8(uint8* Out, const CharType* Text, int32 Length)
+    {
+        int32 Index = 0;
+        while (Index < Length)
+        {
+#if LOGMANAGER_WITH_SSE2
+            if (sizeof(CharType) == 2)
+            {
+                // 16 characters at a time while none of them needs more than one byte
+                const __m128i NonAsciiMask = _mm_set1_epi16((int16)0xFF80);
+                const __m128i Zero = _mm_setzero_si128();
+                while (Index + 16 <= Length)
+                {
+                    const __m128i Low = _mm_loadu_si128((const __m128i*)(Text + Index));
+                    const __m128i High = _mm_loadu_si128((const __m128i*)(Text + Index + 8));
+                    const __m128i NonAscii = _mm_and_si128(_mm_or_si128(Low, High), NonAsciiMask);
+                    if (_mm_movemask_epi8(_mm_cmpeq_epi16(NonAscii, Zero)) != 0xFFFF)
+                    {
+                        break;
+                    }
+
+                    _mm_storeu_si128((__m128i*)Out, _mm_packus_epi16(Low, High));
+                    Out += 16;
+                    Index += 16;
+                }
+            }
+#endif // LOGMANAGER_WITH_SSE2
+
+            // Scalar path for the block that stopped the vector loop and for the tail
+            const int32 BlockEnd = FMath::Min(Length, Index + 16);
+            for (; Index < BlockEnd; ++Index)
+            {
+                uint32 CodePoint = (uint32)Text[Index];
+                if (CodePoint < 0x80)
+                {
+                    *Out++ = (uint8)CodePoint;
+                    continue;
+                }
+
+                if (sizeof(CharType) == 2 && CodePoint >= 0xD800 && CodePoint <= 0xDFFF)
+                {
+                    const uint32 LowSurrogate = Index + 1 < Length ? (uint32)Text[Index + 1] : 0;
+                    if (CodePoint <= 0xDBFF && LowSurrogate >= 0xDC00 && LowSurrogate <= 0xDFFF)
+                    {
+                        CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + (LowSurrogate - 0xDC00);
+                        ++Index;
+                    }
+                    else
+                    {
+                        // Unpaired surrogate, same replacement as FTCHARToUTF8
+                        *Out++ = '?';
+                        continue;
+                    }
+                }
+
+                if (CodePoint < 0x800)
+                {
+                    *Out++ = (uint8)(0xC0 | (CodePoint >> 6));
+                    *Out++ = (uint8)(0x80 | (CodePoint & 0x3F));
+                }
+                else if (CodePoint < 0x10000)
+                {
+                    *Out++ = (uint8)(0xE0 | (CodePoint >> 12));
+                    *Out++ = (uint8)(0x80 | ((CodePoint >> 6) & 0x3F));
+                    *Out++ = (uint8)(0x80 | (CodePoint & 0x3F));
+                }
+                else if (CodePoint < 0x110000)
+                {
+                    *Out++ = (uint8)(0xF0 | (CodePoint >> 18));
+                    *Out++ = (uint8)(0x80 | ((CodePoint >> 12) & 0x3F));
+                    *Out++ = (uint8)(0x80 | ((CodePoint >> 6) & 0x3F));
+                    *Out++ = (uint8)(0x80 | (CodePoint & 0x3F));
+                }
+                else
+                {
+                    *Out++ = '?';
+                }
+            }
+        }
+        return Out;
+    }
+};
@@ -0,0 +1,103 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "UObject/NameTypes.h"
+#include "Logging/LogVerbosity.h"
+#include "Misc/Timespan.h"
+
+/**
+ * Compact raw log line queued by writers that defer formatting to the writer thread.
+ * The record is followed by PayloadLength bytes of payload: the unformatted TCHAR message, or
+ * ready-to-write bytes if the record is preformatted.
+ */
+struct FLogLineRecord
+{
+    enum EFlags
+    {
+        /** Payload is written as is, without formatting */
+        Preformatted = 1 << 0,
+        /** A line terminator is appended to the message */
+        LineTerminator = 1 << 1
+    };
+
+    /** FDateTime ticks at the time the line was logged */
+    int64 Ticks;
+    /** GFrameCounter at the time the line was logged */
+    uint64 FrameCounter;
+    /** Category printed in the line, NAME_None to leave it out */
+    FName Category;
+    /** Time passed in by the caller */
+    double Time;
+    /** Payload length in bytes */
+    int32 PayloadLength;
+    /** ELogVerbosity::Type of the line */
+    uint8 Verbosity;
+    /** EFlags */
+    uint8 Flags;
+
+    /** Bytes needed for a record with PayloadLength bytes of payload */
+    static int64 GetRecordLength(int64 PayloadLength)
+    {
+        return sizeof(FLogLineRecord) + PayloadLength;
+    }
+
+    const uint8* GetPayload() const
+    {
+        return (const uint8*)(this + 1);
+    }
+
+    uint8* GetPayload()
+    {
+        return (uint8*)(this + 1);
+    }
+};
+
+/**
+ * Fields of a formatted line the sidecar index needs, queued ahead of the line's bytes when the writer indexes lines
+ * it didn't format. Times are kept in milliseconds from the writer's base and frames by their low bits, the writer
+ * restores both from the last tag it read.
+ */
+struct FLogLineTag
+{
+    enum
+    {
+        FrameBits = 28,
+        FrameMask = (1 << FrameBits) - 1
+    };
+
+    /** Milliseconds since the writer's base ticks */
+    int32 Milliseconds;
+    /** Low FrameBits bits of GFrameCounter, ELogVerbosity::Type above them, NoLogging for raw bytes that aren't a line */
+    uint32 FrameAndVerbosity;
+
+    static FLogLineTag Make(int64 BaseTicks, int64 Ticks, uint64 FrameCounter, ELogVerbosity::Type Verbosity)
+    {
+        int64 Delta = Ticks - BaseTicks;
+        int64 Milliseconds = Delta >= 0 ? Delta / ETimespan::TicksPerMillisecond : -((-Delta + ETimespan::TicksPerMillisecond - 1) / ETimespan::TicksPerMillisecond);
+
+        FLogLineTag Tag;
+        Tag.Milliseconds = (int32)FMath::Clamp<int64>(Milliseconds, MIN_int32, MAX_int32);
+        Tag.FrameAndVerbosity = ((uint32)FrameCounter & FrameMask) | ((uint32)(Verbosity & ELogVerbosity::VerbosityMask) << FrameBits);
+        return Tag;
+    }
+
+    int64 GetTicks(int64 BaseTicks) const
+    {
+        return BaseTicks + (int64)Milliseconds * ETimespan::TicksPerMillisecond;
+    }
+
+    /** The frame counter nearest to NearFrame whose low bits match the tag's */
+    uint64 GetFrameCounter(uint64 NearFrame) const
+    {
+        // Sign extend the difference of the low bits, lines from other threads may be a frame behind the last one read
+        const uint32 LowDelta = ((FrameAndVerbosity & FrameMask) - (uint32)NearFrame) & FrameMask;
+        const int32 Delta = (int32)(LowDelta << (32 - FrameBits)) >> (32 - FrameBits);
+        return NearFrame + (int64)Delta;
+    }
+
+    ELogVerbosity::Type GetVerbosity() const
+    {
+        return (ELogVerbosity::Type)(FrameAndVerbosity >> FrameBits);
+    }
+};
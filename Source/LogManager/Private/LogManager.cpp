@@ -2,19 +2,47 @@
 
 #include "LogManagerPrivatePCH.h"
 
+#include "Async/Async.h"
+#include "Containers/Ticker.h"
 #include "GenericPlatform/GenericPlatformFile.h"
 #include "HAL/ExceptionHandling.h"
 #include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CoreDelegates.h"
 #include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
 #include "Misc/OutputDeviceRedirector.h"
+#include "Stats/Stats.h"
 
 typedef uint8 UTF8BOMType[3];
 static UTF8BOMType UTF8BOM = { 0xEF, 0xBB, 0xBF };
 
 IMPLEMENT_MODULE(FLogManager, LogManager)
 
+DECLARE_STATS_GROUP(TEXT("LogManager"), STATGROUP_LogManager, STATCAT_Advanced);
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Lines written"), STAT_LogManager_LinesWritten, STATGROUP_LogManager);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("KB written"), STAT_LogManager_KBWritten, STATGROUP_LogManager);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Peak queue occupancy %"), STAT_LogManager_PeakOccupancy, STATGROUP_LogManager);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Flush stalls"), STAT_LogManager_FlushStalls, STATGROUP_LogManager);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Flush stall ms"), STAT_LogManager_FlushStallMs, STATGROUP_LogManager);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Full queue waits"), STAT_LogManager_FullBufferWaits, STATGROUP_LogManager);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Full queue wait ms"), STAT_LogManager_FullBufferWaitMs, STATGROUP_LogManager);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Archive flushes"), STAT_LogManager_ArchiveFlushes, STATGROUP_LogManager);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Archive flush ms"), STAT_LogManager_ArchiveFlushMs, STATGROUP_LogManager);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Lines dropped"), STAT_LogManager_DroppedLines, STATGROUP_LogManager);
+
 FLogManager::FLogManager()
+    : IOScheduler(nullptr)
+    , Compressor(nullptr)
+    , FlightRecorder(nullptr)
+    , FlushTicketCounter(0)
+    , bSyncFlushOnLevel(false)
+    , bBinaryLogs(false)
 {
+    // Loaded at PostConfigInit, the last chance to put a proxy in front of GMalloc before other threads allocate
+    FLogBenchmark::InstallAllocationCounter();
+
     TCHAR LogFilename[128] = { 0 };
     TCHAR AbsoluteLogFilename[1024] = { 0 };
 
@@ -32,6 +60,99 @@ FLogManager::FLogManager()
     CurrentLogDir = IFileManager::Get().ConvertToAbsolutePathForExternalAppForWrite(
         *FString::Printf(TEXT("%s%s %s"), *GameLogDir, *GameName, *SystemTime));
 
+    if (FPlatformProcess::SupportsMultithreading())
+    {
+        IOScheduler = new FLogIOScheduler();
+    }
+
+    // Flushing every line only means something if each line is on disk before the call returns
+    bSyncFlushOnLevel = FParse::Param(FCommandLine::Get(), TEXT("LOGSYNCFLUSH")) ||
+        FParse::Param(FCommandLine::Get(), TEXT("FORCELOGFLUSH"));
+
+    WriterSettings = FLogWriterSettings::FromCommandLine();
+
+    if (WriterSettings.bCompressSegments && FPlatformProcess::SupportsMultithreading())
+    {
+        Compressor = new FLogCompressor();
+    }
+
+    // Always on unless sized to 0, a few MB of context is cheap next to flushing every line
+    int32 FlightRecorderSizeMB = 4;
+    FParse::Value(FCommandLine::Get(), TEXT("LOGFLIGHTRECORDER="), FlightRecorderSizeMB);
+    if (FlightRecorderSizeMB > 0)
+    {
+        FlightRecorder = FLogFlightRecorder::Create(CurrentLogDir / FLogFlightRecorder::GetFilename(), (int64)FlightRecorderSizeMB * 1024 * 1024);
+    }
+
+    // Sessions that died left their recorder behind, turn them into text without holding up startup
+    const FString SessionsDir = FPaths::GetPath(CurrentLogDir);
+    FlightRecorderRecovery = Async<void>(EAsyncExecution::Thread, [SessionsDir]()
+    {
+        FLogFlightRecorder::RecoverCrashedSessions(SessionsDir);
+    });
+
+    // Other instances sharing the log directory leave the session alone while this process runs
+    FLogRetention::BeginSession(CurrentLogDir);
+
+    // -LOGKEEPSESSIONS=20 -LOGKEEPMB=512 -LOGKEEPDAYS=7 prune old sessions at startup, any of them is enough
+    FLogRetentionPolicy RetentionPolicy;
+    const bool bHasKeepSessions = FParse::Value(FCommandLine::Get(), TEXT("LOGKEEPSESSIONS="), RetentionPolicy.MaxSessions);
+    int32 KeepMB = 0;
+    const bool bHasKeepMB = FParse::Value(FCommandLine::Get(), TEXT("LOGKEEPMB="), KeepMB);
+    RetentionPolicy.MaxTotalBytes = (int64)FMath::Max(KeepMB, 0) * 1024 * 1024;
+    float KeepDays = 0.0f;
+    const bool bHasKeepDays = FParse::Value(FCommandLine::Get(), TEXT("LOGKEEPDAYS="), KeepDays);
+    RetentionPolicy.MaxAgeDays = KeepDays;
+    if (bHasKeepSessions || bHasKeepMB || bHasKeepDays)
+    {
+        ApplyLogRetention(RetentionPolicy);
+    }
+
+    // -LOGRATELIMIT=LogNet:1000:5000+200 limits LogNet to 1000 lines/s with bursts of 5000 and the default file to 200 lines/s,
+    // -LOGSAMPLE=LogAI:0.1 keeps one LogAI line in ten
+    FString LimitList;
+    if (FParse::Value(FCommandLine::Get(), TEXT("LOGRATELIMIT="), LimitList))
+    {
+        TArray<FString> RateLimits;
+        LimitList.ParseIntoArray(RateLimits, TEXT("+"), true);
+        for (const FString& RateLimit : RateLimits)
+        {
+            TArray<FString> Fields;
+            RateLimit.ParseIntoArray(Fields, TEXT(":"), false);
+            const int32 RateField = Fields.Num() > 0 && !Fields[0].IsNumeric() ? 1 : 0;
+            if (Fields.IsValidIndex(RateField))
+            {
+                FLineLimits& Limits = CommandLineLimits.FindOrAdd(RateField > 0 ? Fields[0] : FString());
+                Limits.LinesPerSecond = FCString::Atof(*Fields[RateField]);
+                Limits.Burst = Fields.IsValidIndex(RateField + 1) ? FCString::Atoi(*Fields[RateField + 1]) : FMath::CeilToInt(Limits.LinesPerSecond);
+            }
+        }
+    }
+
+    if (FParse::Value(FCommandLine::Get(), TEXT("LOGSAMPLE="), LimitList))
+    {
+        TArray<FString> Samplings;
+        LimitList.ParseIntoArray(Samplings, TEXT("+"), true);
+        for (const FString& Sampling : Samplings)
+        {
+            FString Category;
+            FString Ratio = Sampling;
+            Sampling.Split(TEXT(":"), &Category, &Ratio);
+            CommandLineLimits.FindOrAdd(Category).KeepRatio = FCString::Atof(*Ratio);
+        }
+    }
+
+    // -LOGBINARY=LogNet+LogAI picks categories, a bare -LOGBINARY switches every file
+    FString BinaryCategoryList;
+    if (FParse::Value(FCommandLine::Get(), TEXT("LOGBINARY="), BinaryCategoryList))
+    {
+        BinaryCategoryList.ParseIntoArray(BinaryCategories, TEXT("+"), true);
+    }
+    else
+    {
+        bBinaryLogs = FParse::Param(FCommandLine::Get(), TEXT("LOGBINARY"));
+    }
+
     // Adds default filter
     DefaultLogFilename =
         FString::Printf(TEXT("%s/%s%s"), *CurrentLogDir,
@@ -39,10 +160,41 @@ FLogManager::FLogManager()
             bHasLogFileName ? TEXT("") : TEXT(".log"));
 
     FLogFilter DefaultFiter;
-    DefaultFiter.AsyncWriter = CreateAsyncWriter(DefaultLogFilename);
+    // DefaultLogFilename stays the text name, the engine's own log device writes to it on shutdown if the default file is binary
+    const bool bBinaryDefault = IsBinaryCategory(FString());
+    DefaultFiter.AsyncWriter = CreateAsyncWriter(
+        bBinaryDefault ? FPaths::ChangeExtension(DefaultLogFilename, FLogBinaryFormat::GetExtension()) : DefaultLogFilename,
+        bBinaryDefault);
+    ApplyCommandLineLimits(FString(), DefaultFiter.AsyncWriter);
 	DefaultFiter.FlushOn =
 		FParse::Param(FCommandLine::Get(), TEXT("FORCELOGFLUSH")) ? ELogVerbosity::All : ELogVerbosity::Warning;
-    LogFilters.AddUnique(DefaultFiter);
+    DefaultFiter.bEnabled = true;
+    DefaultFiter.bSingleCategory = false;
+    Filters.Update([this, &DefaultFiter](FLogFilterTable& Table)
+    {
+        Table.Filters.Add(DefaultFiter);
+        Table.FlightRecorder = FlightRecorder;
+        return true;
+    });
+
+    // -LOGROUTE=LogNet*:Net+LogOnline*:Online:Net sends the LogNet family to Net.log and the LogOnline one to both Online.log and Net.log
+    FString RouteList;
+    if (FParse::Value(FCommandLine::Get(), TEXT("LOGROUTE="), RouteList))
+    {
+        TArray<FString> Routes;
+        RouteList.ParseIntoArray(Routes, TEXT("+"), true);
+        for (const FString& Route : Routes)
+        {
+            TArray<FString> Sinks;
+            Route.ParseIntoArray(Sinks, TEXT(":"), true);
+            if (Sinks.Num() > 1)
+            {
+                const FString Pattern = Sinks[0];
+                Sinks.RemoveAt(0);
+                AddRoute(Pattern, Sinks, ELogVerbosity::Warning);
+            }
+        }
+    }
 
     if (!GUseCrashReportClient)
     {
@@ -72,16 +224,40 @@ void FLogManager::StartupModule()
         GLog->AddOutputDevice(this);
         GLog->SerializeBacklog(this);
     }
+
+#if STATS
+    StatEnabledHandle = FCoreDelegates::StatEnabled.AddRaw(this, &FLogManager::OnStatEnabled);
+    StatDisabledHandle = FCoreDelegates::StatDisabled.AddRaw(this, &FLogManager::OnStatDisabled);
+    StatDisableAllHandle = FCoreDelegates::StatDisableAll.AddRaw(this, &FLogManager::OnStatDisableAll);
+#endif // STATS
 }
 
 
 void FLogManager::ShutdownModule()
 {
+#if STATS
+    FCoreDelegates::StatEnabled.Remove(StatEnabledHandle);
+    FCoreDelegates::StatDisabled.Remove(StatDisabledHandle);
+    FCoreDelegates::StatDisableAll.Remove(StatDisableAllHandle);
+    StopStatsTicker();
+#endif // STATS
+
     if (GLog)
     {
         GLog->RemoveOutputDevice(this);
     }
 
+    // The engine's log device appends to the text segment the default file ended in, a rotated segment if it rotated.
+    // A binary or live compressed default file can't be appended to as text, its tail goes to DefaultLogFilename then.
+    FString EngineLogFilename = DefaultLogFilename;
+    {
+        const FLogFilterRegistry::FReadScope Table(Filters);
+        if (Table->Filters.Num() > 0 && Table->Filters[0].AsyncWriter && !IsBinaryCategory(FString()) && !WriterSettings.bCompressLive)
+        {
+            EngineLogFilename = Table->Filters[0].AsyncWriter->GetFilename();
+        }
+    }
+
     // This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
     // we call this function before unloading the module.
     TearDown();
@@ -89,7 +265,7 @@ void FLogManager::ShutdownModule()
     FOutputDeviceFile* OutputLogFile = static_cast<FOutputDeviceFile*>(FPlatformOutputDevices::GetLog());
     if (OutputLogFile)
     {
-        OutputLogFile->SetFilename(*DefaultLogFilename);
+        OutputLogFile->SetFilename(*EngineLogFilename);
         GLog->AddOutputDevice(OutputLogFile);
     }
 }
@@ -98,42 +274,235 @@ void FLogManager::AddFilter(const FString& Category, ELogVerbosity::Type FlushOn
 {
     if (!Category.IsEmpty())
     {
-        FLogFilter LogFilter{ Category, nullptr, FlushOn };
+        Filters.Update([this, &Category, FlushOn](FLogFilterTable& Table)
+        {
+            FLogFilter LogFilter{ Category, nullptr, FlushOn, true, true };
+
+            // Nothing to add to once torn down
+            if (Table.Filters.Num() == 0 || Table.Filters.Contains(LogFilter))
+            {
+                return false;
+            }
+
+            LogFilter.AsyncWriter = CreateFilterWriter(Category);
+            Table.Filters.Add(LogFilter);
+            return true;
+        });
+    }
+}
+
+void FLogManager::AddRoute(const FString& Pattern, const TArray<FString>& Sinks, ELogVerbosity::Type FlushOn)
+{
+    if (Pattern.IsEmpty() || Sinks.Num() == 0)
+    {
+        return;
+    }
+
+    Filters.Update([this, &Pattern, &Sinks, FlushOn](FLogFilterTable& Table)
+    {
+        if (Table.Filters.Num() == 0)
+        {
+            return false;
+        }
+
+        FLogRouteRule* Rule = Table.Rules.FindByPredicate([&Pattern](const FLogRouteRule& Existing)
+        {
+            return Existing.Pattern.Equals(Pattern, ESearchCase::IgnoreCase);
+        });
+
+        if (!Rule)
+        {
+            Rule = &Table.Rules[Table.Rules.Add(FLogRouteRule{ Pattern, TArray<FString>(), 0, TArray<int32>() })];
+        }
+
+        for (const FString& Sink : Sinks)
+        {
+            if (Sink.IsEmpty())
+            {
+                continue;
+            }
+
+            // Sinks are filters like any other, another rule or an AddFilter category may already write to this one
+            FLogFilter LogFilter{ Sink, nullptr, FlushOn, true, false };
+            if (!Table.Filters.Contains(LogFilter))
+            {
+                LogFilter.AsyncWriter = CreateFilterWriter(Sink);
+                Table.Filters.Add(LogFilter);
+            }
+
+            Rule->Sinks.AddUnique(Sink);
+        }
+
+        return true;
+    });
+}
+
+void FLogManager::RemoveRoute(const FString& Pattern)
+{
+    TArray<FLogAsyncWriter*> RemovedWriters;
+    Filters.Update([&Pattern, &RemovedWriters](FLogFilterTable& Table)
+    {
+        const int32 NumRemoved = Table.Rules.RemoveAll([&Pattern](const FLogRouteRule& Rule)
+        {
+            return Rule.Pattern.Equals(Pattern, ESearchCase::IgnoreCase);
+        });
+
+        // Routed files no rule writes to any more are closed, the default log file and AddFilter files stay
+        for (int32 Index = Table.Filters.Num() - 1; Index > 0; --Index)
+        {
+            const FLogFilter& LogFilter = Table.Filters[Index];
+            const bool bRouted = LogFilter.bSingleCategory || Table.Rules.ContainsByPredicate([&LogFilter](const FLogRouteRule& Rule)
+            {
+                return Rule.Sinks.Contains(LogFilter.Category);
+            });
 
-        if (INDEX_NONE == LogFilters.Find(LogFilter))
+            if (!bRouted)
+            {
+                RemovedWriters.Add(LogFilter.AsyncWriter);
+                Table.Filters.RemoveAt(Index);
+            }
+        }
+
+        return NumRemoved > 0;
+    });
+
+    for (FLogAsyncWriter* AsyncWriter : RemovedWriters)
+    {
+        if (AsyncWriter)
         {
-            const FString Filename = FString::Printf(TEXT("%s/%s.log"), *CurrentLogDir, *Category);
-            
-            LogFilter.AsyncWriter = CreateAsyncWriter(Filename);
-            LogFilters.AddUnique(LogFilter);
+            CloseAsyncWriter(AsyncWriter);
         }
     }
 }
 
 void FLogManager::ChangeLogFlushOnLevel(const FString& Category, ELogVerbosity::Type FlushOn)
 {
-	int32 FoundIndex = INDEX_NONE;
-	FLogFilter LogFilter{ Category, nullptr, ELogVerbosity::All };
+	Filters.Update([&Category, FlushOn](FLogFilterTable& Table)
+	{
+		const FLogFilter* LogFilter = Table.Find(FName(*Category));
+
+		if (LogFilter)
+		{
+			Table.Filters[LogFilter - Table.Filters.GetData()].FlushOn = FlushOn;
+		}
+
+		return LogFilter != nullptr;
+	});
+}
+
+void FLogManager::SetBackpressurePolicy(const FString& Category, ELogBackpressure::Type Policy)
+{
+	const FLogFilterRegistry::FReadScope Table(Filters);
+	FLogAsyncWriter* AsyncWriter = FindFilterWriter(*Table, Category);
+
+	if (AsyncWriter)
+	{
+		AsyncWriter->SetBackpressurePolicy(Policy);
+	}
+}
+
+void FLogManager::SetRateLimit(const FString& Category, float LinesPerSecond, int32 Burst)
+{
+	const FLogFilterRegistry::FReadScope Table(Filters);
+	FLogAsyncWriter* AsyncWriter = FindFilterWriter(*Table, Category);
+
+	if (AsyncWriter)
+	{
+		AsyncWriter->SetRateLimit(LinesPerSecond, Burst);
+	}
+}
+
+void FLogManager::SetSampling(const FString& Category, float KeepRatio)
+{
+	const FLogFilterRegistry::FReadScope Table(Filters);
+	FLogAsyncWriter* AsyncWriter = FindFilterWriter(*Table, Category);
+
+	if (AsyncWriter)
+	{
+		AsyncWriter->SetSampling(KeepRatio);
+	}
+}
+
+FLogAsyncWriter* FLogManager::FindFilterWriter(const FLogFilterTable& Table, const FString& Category)
+{
+	if (Category.IsEmpty())
+	{
+		return Table.Filters.Num() > 0 ? Table.Filters[0].AsyncWriter : nullptr;
+	}
+
+	const FLogFilter* LogFilter = Table.Find(FName(*Category));
+
+	return LogFilter ? LogFilter->AsyncWriter : nullptr;
+}
+
+void FLogManager::ApplyCommandLineLimits(const FString& Category, FLogAsyncWriter* AsyncWriter)
+{
+	const FLineLimits* Limits = CommandLineLimits.Find(Category);
 
-	if (LogFilters.Find(LogFilter, FoundIndex))
+	if (Limits && AsyncWriter)
 	{
-		LogFilters[FoundIndex].FlushOn = FlushOn;
+		AsyncWriter->SetRateLimit(Limits->LinesPerSecond, Limits->Burst);
+		AsyncWriter->SetSampling(Limits->KeepRatio);
 	}
 }
 
 void FLogManager::RemoveFilter(const FString& Category)
 {
+    if (Category.IsEmpty())
+    {
+        return;
+    }
+
+    FLogAsyncWriter* RemovedWriter = nullptr;
+    Filters.Update([&Category, &RemovedWriter](FLogFilterTable& Table)
+    {
+        const FLogFilter* LogFilter = Table.Find(FName(*Category));
 
+        if (LogFilter)
+        {
+            RemovedWriter = LogFilter->AsyncWriter;
+            Table.Filters.RemoveAt(LogFilter - Table.Filters.GetData());
+        }
+
+        return LogFilter != nullptr;
+    });
+
+    // No logging thread can reach the writer any more once the update returns
+    if (RemovedWriter)
+    {
+        CloseAsyncWriter(RemovedWriter);
+    }
 }
 
 void FLogManager::EnableFilter(const FString& Category)
 {
-
+    SetFilterEnabled(Category, true);
 }
 
 void FLogManager::DisableFilter(const FString& Category)
 {
+    SetFilterEnabled(Category, false);
+}
+
+void FLogManager::SetFilterEnabled(const FString& Category, bool bEnabled)
+{
+    Filters.Update([&Category, bEnabled](FLogFilterTable& Table)
+    {
+        int32 FilterIndex = Category.IsEmpty() ? 0 : INDEX_NONE;
+        if (!Category.IsEmpty())
+        {
+            const FLogFilter* LogFilter = Table.Find(FName(*Category));
+            FilterIndex = LogFilter ? (int32)(LogFilter - Table.Filters.GetData()) : INDEX_NONE;
+        }
 
+        if (!Table.Filters.IsValidIndex(FilterIndex) || Table.Filters[FilterIndex].bEnabled == bEnabled)
+        {
+            return false;
+        }
+
+        Table.Filters[FilterIndex].bEnabled = bEnabled;
+        return true;
+    });
 }
 
 const FString& FLogManager::GetCurrentLogDir() const
@@ -146,82 +515,256 @@ void FLogManager::RemainsLogCount(int32 LogFolderCount)
     // Delete old log directory
     if (LogFolderCount >= 0)
     {
-        const FString GameLogDir = FPaths::GetPath(CurrentLogDir).AppendChar(TEXT('/'));
-        const FString GameName = FCString::Strlen(FApp::GetGameName()) != 0 ? FApp::GetGameName() : TEXT("UE4");
+        FLogRetentionPolicy Policy;
+        Policy.MaxSessions = LogFolderCount;
+        ApplyLogRetention(Policy);
+    }
+}
+
+void FLogManager::ApplyLogRetention(const FLogRetentionPolicy& Policy)
+{
+    const FString GameLogDir = FPaths::GetPath(CurrentLogDir);
+    const FString GameName = FCString::Strlen(FApp::GetGameName()) != 0 ? FApp::GetGameName() : TEXT("UE4");
+    const FString CurrentSession = FPaths::GetCleanFilename(CurrentLogDir);
+
+    RetentionTasks.RemoveAll([](const TFuture<void>& Task)
+    {
+        return Task.IsReady();
+    });
+
+    // Walking and deleting old sessions can take seconds on a slow disk, the caller is usually the game thread
+    RetentionTasks.Add(Async<void>(EAsyncExecution::ThreadPool, [GameLogDir, GameName, CurrentSession, Policy]()
+    {
+        FLogRetention::Apply(GameLogDir, GameName, CurrentSession, Policy);
+    }));
+}
+
+int64 FLogManager::RequestFlush()
+{
+    const int64 Ticket = FPlatformAtomics::InterlockedIncrement(&FlushTicketCounter);
 
-        class FLogDirectoryVisitor : public IPlatformFile::FDirectoryVisitor
+    const FLogFilterRegistry::FReadScope Table(Filters);
+    for (const FLogFilter& LogFilter : Table->Filters)
+    {
+        if (LogFilter.AsyncWriter)
         {
-        public:
-            FLogDirectoryVisitor(const FString& FolderPrefix)
-                : LogFolderPrefix(FolderPrefix)
-            {
+            LogFilter.AsyncWriter->RequestFlush(Ticket);
+        }
+    }
 
-            }
+    return Ticket;
+}
 
-            //~ Begin FDirectoryVisitor Interface.
-            virtual bool Visit(const TCHAR* FilenameOrDirectory, bool bIsDirectory) override
+bool FLogManager::WaitForFlush(int64 Ticket, uint32 WaitTimeMs)
+{
+    const double StartTime = FPlatformTime::Seconds();
+
+    // Holding on to the table keeps a concurrent RemoveFilter from deleting a writer being waited on
+    const FLogFilterRegistry::FReadScope Table(Filters);
+    for (const FLogFilter& LogFilter : Table->Filters)
+    {
+        if (LogFilter.AsyncWriter)
+        {
+            uint32 RemainingMs = WaitTimeMs;
+            if (WaitTimeMs != MAX_uint32)
             {
-                if (bIsDirectory)
-                {
-                    const FString FolderName = FPaths::GetCleanFilename(FilenameOrDirectory);
-                    if (FolderName.StartsWith(LogFolderPrefix, ESearchCase::IgnoreCase))
-                    {
-                        LogFolders.Add(FolderName);
-                    }
-                }
+                const uint32 ElapsedMs = (uint32)((FPlatformTime::Seconds() - StartTime) * 1000.0);
+                RemainingMs = ElapsedMs < WaitTimeMs ? WaitTimeMs - ElapsedMs : 0;
+            }
 
-                return true;
+            if (!LogFilter.AsyncWriter->WaitForFlush(Ticket, RemainingMs))
+            {
+                return false;
             }
+        }
+    }
 
-            TArray<FString> LogFolders;
-            FString LogFolderPrefix;
-        } LogVisitor(GameName);
+    return true;
+}
 
-        IFileManager::Get().IterateDirectory(*GameLogDir, LogVisitor);
+void FLogManager::GetWriterStats(TArray<FLogWriterStats>& OutStats) const
+{
+    const FLogFilterRegistry::FReadScope Table(Filters);
 
-        if (LogVisitor.LogFolders.Num() >= LogFolderCount)
+    for (const FLogFilter& LogFilter : Table->Filters)
+    {
+        if (LogFilter.AsyncWriter)
         {
-            const int32 ExpiredFolderCount = LogVisitor.LogFolders.Num() - LogFolderCount;
-            LogVisitor.LogFolders.Sort();
+            FLogWriterStats& Stats = OutStats[OutStats.AddDefaulted()];
+            Stats.Category = LogFilter.Category;
+            LogFilter.AsyncWriter->GetStats(Stats);
+        }
+    }
+}
 
-            for (int32 i = 0; i < ExpiredFolderCount; ++i)
-            {
-                const FString ExpiredLogPath = GameLogDir + LogVisitor.LogFolders[i];
+#if STATS
+void FLogManager::GetStatsTotals(FLogWriterStats& OutTotals, double& OutPeakOccupancy) const
+{
+    TArray<FLogWriterStats> WriterStats;
+    GetWriterStats(WriterStats);
 
-                if (!CurrentLogDir.Equals(ExpiredLogPath, ESearchCase::IgnoreCase))
-                {
-                    IFileManager::Get().DeleteDirectory(*ExpiredLogPath, true, true);
-                }
-            }
-        }
+    OutTotals = FLogWriterStats();
+    OutPeakOccupancy = 0.0;
+    for (const FLogWriterStats& Stats : WriterStats)
+    {
+        OutTotals.LinesWritten += Stats.LinesWritten;
+        OutTotals.BytesWritten += Stats.BytesWritten;
+        OutTotals.FlushStalls += Stats.FlushStalls;
+        OutTotals.FlushStallSeconds += Stats.FlushStallSeconds;
+        OutTotals.FullBufferWaits += Stats.FullBufferWaits;
+        OutTotals.FullBufferWaitSeconds += Stats.FullBufferWaitSeconds;
+        OutTotals.ArchiveFlushes += Stats.ArchiveFlushes;
+        OutTotals.ArchiveFlushSeconds += Stats.ArchiveFlushSeconds;
+        OutTotals.DroppedLines += Stats.DroppedLines + Stats.RejectedLines + Stats.SampledOutLines;
+        OutPeakOccupancy = FMath::Max(OutPeakOccupancy, Stats.BufferCapacity > 0 ? 100.0 * Stats.PeakBufferOccupancy / Stats.BufferCapacity : 0.0);
+    }
+}
+
+void FLogManager::OnStatEnabled(const TCHAR* StatName)
+{
+    if (FCString::Stricmp(StatName, TEXT("LogManager")) != 0 || StatsTickerHandle.IsValid())
+    {
+        return;
+    }
+
+    // Deltas start from here, not from when the files were opened
+    double PeakOccupancy = 0.0;
+    GetStatsTotals(LastStatsTotals, PeakOccupancy);
+
+    StatsTickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FLogManager::UpdateStats));
+}
+
+void FLogManager::OnStatDisabled(const TCHAR* StatName)
+{
+    if (FCString::Stricmp(StatName, TEXT("LogManager")) == 0)
+    {
+        StopStatsTicker();
+    }
+}
+
+void FLogManager::OnStatDisableAll(const bool bInAnyViewport)
+{
+    StopStatsTicker();
+}
+
+void FLogManager::StopStatsTicker()
+{
+    if (StatsTickerHandle.IsValid())
+    {
+        FTicker::GetCoreTicker().RemoveTicker(StatsTickerHandle);
+        StatsTickerHandle.Reset();
     }
 }
 
+bool FLogManager::UpdateStats(float DeltaTime)
+{
+    // Per frame deltas of the totals, peaks are the highest of any file since it was opened
+    FLogWriterStats Totals;
+    double PeakOccupancy = 0.0;
+    GetStatsTotals(Totals, PeakOccupancy);
+
+    // Files closed since the last frame make the totals go down, count from the new totals then
+    auto Delta = [](int64 Total, int64 Last)
+    {
+        return (uint32)FMath::Max<int64>(Total - Last, 0);
+    };
+
+    SET_DWORD_STAT(STAT_LogManager_LinesWritten, Delta(Totals.LinesWritten, LastStatsTotals.LinesWritten));
+    SET_FLOAT_STAT(STAT_LogManager_KBWritten, Delta(Totals.BytesWritten, LastStatsTotals.BytesWritten) / 1024.0f);
+    SET_FLOAT_STAT(STAT_LogManager_PeakOccupancy, (float)PeakOccupancy);
+    SET_DWORD_STAT(STAT_LogManager_FlushStalls, Delta(Totals.FlushStalls, LastStatsTotals.FlushStalls));
+    SET_FLOAT_STAT(STAT_LogManager_FlushStallMs, FMath::Max(0.0, Totals.FlushStallSeconds - LastStatsTotals.FlushStallSeconds) * 1000.0);
+    SET_DWORD_STAT(STAT_LogManager_FullBufferWaits, Delta(Totals.FullBufferWaits, LastStatsTotals.FullBufferWaits));
+    SET_FLOAT_STAT(STAT_LogManager_FullBufferWaitMs, FMath::Max(0.0, Totals.FullBufferWaitSeconds - LastStatsTotals.FullBufferWaitSeconds) * 1000.0);
+    SET_DWORD_STAT(STAT_LogManager_ArchiveFlushes, Delta(Totals.ArchiveFlushes, LastStatsTotals.ArchiveFlushes));
+    SET_FLOAT_STAT(STAT_LogManager_ArchiveFlushMs, FMath::Max(0.0, Totals.ArchiveFlushSeconds - LastStatsTotals.ArchiveFlushSeconds) * 1000.0);
+    SET_DWORD_STAT(STAT_LogManager_DroppedLines, Delta(Totals.DroppedLines, LastStatsTotals.DroppedLines));
+
+    LastStatsTotals = Totals;
+    return true;
+}
+#endif // STATS
+
+bool FLogManager::DecodeBinaryLog(const FString& BinaryFilename, const FString& TextFilename)
+{
+    return FLogBinaryFormat::DecodeFile(BinaryFilename, TextFilename);
+}
+
+bool FLogManager::RecoverFlightRecorder(const FString& RecorderFilename, const FString& TextFilename)
+{
+    TArray<uint8> Text;
+    Text.Append(UTF8BOM, ARRAY_COUNT(UTF8BOM));
+
+    return FLogFlightRecorder::Recover(RecorderFilename, Text) && FFileHelper::SaveArrayToFile(Text, *TextFilename);
+}
+
+bool FLogManager::QueryLogIndex(const FString& LogFilename, const FLogIndexQuery& Query, TArray<FLogFileRange>& OutRanges) const
+{
+    return FLogIndexFormat::Query(LogFilename, Query, OutRanges);
+}
+
+bool FLogManager::IsBinaryCategory(const FString& Category) const
+{
+    return bBinaryLogs || (!Category.IsEmpty() && BinaryCategories.Contains(Category));
+}
+
 void FLogManager::TearDown()
 {
-    for (auto LogFilter : LogFilters)
+    // A search still scanning the session's files would print to a log that's going away
+    FLogSearch::CancelCommand();
+
+    // Logging threads see an empty table from here on and write nothing, nor record anything
+    TArray<FLogFilter> ClosedFilters;
+    Filters.Update([&ClosedFilters](FLogFilterTable& Table)
+    {
+        ClosedFilters = MoveTemp(Table.Filters);
+        Table.Filters.Reset();
+        Table.FlightRecorder = nullptr;
+        return true;
+    });
+
+    for (const FLogFilter& LogFilter : ClosedFilters)
     {
         if (LogFilter.AsyncWriter)
         {
-            WriteDataToArchive(
-                LogFilter.AsyncWriter,
-                *FString::Printf(TEXT("Log file closed, %s"), FPlatformTime::StrTimestamp()),
-                ELogVerbosity::Display,
-                -1.0f);
+            CloseAsyncWriter(LogFilter.AsyncWriter);
+        }
+    }
 
-            LogFilter.AsyncWriter->Flush();
+    delete IOScheduler;
+    IOScheduler = nullptr;
 
-            delete LogFilter.AsyncWriter;
-            LogFilter.AsyncWriter = nullptr;
-        }
+    // A clean shutdown leaves nothing to recover. No logging thread can reach the recorder any more once the update returned.
+    if (FlightRecorder)
+    {
+        delete FlightRecorder;
+        FlightRecorder = nullptr;
+        IFileManager::Get().Delete(*(CurrentLogDir / FLogFlightRecorder::GetFilename()));
     }
 
-    LogFilters.Empty();
+    FLogRetention::EndSession(CurrentLogDir);
+
+    if (FlightRecorderRecovery.IsValid())
+    {
+        FlightRecorderRecovery.Wait();
+        FlightRecorderRecovery = TFuture<void>();
+    }
+
+    for (const TFuture<void>& RetentionTask : RetentionTasks)
+    {
+        RetentionTask.Wait();
+    }
+    RetentionTasks.Empty();
+
+    // Waits for the queued segments, the last segment of every file was queued when its writer was closed
+    delete Compressor;
+    Compressor = nullptr;
 }
 
 void FLogManager::Flush()
 {
-    for (auto LogFilter : LogFilters)
+    const FLogFilterRegistry::FReadScope Table(Filters);
+    for (const FLogFilter& LogFilter : Table->Filters)
     {
         if (LogFilter.AsyncWriter)
         {
@@ -238,33 +781,84 @@ void FLogManager::Serialize(const TCHAR* Data, ELogVerbosity::Type Verbosity,
     {
         if (Verbosity != ELogVerbosity::SetColor)
         {
-            FLogFilter LogFilter{ Category.ToString(), nullptr, ELogVerbosity::All };
-            int32 FoundIndex = INDEX_NONE;
+            // One pointer load, the table and its writers stay alive until the scope ends
+            const FLogFilterRegistry::FReadScope Table(Filters);
+
+            bool bRecordLine = false;
+            bool bRecorded = false;
+            auto WriteToFilter = [&](int32 FilterIndex)
+            {
+                const FLogFilter& LogFilter = Table->Filters[FilterIndex];
+                FLogAsyncWriter* AsyncWriter = LogFilter.AsyncWriter;
+
+                if (!LogFilter.bEnabled)
+                {
+                    if (AsyncWriter)
+                    {
+                        AsyncWriter->CountDisabledLine();
+                    }
+                    return;
+                }
 
-            FLogAsyncWriter* AsyncWriter = nullptr;
-			ELogVerbosity::Type FlushOn = ELogVerbosity::Warning;
-            bool bUseCategory = false;
+                const FName PrintedCategory = LogFilter.bSingleCategory ? NAME_None : Category;
+
+                // Storm control runs before anything is formatted, the writer reports the lines it holds back or rejects
+                if (AsyncWriter && AsyncWriter->CoalesceRepeat(Data, Verbosity, Category, PrintedCategory))
+                {
+                    return;
+                }
 
-            if (LogFilters.Find(LogFilter, FoundIndex))
+                // Once however many files the line fans out to. Repeats would flush the context out of the ring,
+                // lines rejected by the rate limit or sampled out are context like any other.
+                bRecordLine = Table->FlightRecorder != nullptr;
+
+                if (AsyncWriter && !AsyncWriter->AdmitLine())
+                {
+                    return;
+                }
+
+                if (AsyncWriter)
+                {
+                    // A writer encoding the line as the recorder would hands it the bytes, nothing is encoded twice
+                    FLogFlightRecorder* Recorder = bRecordLine && !bRecorded && PrintedCategory == Category ? Table->FlightRecorder : nullptr;
+                    bRecorded |= WriteDataToArchive(AsyncWriter, Data, Verbosity, Time, PrintedCategory, Recorder);
+
+                    if (Verbosity <= LogFilter.FlushOn)
+                    {
+                        // A crashing process may not get another chance, make sure the line is on disk
+                        if (bSyncFlushOnLevel || GIsCriticalError)
+                        {
+                            AsyncWriter->Flush();
+                        }
+                        else
+                        {
+                            AsyncWriter->RequestFlush(FPlatformAtomics::InterlockedIncrement(&FlushTicketCounter));
+                        }
+                    }
+                }
+            };
+
+            // Rules are matched once per category, after that this hashes the FName indices only
+            const uint64 Route = Table->GetRoute(Category);
+            const uint64 CachedFilters = Route & ~FLogFilterTable::UncachedFiltersBit;
+            for (int32 FilterIndex = 0; (CachedFilters >> FilterIndex) != 0; ++FilterIndex)
             {
-                AsyncWriter = LogFilters[FoundIndex].AsyncWriter;
-				FlushOn = LogFilters[FoundIndex].FlushOn;
+                if ((CachedFilters >> FilterIndex) & 1)
+                {
+                    WriteToFilter(FilterIndex);
+                }
             }
-            else if (LogFilters.Num() > 0)
+
+            // Filters past the ones the route has a bit for, matched again for every line
+            if (Route & FLogFilterTable::UncachedFiltersBit)
             {
-                AsyncWriter = LogFilters[0].AsyncWriter;
-				FlushOn = LogFilters[0].FlushOn;
-                bUseCategory = true;
+                Table->ForEachUncachedFilter(Category, WriteToFilter);
             }
 
-            if (AsyncWriter)
+            // No writer encoded the line for the recorder
+            if (bRecordLine && !bRecorded)
             {
-                WriteDataToArchive(AsyncWriter, Data, Verbosity, Time, bUseCategory ? Category : NAME_None);
-
-                if (Verbosity <= FlushOn)
-                {
-                    AsyncWriter->Flush();
-                }
+                Table->FlightRecorder->RecordLine(Verbosity, Category, Data, FLogTimestampCache::NowTicks(), GFrameCounter, bAutoEmitLineTerminator);
             }
         }
     }
@@ -298,81 +892,49 @@ void FLogManager::WriteByteOrderMarkToArchive(FLogAsyncWriter* AsyncWriter, EByt
     }
 }
 
-void FLogManager::CastAndSerializeData(FLogAsyncWriter* AsyncWriter, const TCHAR* Data)
+bool FLogManager::WriteDataToArchive(FLogAsyncWriter* AsyncWriter, const TCHAR* Data,
+    ELogVerbosity::Type Verbosity, const double Time, const class FName& Category, FLogFlightRecorder* Recorder)
 {
     if (AsyncWriter)
     {
-        FTCHARToUTF8 ConvertedData(Data);
-        AsyncWriter->Serialize((uint8*)(ConvertedData.Get()), ConvertedData.Length() * sizeof(ANSICHAR));
+        return AsyncWriter->SerializeLine(Data, Verbosity, Category, Time, bAutoEmitLineTerminator, Recorder);
     }
+    return false;
 }
 
-FString FLogManager::FormatLogLine(ELogVerbosity::Type Verbosity, const class FName& Category, const TCHAR* Message /*= nullptr*/, ELogTimes::Type LogTime /*= ELogTimes::None*/, const double Time /*= -1.0*/)
+FLogAsyncWriter* FLogManager::CreateAsyncWriter(const FString& Filename, bool bBinary)
 {
-    const bool bShowCategory = GPrintLogCategory && Category != NAME_None;
-
-    FString Format = FString::Printf(TEXT("[%s][%3d]"), *FDateTime::Now().ToString(TEXT("%Y.%m.%d-%H.%M.%S:%s")), GFrameCounter % 1000);
+    FLogWriterSettings Settings = WriterSettings;
+    Settings.bBinary = bBinary;
 
-    if (bShowCategory)
+    // Every text segment after the first starts with the byte order mark the first one gets below,
+    // binary segments start with the header the writer puts in front of their first record
+    TArray<uint8> SegmentHeader;
+    if (!bBinary)
     {
-        if (Verbosity != ELogVerbosity::Log)
-        {
-            Format += Category.ToString();
-            Format += TEXT(":");
-            Format += FOutputDeviceHelper::VerbosityToString(Verbosity);
-            Format += TEXT(": ");
-        }
-        else
-        {
-            Format += Category.ToString();
-            Format += TEXT(": ");
-        }
-    }
-    else
-    {
-        if (Verbosity != ELogVerbosity::Log)
-        {
-#if !HACK_HEADER_GENERATOR
-            Format += FOutputDeviceHelper::VerbosityToString(Verbosity);
-            Format += TEXT(": ");
-#endif
-        }
+        SegmentHeader.Append(UTF8BOM, ARRAY_COUNT(UTF8BOM));
     }
 
-    if (Message)
-    {
-        Format += Message;
-    }
-
-    return Format;
-}
-
-void FLogManager::WriteDataToArchive(FLogAsyncWriter* AsyncWriter, const TCHAR* Data,
-    ELogVerbosity::Type Verbosity, const double Time, const class FName& Category)
-{
-#if PLATFORM_LINUX
-    const FString Message = FString::Printf(TEXT("%s%s"), Data, bAutoEmitLineTerminator ? TEXT("\r\n") : TEXT(""));
-#else
-    const FString Message = FString::Printf(TEXT("%s%s"), Data, bAutoEmitLineTerminator ? LINE_TERMINATOR : TEXT(""));
-#endif // PLATFORM_LINUX
-
-    const FString LogLine = FormatLogLine(Verbosity, Category, *Message, GPrintLogTimes, Time);
-    CastAndSerializeData(AsyncWriter, *LogLine);
-}
-
-FLogAsyncWriter* FLogManager::CreateAsyncWriter(const FString& Filename)
-{
     // Open log file.
-    FArchive* Ar = IFileManager::Get().CreateFileWriter(*Filename, FILEWRITE_AllowRead);
+    FLogRotatingArchive* Ar = new FLogRotatingArchive(Filename, Settings, SegmentHeader, Compressor);
+
+    // The engine's own log device carries on in the last text segment of the default file on shutdown, see ShutdownModule
+    Ar->SetCompressLastSegment(Filename != DefaultLogFilename);
     FLogAsyncWriter* AsyncWriter = nullptr;
 
+    if (!Ar->Open())
+    {
+        delete Ar;
+        Ar = nullptr;
+    }
+
     if (Ar)
     {
-        AsyncWriter = new FLogAsyncWriter(*Ar);
+        AsyncWriter = new FLogAsyncWriter(Ar, IOScheduler, Settings);
 
         if (AsyncWriter)
         {
-            WriteByteOrderMarkToArchive(AsyncWriter, EByteOrderMark::UTF8);
+            WriteByteOrderMarkToArchive(AsyncWriter, bBinary ? EByteOrderMark::Unspecified : EByteOrderMark::UTF8);
             WriteDataToArchive(
                 AsyncWriter,
                 *FString::Printf(TEXT("Log file open, %s"), FPlatformTime::StrTimestamp()),
@@ -383,3 +945,136 @@ FLogAsyncWriter* FLogManager::CreateAsyncWriter(const FString& Filename)
 
     return AsyncWriter;
 }
+
+FLogAsyncWriter* FLogManager::CreateFilterWriter(const FString& Category)
+{
+    const bool bBinary = IsBinaryCategory(Category);
+    const FString Filename = FString::Printf(TEXT("%s/%s%s"), *CurrentLogDir, *Category,
+        bBinary ? FLogBinaryFormat::GetExtension() : TEXT(".log"));
+
+    FLogAsyncWriter* AsyncWriter = CreateAsyncWriter(Filename, bBinary);
+    ApplyCommandLineLimits(Category, AsyncWriter);
+
+    return AsyncWriter;
+}
+
+void FLogManager::CloseAsyncWriter(FLogAsyncWriter* AsyncWriter)
+{
+    AsyncWriter->QueueHeldRepeats();
+    WriteDataToArchive(
+        AsyncWriter,
+        *FString::Printf(TEXT("Log file closed, %s"), FPlatformTime::StrTimestamp()),
+        ELogVerbosity::Display,
+        -1.0f);
+
+    AsyncWriter->Flush();
+
+    delete AsyncWriter;
+}
+
+/** Dumps the telemetry of every log file, e.g. "LogManager.Stats" */
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogStatsCommand(
+    TEXT("LogManager.Stats"),
+    TEXT("Dumps lines, bytes, queue occupancy, stalls, flushes and dropped lines of every log file. Usage: LogManager.Stats"),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+    {
+        TArray<FLogWriterStats> WriterStats;
+        ILogManager::Get().GetWriterStats(WriterStats);
+
+        for (const FLogWriterStats& Stats : WriterStats)
+        {
+            Ar.Logf(TEXT("%s (%s)"), Stats.Category.IsEmpty() ? TEXT("<default>") : *Stats.Category, *Stats.Filename);
+            Ar.Logf(TEXT("  %lld lines, %.1f KB written, peak queue %lld of %lld bytes, %lld buffer resizes, %lld records spilled over"),
+                Stats.LinesWritten, Stats.BytesWritten / 1024.0, Stats.PeakBufferOccupancy, Stats.BufferCapacity, Stats.BufferResizes, Stats.OverflowRecords);
+            Ar.Logf(TEXT("  %lld flush stalls in %.2f ms, %lld full queue waits in %.2f ms, %lld archive flushes in %.2f ms (max %.2f ms)"),
+                Stats.FlushStalls, Stats.FlushStallSeconds * 1000.0, Stats.FullBufferWaits, Stats.FullBufferWaitSeconds * 1000.0,
+                Stats.ArchiveFlushes, Stats.ArchiveFlushSeconds * 1000.0, Stats.MaxArchiveFlushSeconds * 1000.0);
+            Ar.Logf(TEXT("  %lld lines dropped, %lld rejected by the rate limit, %lld sampled out, %lld dropped while disabled"),
+                Stats.DroppedLines, Stats.RejectedLines, Stats.SampledOutLines, Stats.DisabledLines);
+        }
+    }));
+
+/** Filters changed at runtime, e.g. "LogManager.AddFilter LogNet Error" or "LogManager.DisableFilter LogNet" */
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogAddFilterCommand(
+    TEXT("LogManager.AddFilter"),
+    TEXT("Writes a category to its own log file. Usage: LogManager.AddFilter <Category> [FlushOnVerbosity]"),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+    {
+        if (Args.Num() < 1)
+        {
+            Ar.Log(TEXT("Usage: LogManager.AddFilter <Category> [FlushOnVerbosity]"));
+            return;
+        }
+
+        const ELogVerbosity::Type FlushOn = Args.Num() > 1 ? ParseLogVerbosityFromString(Args[1]) : ELogVerbosity::Warning;
+        ILogManager::Get().AddFilter(Args[0], FlushOn);
+        Ar.Logf(TEXT("Filter %s flushes on %s"), *Args[0], ToString(FlushOn));
+    }));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogAddRouteCommand(
+    TEXT("LogManager.AddRoute"),
+    TEXT("Writes every category matching a pattern to one or more log files. Usage: LogManager.AddRoute <Pattern> <Sink>[,<Sink>...] [FlushOnVerbosity]"),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+    {
+        if (Args.Num() < 2)
+        {
+            Ar.Log(TEXT("Usage: LogManager.AddRoute <Pattern> <Sink>[,<Sink>...] [FlushOnVerbosity]"));
+            return;
+        }
+
+        TArray<FString> Sinks;
+        Args[1].ParseIntoArray(Sinks, TEXT(","), true);
+        const ELogVerbosity::Type FlushOn = Args.Num() > 2 ? ParseLogVerbosityFromString(Args[2]) : ELogVerbosity::Warning;
+        ILogManager::Get().AddRoute(Args[0], Sinks, FlushOn);
+        Ar.Logf(TEXT("Categories matching %s routed to %s"), *Args[0], *FString::Join(Sinks, TEXT(", ")));
+    }));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogRemoveRouteCommand(
+    TEXT("LogManager.RemoveRoute"),
+    TEXT("Removes the routing rules of a pattern. Usage: LogManager.RemoveRoute <Pattern>"),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+    {
+        if (Args.Num() < 1)
+        {
+            Ar.Log(TEXT("Usage: LogManager.RemoveRoute <Pattern>"));
+            return;
+        }
+
+        ILogManager::Get().RemoveRoute(Args[0]);
+        Ar.Logf(TEXT("Routes of %s removed"), *Args[0]);
+    }));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogRemoveFilterCommand(
+    TEXT("LogManager.RemoveFilter"),
+    TEXT("Closes a category's log file, its lines go to the default log file again. Usage: LogManager.RemoveFilter <Category>"),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+    {
+        if (Args.Num() < 1)
+        {
+            Ar.Log(TEXT("Usage: LogManager.RemoveFilter <Category>"));
+            return;
+        }
+
+        ILogManager::Get().RemoveFilter(Args[0]);
+        Ar.Logf(TEXT("Filter %s removed"), *Args[0]);
+    }));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogEnableFilterCommand(
+    TEXT("LogManager.EnableFilter"),
+    TEXT("Writes a disabled category's lines again, no category for the default log file. Usage: LogManager.EnableFilter [Category]"),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+    {
+        const FString Category = Args.Num() > 0 ? Args[0] : FString();
+        ILogManager::Get().EnableFilter(Category);
+        Ar.Logf(TEXT("Filter %s enabled"), Category.IsEmpty() ? TEXT("<default>") : *Category);
+    }));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogDisableFilterCommand(
+    TEXT("LogManager.DisableFilter"),
+    TEXT("Drops a category's lines until it is enabled again, no category for the default log file. Usage: LogManager.DisableFilter [Category]"),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+    {
+        const FString Category = Args.Num() > 0 ? Args[0] : FString();
+        ILogManager::Get().DisableFilter(Category);
+        Ar.Logf(TEXT("Filter %s disabled"), Category.IsEmpty() ? TEXT("<default>") : *Category);
+    }));
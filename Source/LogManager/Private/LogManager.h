@@ -30,6 +30,28 @@ public:
 	 */
 	virtual void ChangeLogFlushOnLevel(const FString& Category, ELogVerbosity::Type FlushOn) override;
 
+	/**
+	 * @brief Change what a log category's file does with new lines when its queue is full.
+	 * @param Category - category name, empty for the default log file
+	 * @param Policy - backpressure policy
+	 */
+	virtual void SetBackpressurePolicy(const FString& Category, ELogBackpressure::Type Policy) override;
+
+	/**
+	 * @brief Limit the rate of lines written to a log category's file.
+	 * @param Category - category name, empty for the default log file
+	 * @param LinesPerSecond - sustained rate, 0 to remove the limit
+	 * @param Burst - lines allowed back to back after a quiet period
+	 */
+	virtual void SetRateLimit(const FString& Category, float LinesPerSecond, int32 Burst) override;
+
+	/**
+	 * @brief Write only a random share of a log category's lines.
+	 * @param Category - category name, empty for the default log file
+	 * @param KeepRatio - share of the lines kept, 1 keeps every line
+	 */
+	virtual void SetSampling(const FString& Category, float KeepRatio) override;
+
     /**
      * @brief Gets current absolute log directory.
      */
@@ -41,22 +63,65 @@ public:
     virtual void RemainsLogCount(int32 LogFolderCount) override;
 
     /**
-     * @brief Removes a log filter from the list of filters.
-     * @param Category - category name
+     * @brief Deletes the old session log folders the policy doesn't keep, in the background.
      */
-    void RemoveFilter(const FString& Category);
+    virtual void ApplyLogRetention(const FLogRetentionPolicy& Policy) override;
 
     /**
-     * @brief Enable a log filter in the list of filters.
-     * @param Category - category name
+     * @brief Asks every log file to be flushed to disk without waiting for it.
+     * @return ticket to pass to WaitForFlush
      */
-    void EnableFilter(const FString& Category);
+    virtual int64 RequestFlush() override;
 
     /**
-     * @brief Disable a log filter in the list of filters.
-     * @param Category - category name
+     * @brief Waits until the flush identified by Ticket, and every flush requested before it, is on disk.
+     */
+    virtual bool WaitForFlush(int64 Ticket, uint32 WaitTimeMs = MAX_uint32) override;
+
+    /**
+     * @brief Gets the counters of every open log file.
      */
-    void DisableFilter(const FString& Category);
+    virtual void GetWriterStats(TArray<FLogWriterStats>& OutStats) const override;
+
+    /**
+     * @brief Turns a binary log file back into a text log file.
+     */
+    virtual bool DecodeBinaryLog(const FString& BinaryFilename, const FString& TextFilename) override;
+
+    /**
+     * @brief Writes the lines kept by a flight recorder file to a text log file.
+     */
+    virtual bool RecoverFlightRecorder(const FString& RecorderFilename, const FString& TextFilename) override;
+
+    /**
+     * @brief Finds the parts of a text log file that may hold lines matching a query.
+     */
+    virtual bool QueryLogIndex(const FString& LogFilename, const FLogIndexQuery& Query, TArray<FLogFileRange>& OutRanges) const override;
+
+    /**
+     * @brief Routes every category matching a pattern to one or more log files.
+     */
+    virtual void AddRoute(const FString& Pattern, const TArray<FString>& Sinks, ELogVerbosity::Type FlushOn) override;
+
+    /**
+     * @brief Removes the routing rules of a pattern.
+     */
+    virtual void RemoveRoute(const FString& Pattern) override;
+
+    /**
+     * @brief Removes a log filter, its category goes back to the default log file.
+     */
+    virtual void RemoveFilter(const FString& Category) override;
+
+    /**
+     * @brief Lets a log filter write its category's lines again.
+     */
+    virtual void EnableFilter(const FString& Category) override;
+
+    /**
+     * @brief Drops a log filter's lines until it is enabled again.
+     */
+    virtual void DisableFilter(const FString& Category) override;
 
     //~ Begin FOutputDevice Interface.
     /**
@@ -85,29 +150,101 @@ public:
 protected:
     void WriteByteOrderMarkToArchive(FLogAsyncWriter* AsyncWriter, EByteOrderMark ByteOrderMark);
 
-    void CastAndSerializeData(FLogAsyncWriter* AsyncWriter, const TCHAR* Data);
+    /** Queues a line, copying it to Recorder as encoded if given. Returns true if Recorder got the line. */
+    bool WriteDataToArchive(FLogAsyncWriter* AsyncWriter, const TCHAR* Data,
+        ELogVerbosity::Type Verbosity, const double Time, const class FName& Category = TEXT(""), FLogFlightRecorder* Recorder = nullptr);
 
-    static FString FormatLogLine(ELogVerbosity::Type Verbosity, const class FName& Category, const TCHAR* Message = nullptr, ELogTimes::Type LogTime = ELogTimes::None, const double Time = -1.0);
+    FLogAsyncWriter* CreateAsyncWriter(const FString& Filename, bool bBinary);
 
-    void WriteDataToArchive(FLogAsyncWriter* AsyncWriter, const TCHAR* Data,
-        ELogVerbosity::Type Verbosity, const double Time, const class FName& Category = TEXT(""));
+    /** Opens the log file of the filter named Category */
+    FLogAsyncWriter* CreateFilterWriter(const FString& Category);
 
-    FLogAsyncWriter* CreateAsyncWriter(const FString& Filename);
+    /** Writes the closing line of a log file, flushes it and deletes the writer */
+    void CloseAsyncWriter(FLogAsyncWriter* AsyncWriter);
+
+    /** Writer of Category's log file in Table, empty for the default one, nullptr if there's no such filter */
+    static FLogAsyncWriter* FindFilterWriter(const FLogFilterTable& Table, const FString& Category);
+
+    /** Turns the filter of Category, empty for the default log file, on or off */
+    void SetFilterEnabled(const FString& Category, bool bEnabled);
+
+    /** Applies the -LOGRATELIMIT and -LOGSAMPLE settings of Category, empty for the default log file, to its writer */
+    void ApplyCommandLineLimits(const FString& Category, FLogAsyncWriter* AsyncWriter);
+
+    /** Whether the log file of Category, empty for the default one, is written in the binary format */
+    bool IsBinaryCategory(const FString& Category) const;
+
+#if STATS
+    /** Publishes the telemetry of every log file to STATGROUP_LogManager, once a frame while the group is shown */
+    bool UpdateStats(float DeltaTime);
+
+    /** Sums the counters of every log file, PeakOccupancy is the fullest queue in percent */
+    void GetStatsTotals(FLogWriterStats& OutTotals, double& OutPeakOccupancy) const;
+
+    /** Registers UpdateStats when "stat LogManager" turns the group on */
+    void OnStatEnabled(const TCHAR* StatName);
+    /** Unregisters UpdateStats when the group is turned off */
+    void OnStatDisabled(const TCHAR* StatName);
+    void OnStatDisableAll(const bool bInAnyViewport);
+    void StopStatsTicker();
+#endif // STATS
 
 private:
-    struct FLogFilter
-    {
-        FString Category;
-        FLogAsyncWriter* AsyncWriter;
-		ELogVerbosity::Type FlushOn;
+    /** Shared I/O threads writing every log file, nullptr if the platform doesn't support multithreading */
+    FLogIOScheduler* IOScheduler;
+
+    /** Compresses rotated out log segments, nullptr unless -LOGCOMPRESS is set */
+    FLogCompressor* Compressor;
 
-        friend bool operator==(const FLogFilter& Lhs, const FLogFilter& Rhs)
+    /**
+     * Keeps the last lines of every category in a crash-surviving file mapping, nullptr if -LOGFLIGHTRECORDER=0 or unsupported.
+     * Owned here, logging threads only reach it through the filter table so TearDown can delete it safely.
+     */
+    FLogFlightRecorder* FlightRecorder;
+    /** Recovers the flight recorders of crashed sessions at startup */
+    TFuture<void> FlightRecorderRecovery;
+    /** Retention runs started by RemainsLogCount and ApplyLogRetention, finished ones are forgotten when a new one starts */
+    TArray<TFuture<void>> RetentionTasks;
+
+    /** Flush tickets handed out so far */
+    volatile int64 FlushTicketCounter;
+    /** Whether reaching a filter's FlushOn level blocks until the file is flushed (-LOGSYNCFLUSH, -FORCELOGFLUSH) */
+    bool bSyncFlushOnLevel;
+    /** Queueing limits of new writers */
+    FLogWriterSettings WriterSettings;
+    /** Categories written as binary log files (-LOGBINARY=Cat1+Cat2) */
+    TArray<FString> BinaryCategories;
+    /** Whether every log file is written in the binary format (-LOGBINARY) */
+    bool bBinaryLogs;
+
+    struct FLineLimits
+    {
+        float LinesPerSecond;
+        int32 Burst;
+        float KeepRatio;
+
+        FLineLimits()
+            : LinesPerSecond(0.0f)
+            , Burst(0)
+            , KeepRatio(1.0f)
         {
-            return Lhs.Category.Equals(Rhs.Category, ESearchCase::IgnoreCase);
         }
     };
+    /** Rate limits and sampling by category, the empty category is the default log file (-LOGRATELIMIT=Cat:Lines:Burst+..., -LOGSAMPLE=Cat:Ratio+...) */
+    TMap<FString, FLineLimits> CommandLineLimits;
 
     FString CurrentLogDir;
     FString DefaultLogFilename;
-    TArray<FLogFilter> LogFilters;
+    /** Log files by category, read by every logging thread without locks */
+    FLogFilterRegistry Filters;
+
+#if STATS
+    /** Only valid while STATGROUP_LogManager is enabled, nothing is gathered the rest of the time */
+    FDelegateHandle StatsTickerHandle;
+    FDelegateHandle StatEnabledHandle;
+    FDelegateHandle StatDisabledHandle;
+    FDelegateHandle StatDisableAllHandle;
+    /** Totals of the previous frame, the stats show the difference */
+    FLogWriterStats LastStatsTotals;
+#endif // STATS
 };
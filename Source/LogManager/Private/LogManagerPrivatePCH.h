@@ -5,5 +5,15 @@
 // You should place include statements to your module's private header files here.  You only need to
 // add includes for headers that are used in most of your module's source files though.
 
+#include "LogBenchmark.h"
+#include "LogBinaryFormat.h"
+#include "LogCompressor.h"
+#include "LogFilterRegistry.h"
+#include "LogFlightRecorder.h"
+#include "LogIndexFormat.h"
+#include "LogMappedFile.h"
+#include "LogRetention.h"
+#include "LogSearch.h"
+#include "LogVectoredFile.h"
 #include "LogAsyncWriter.hpp"
 #include "LogManager.h"
\ No newline at end of file
@@ -0,0 +1,442 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#include "LogManagerPrivatePCH.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Paths.h"
+#include "Templates/UniquePtr.h"
+
+#if LOGMANAGER_WITH_MMAP
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#elif PLATFORM_WINDOWS
+    #include "Windows/WindowsHWrapper.h"
+#endif // LOGMANAGER_WITH_MMAP
+
+#if LOGMANAGER_WITH_MMAP
+
+bool FLogMappedFileArchive::ReserveFileRange(int32 FileHandle, int64 Offset, int64 Size)
+{
+#if PLATFORM_MAC
+    fstore_t Store = { F_ALLOCATEALL, F_PEOFPOSMODE, 0, 0, 0 };
+    struct stat FileStat;
+    if (fstat(FileHandle, &FileStat) != 0)
+    {
+        return false;
+    }
+    Store.fst_length = Offset + Size - FileStat.st_size;
+    if (Store.fst_length > 0 && fcntl(FileHandle, F_PREALLOCATE, &Store) == -1)
+    {
+        return false;
+    }
+    return ftruncate(FileHandle, Offset + Size) == 0;
+#else
+    // Returns the error instead of setting errno
+    return posix_fallocate(FileHandle, Offset, Size) == 0;
+#endif // PLATFORM_MAC
+}
+
+FLogMappedFileArchive* FLogMappedFileArchive::Create(const FString& Filename)
+{
+    IFileManager::Get().MakeDirectory(*FPaths::GetPath(Filename), true);
+
+    const FString AbsoluteFilename = IFileManager::Get().ConvertToAbsolutePathForExternalAppForWrite(*Filename);
+    const int32 FileHandle = open(TCHAR_TO_UTF8(*AbsoluteFilename), O_CREAT | O_RDWR | O_TRUNC | O_CLOEXEC, 0644);
+    if (FileHandle < 0)
+    {
+        return nullptr;
+    }
+
+    FLogMappedFileArchive* Archive = new FLogMappedFileArchive(Filename, FileHandle);
+    if (!Archive->MapNextWindow())
+    {
+        delete Archive;
+        return nullptr;
+    }
+    return Archive;
+}
+
+FLogMappedFileArchive::FLogMappedFileArchive(const FString& InFilename, int32 InFileHandle)
+    : Filename(InFilename)
+    , FileHandle(InFileHandle)
+    , Window(nullptr)
+    , WindowOffset(0)
+    , WindowSize(0)
+    , WindowUsed(0)
+    , SyncedOffset(0)
+{
+    ArIsSaving = true;
+}
+
+FLogMappedFileArchive::~FLogMappedFileArchive()
+{
+    Close();
+}
+
+bool FLogMappedFileArchive::MapNextWindow()
+{
+    const int64 NextOffset = WindowOffset + WindowSize;
+    const int64 NextSize = WindowSize == 0 ? (int64)InitialWindowSize : FMath::Min<int64>(WindowSize * 2, MaxWindowSize);
+
+    if (Window)
+    {
+        // Pages of a shared mapping stay in the page cache once unmapped, the kernel still writes them back
+        munmap(Window, WindowSize);
+        Window = nullptr;
+    }
+
+    if (!ReserveFileRange(FileHandle, NextOffset, NextSize))
+    {
+        return false;
+    }
+
+    void* Mapping = mmap(nullptr, NextSize, PROT_READ | PROT_WRITE, MAP_SHARED, FileHandle, NextOffset);
+    if (Mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    Window = (uint8*)Mapping;
+    WindowOffset = NextOffset;
+    WindowSize = NextSize;
+    WindowUsed = 0;
+    return true;
+}
+
+void FLogMappedFileArchive::Serialize(void* Data, int64 Length)
+{
+    const uint8* Source = (const uint8*)Data;
+    while (Length > 0)
+    {
+        if (WindowUsed == WindowSize && !MapNextWindow())
+        {
+            ArIsError = true;
+            return;
+        }
+
+        const int64 Copied = FMath::Min(Length, WindowSize - WindowUsed);
+        FMemory::Memcpy(Window + WindowUsed, Source, Copied);
+        WindowUsed += Copied;
+        Source += Copied;
+        Length -= Copied;
+    }
+}
+
+void FLogMappedFileArchive::Flush()
+{
+    if (!Window || SyncedOffset == Tell())
+    {
+        return;
+    }
+
+    if (SyncedOffset < WindowOffset)
+    {
+        // Part of the unsynced data lives in windows that are unmapped by now
+        fdatasync(FileHandle);
+    }
+    else
+    {
+        const int64 PageSize = sysconf(_SC_PAGESIZE);
+        const int64 SyncStart = (SyncedOffset - WindowOffset) / PageSize * PageSize;
+        msync(Window + SyncStart, WindowUsed - SyncStart, MS_SYNC);
+    }
+    SyncedOffset = Tell();
+}
+
+bool FLogMappedFileArchive::Close()
+{
+    if (FileHandle >= 0)
+    {
+        const int64 FileSize = Tell();
+        if (Window)
+        {
+            munmap(Window, WindowSize);
+            Window = nullptr;
+        }
+
+        // Drop the unused rest of the last window
+        if (ftruncate(FileHandle, FileSize) != 0)
+        {
+            ArIsError = true;
+        }
+        close(FileHandle);
+        FileHandle = -1;
+    }
+    return !ArIsError;
+}
+
+int64 FLogMappedFileArchive::Tell()
+{
+    return WindowOffset + WindowUsed;
+}
+
+int64 FLogMappedFileArchive::TotalSize()
+{
+    return Tell();
+}
+
+FString FLogMappedFileArchive::GetArchiveName() const
+{
+    return Filename;
+}
+
+/** Compares the log file backends on log sized writes, e.g. "LogManager.MappedFileBenchmark 256" for 256MB */
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogMappedFileBenchmarkCommand(
+    TEXT("LogManager.MappedFileBenchmark"),
+    TEXT("Measures log file throughput and per line latency of the file writer, pwritev batches and the mapped file. Usage: LogManager.MappedFileBenchmark [MB]"),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+    {
+        const int32 SizeMB = Args.Num() > 0 ? FMath::Clamp(FCString::Atoi(*Args[0]), 1, 4096) : 256;
+        const int64 Size = (int64)SizeMB * 1024 * 1024;
+
+        const FString Line = TEXT("[2017.01.01-12.00.00:000][  0]LogNet: Warning: Actor 1234 replicated 56 properties in 0.789 ms\r\n");
+        FTCHARToUTF8 Utf8Line(*Line);
+        const int32 NumLines = (int32)(Size / Utf8Line.Length());
+
+        auto RunBenchmark = [&](const TCHAR* Name, FArchive* Writer)
+        {
+            if (!Writer)
+            {
+                Ar.Logf(TEXT("  %-8s failed to open the file"), Name);
+                return;
+            }
+
+            TArray<uint32> LineCycles;
+            LineCycles.AddUninitialized(NumLines);
+
+            const double StartTime = FPlatformTime::Seconds();
+            for (int32 LineIndex = 0; LineIndex < NumLines; ++LineIndex)
+            {
+                const uint32 StartCycles = FPlatformTime::Cycles();
+                Writer->Serialize((void*)Utf8Line.Get(), Utf8Line.Length());
+                LineCycles[LineIndex] = FPlatformTime::Cycles() - StartCycles;
+            }
+            Writer->Flush();
+            delete Writer;
+            const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+            LineCycles.Sort();
+            const double MB = 1024.0 * 1024.0;
+            Ar.Logf(TEXT("  %-8s %.1f MB/s, %.0f lines/s, p50 %.2f us, p99 %.2f us, max %.2f us"), Name,
+                NumLines * Utf8Line.Length() / MB / Seconds, NumLines / Seconds,
+                FPlatformTime::ToMilliseconds(LineCycles[NumLines / 2]) * 1000.0,
+                FPlatformTime::ToMilliseconds(LineCycles[NumLines * 99 / 100]) * 1000.0,
+                FPlatformTime::ToMilliseconds(LineCycles.Last()) * 1000.0);
+        };
+
+        const FString Filename = FPaths::CreateTempFilename(*FPaths::GameSavedDir(), TEXT("LogBench"), TEXT(".log"));
+
+        Ar.Logf(TEXT("Log file backend benchmark, %d MB in %d lines"), SizeMB, NumLines);
+        RunBenchmark(TEXT("archive:"), IFileManager::Get().CreateFileWriter(*Filename, FILEWRITE_AllowRead));
+        IFileManager::Get().Delete(*Filename);
+#if LOGMANAGER_WITH_PWRITEV
+        RunBenchmark(TEXT("pwritev:"), FLogVectoredFileArchive::Create(Filename));
+        IFileManager::Get().Delete(*Filename);
+#endif // LOGMANAGER_WITH_PWRITEV
+        RunBenchmark(TEXT("mapped:"), FLogMappedFileArchive::Create(Filename));
+        IFileManager::Get().Delete(*Filename);
+    }));
+
+#else
+
+bool FLogMappedFileArchive::ReserveFileRange(int32 FileHandle, int64 Offset, int64 Size)
+{
+    return false;
+}
+
+FLogMappedFileArchive* FLogMappedFileArchive::Create(const FString& Filename)
+{
+    return nullptr;
+}
+
+FLogMappedFileArchive::FLogMappedFileArchive(const FString& InFilename, int32 InFileHandle)
+    : Filename(InFilename)
+    , FileHandle(InFileHandle)
+    , Window(nullptr)
+    , WindowOffset(0)
+    , WindowSize(0)
+    , WindowUsed(0)
+    , SyncedOffset(0)
+{
+}
+
+FLogMappedFileArchive::~FLogMappedFileArchive()
+{
+}
+
+bool FLogMappedFileArchive::MapNextWindow()
+{
+    return false;
+}
+
+void FLogMappedFileArchive::Serialize(void* Data, int64 Length)
+{
+}
+
+void FLogMappedFileArchive::Flush()
+{
+}
+
+bool FLogMappedFileArchive::Close()
+{
+    return false;
+}
+
+int64 FLogMappedFileArchive::Tell()
+{
+    return 0;
+}
+
+int64 FLogMappedFileArchive::TotalSize()
+{
+    return 0;
+}
+
+FString FLogMappedFileArchive::GetArchiveName() const
+{
+    return Filename;
+}
+
+#endif // LOGMANAGER_WITH_MMAP
+
+FLogMappedFileReader::FLogMappedFileReader()
+    : Data(nullptr)
+    , Size(0)
+    , MappedSize(0)
+    , ReadBuffer(nullptr)
+{
+}
+
+FLogMappedFileReader::~FLogMappedFileReader()
+{
+#if LOGMANAGER_WITH_MMAP
+    if (MappedSize > 0)
+    {
+        munmap((void*)Data, MappedSize);
+    }
+#elif PLATFORM_WINDOWS
+    if (MappedSize > 0)
+    {
+        UnmapViewOfFile(Data);
+    }
+#endif // LOGMANAGER_WITH_MMAP
+
+    FMemory::Free(ReadBuffer);
+}
+
+#if LOGMANAGER_WITH_MMAP
+/** Size of FileHandle without the zeroed pages a log still written through FLogMappedFileArchive ends in, read without mapping them */
+static int64 GetWrittenSize(int32 FileHandle, int64 FileSize)
+{
+    uint8 Piece[64 * 1024];
+    int64 End = FileSize;
+    while (End > 0)
+    {
+        const int64 PieceOffset = FMath::Max<int64>(End - sizeof(Piece), 0);
+        const ssize_t BytesRead = pread(FileHandle, Piece, End - PieceOffset, PieceOffset);
+        if (BytesRead != End - PieceOffset)
+        {
+            return -1;
+        }
+
+        for (int64 Index = BytesRead - 1; Index >= 0; --Index)
+        {
+            if (Piece[Index] != 0)
+            {
+                return PieceOffset + Index + 1;
+            }
+        }
+        End = PieceOffset;
+    }
+    return 0;
+}
+#endif // LOGMANAGER_WITH_MMAP
+
+FLogMappedFileReader* FLogMappedFileReader::Open(const FString& Filename)
+{
+    FLogMappedFileReader* Reader = new FLogMappedFileReader();
+
+#if LOGMANAGER_WITH_MMAP
+    const FString AbsoluteFilename = IFileManager::Get().ConvertToAbsolutePathForExternalAppForRead(*Filename);
+    const int32 FileHandle = open(TCHAR_TO_UTF8(*AbsoluteFilename), O_RDONLY | O_CLOEXEC);
+    if (FileHandle >= 0)
+    {
+        // A mapped log still being written is truncated to its written bytes when it's closed, a page of the mapping
+        // past them would fault once it's gone. Only the bytes already written are mapped, the file never shrinks below them.
+        const int64 FileSize = GetWrittenSize(FileHandle, lseek(FileHandle, 0, SEEK_END));
+        void* Mapping = FileSize > 0 ? mmap(nullptr, FileSize, PROT_READ, MAP_SHARED, FileHandle, 0) : MAP_FAILED;
+        close(FileHandle);
+
+        if (Mapping != MAP_FAILED)
+        {
+            // Read front to back once, let the kernel read ahead aggressively
+            madvise(Mapping, FileSize, MADV_SEQUENTIAL);
+            Reader->Data = (const uint8*)Mapping;
+            Reader->Size = FileSize;
+            Reader->MappedSize = FileSize;
+        }
+    }
+#elif PLATFORM_WINDOWS
+    // Shared for writing and deleting, the file may be a log still being written or rotated out
+    const FString AbsoluteFilename = IFileManager::Get().ConvertToAbsolutePathForExternalAppForRead(*Filename);
+    const HANDLE FileHandle = CreateFileW(*AbsoluteFilename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (FileHandle != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER FileSize;
+        if (GetFileSizeEx(FileHandle, &FileSize) && FileSize.QuadPart > 0)
+        {
+            // The view keeps the mapping alive, neither handle is needed once it's there
+            const HANDLE MappingHandle = CreateFileMappingW(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (MappingHandle)
+            {
+                const void* Mapping = MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(MappingHandle);
+
+                if (Mapping)
+                {
+                    Reader->Data = (const uint8*)Mapping;
+                    Reader->Size = FileSize.QuadPart;
+                    Reader->MappedSize = FileSize.QuadPart;
+                }
+            }
+        }
+        CloseHandle(FileHandle);
+    }
+#endif // LOGMANAGER_WITH_MMAP
+
+    if (Reader->MappedSize == 0)
+    {
+        // Read a piece at a time into a buffer of its own, a TArray can't hold a file over 2 GB
+        TUniquePtr<FArchive> FileReader(IFileManager::Get().CreateFileReader(*Filename, FILEREAD_Silent | FILEREAD_AllowWrite));
+        if (!FileReader)
+        {
+            delete Reader;
+            return nullptr;
+        }
+
+        const int64 FileSize = FileReader->TotalSize();
+        Reader->ReadBuffer = (uint8*)FMemory::Malloc(FMath::Max<int64>(FileSize, 1));
+        for (int64 Offset = 0; Offset < FileSize && !FileReader->IsError(); Offset += ReadPieceSize)
+        {
+            FileReader->Serialize(Reader->ReadBuffer + Offset, FMath::Min<int64>(ReadPieceSize, FileSize - Offset));
+        }
+
+        if (FileReader->IsError())
+        {
+            delete Reader;
+            return nullptr;
+        }
+        Reader->Data = Reader->ReadBuffer;
+        Reader->Size = FileSize;
+    }
+
+    while (Reader->Size > 0 && Reader->Data[Reader->Size - 1] == 0)
+    {
+        --Reader->Size;
+    }
+    return Reader;
+}
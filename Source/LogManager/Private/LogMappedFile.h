@@ -0,0 +1,116 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "Containers/Array.h"
+#include "Containers/UnrealString.h"
+#include "Serialization/Archive.h"
+
+#if PLATFORM_LINUX || PLATFORM_MAC
+    #define LOGMANAGER_WITH_MMAP 1
+#else
+    #define LOGMANAGER_WITH_MMAP 0
+#endif
+
+/**
+ * Append only log file written through a shared memory mapping.
+ *
+ * The file is mapped in windows that double in size up to MaxWindowSize. Serialize() is a copy into the
+ * mapping, there is no write buffer and no syscall per call, the kernel writes the pages back on its own.
+ * Flush() is only called when a flush is asked for, so it makes the data durable with msync (or fdatasync
+ * once the unsynced bytes span several windows).
+ *
+ * The file is grown a window at a time and truncated to the bytes written when the archive is closed,
+ * a file left behind by a crash ends with the zeroed rest of its last window. Each window's disk space is
+ * allocated before it's mapped: a full disk fails Create(), and the rotating archive falls back to a file writer, or
+ * fails the archive (IsError) mid-file and the bytes that don't fit are dropped until a window can be allocated.
+ */
+class FLogMappedFileArchive : public FArchive
+{
+public:
+    enum EConstants
+    {
+        InitialWindowSize = 4 * 1024 * 1024,
+        MaxWindowSize = 64 * 1024 * 1024
+    };
+
+    /** Creates Filename and maps its first window, nullptr if the platform or the file doesn't allow it */
+    static FLogMappedFileArchive* Create(const FString& Filename);
+
+    /**
+     * Allocates the disk blocks of [Offset, Offset + Size) of a file opened for writing and grows the file over them.
+     * A sparse range would only be allocated when its pages are written back, and a shared mapping can't report a
+     * full disk but with SIGBUS. False if the space isn't there or the platform has no mapped files.
+     */
+    static bool ReserveFileRange(int32 FileHandle, int64 Offset, int64 Size);
+
+    virtual ~FLogMappedFileArchive();
+
+    //~ Begin FArchive Interface.
+    virtual void Serialize(void* Data, int64 Length) override;
+    /** Syncs the bytes written since the last flush to disk */
+    virtual void Flush() override;
+    virtual bool Close() override;
+    virtual int64 Tell() override;
+    virtual int64 TotalSize() override;
+    virtual FString GetArchiveName() const override;
+    //~ End FArchive Interface
+
+private:
+    FLogMappedFileArchive(const FString& InFilename, int32 InFileHandle);
+
+    /** Unmaps the current window and maps the next one, growing the file, false if the disk space can't be allocated */
+    bool MapNextWindow();
+
+    FString Filename;
+    int32 FileHandle;
+    /** Mapping of the current window, nullptr once closed */
+    uint8* Window;
+    /** File offset and size of the current window */
+    int64 WindowOffset;
+    int64 WindowSize;
+    /** Bytes written to the current window */
+    int64 WindowUsed;
+    /** File offset up to which the data is known to be on disk */
+    int64 SyncedOffset;
+};
+
+/**
+ * Read only view of a whole file, mapped where the platform allows it (mmap, or a file mapping on Windows) and read
+ * into memory otherwise. A log file still being written through FLogMappedFileArchive ends in zeroed pages, they are
+ * left out of the view and never mapped, the writer truncates them away when it closes the file.
+ */
+class FLogMappedFileReader
+{
+    enum EConstants
+    {
+        /** Bytes read at once when the file can't be mapped */
+        ReadPieceSize = 16 * 1024 * 1024
+    };
+
+public:
+    /** Opens Filename, nullptr if it can't be read */
+    static FLogMappedFileReader* Open(const FString& Filename);
+
+    ~FLogMappedFileReader();
+
+    const uint8* GetData() const
+    {
+        return Data;
+    }
+
+    int64 GetSize() const
+    {
+        return Size;
+    }
+
+private:
+    FLogMappedFileReader();
+
+    const uint8* Data;
+    int64 Size;
+    /** Length of the mapping, 0 if the file was read into ReadBuffer */
+    int64 MappedSize;
+    /** Owned copy of the file when it couldn't be mapped, sized by the file and not limited to 2 GB like a TArray */
+    uint8* ReadBuffer;
+};
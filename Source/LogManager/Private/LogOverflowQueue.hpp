@@ -0,0 +1,134 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "HAL/CriticalSection.h"
+#include "HAL/PlatformAtomics.h"
+#include "HAL/UnrealMemory.h"
+#include "Containers/Array.h"
+#include "Misc/ScopeLock.h"
+
+/**
+ * Bounded heap spill-over for records that don't fit into a full ring buffer.
+ *
+ * Producers append under a lock, the writer takes everything at once with Drain(). While the queue holds
+ * records producers keep appending here instead of going back to the ring buffer, so a thread's lines
+ * stay in order. Memory is capped at MaxSize bytes queued plus the array the writer is draining.
+ */
+class FLogOverflowQueue
+{
+    enum EConstants
+    {
+        RecordAlignment = 8
+    };
+
+    struct FRecordHeader
+    {
+        int32 Length;
+        int32 Padding;
+    };
+
+public:
+    explicit FLogOverflowQueue(int32 InMaxSize)
+        : MaxSize(InMaxSize)
+        , DrainCount(0)
+        , bActive(0)
+    {
+    }
+
+    /** Whether producers should append here instead of using the ring buffer */
+    bool IsActive() const
+    {
+        return bActive != 0;
+    }
+
+    /**
+     * [PRODUCER] Appends a record whose payload is written by Fill(uint8* Dest), which returns the number of bytes written
+     * @return false if the record would take the queue over its size cap
+     */
+    template<typename FillerType>
+    bool AppendWith(int64 MaxLength, FillerType&& Fill)
+    {
+        FScopeLock RecordsLock(&RecordsCritical);
+
+        const int32 Offset = Records.Num();
+        if (Offset + GetRecordSpan(MaxLength) > MaxSize)
+        {
+            return false;
+        }
+
+        Records.AddUninitialized(GetRecordSpan(MaxLength));
+        FRecordHeader* Header = (FRecordHeader*)(Records.GetData() + Offset);
+        Header->Length = Fill((uint8*)(Header + 1));
+        Header->Padding = 0;
+        Records.SetNum(Offset + GetRecordSpan(Header->Length), false);
+
+        FPlatformAtomics::InterlockedExchange(&bActive, 1);
+        return true;
+    }
+
+    /**
+     * [PRODUCER] Drain count a flush has to wait for to be sure everything appended so far has been drained
+     */
+    int32 GetDrainTarget()
+    {
+        FScopeLock RecordsLock(&RecordsCritical);
+        return Records.Num() > 0 ? DrainCount + 1 : DrainCount;
+    }
+
+    /** [CONSUMER] Number of drains that took records so far */
+    int32 GetDrainCount() const
+    {
+        return DrainCount;
+    }
+
+    /**
+     * [CONSUMER] Takes every queued record. OutRecords is swapped with the queue so both allocations are reused.
+     * @return false if there were no records
+     */
+    bool Drain(TArray<uint8>& OutRecords)
+    {
+        OutRecords.Reset();
+
+        FScopeLock RecordsLock(&RecordsCritical);
+        if (Records.Num() == 0)
+        {
+            return false;
+        }
+
+        Exchange(Records, OutRecords);
+        FPlatformAtomics::InterlockedExchange(&bActive, 0);
+        FPlatformAtomics::InterlockedIncrement(&DrainCount);
+        return true;
+    }
+
+    /** Calls Visitor(const uint8* Data, int32 Length) for every record in Source, as returned by Drain() */
+    template<typename VisitorType>
+    static void ForEachRecord(const TArray<uint8>& Source, VisitorType&& Visitor)
+    {
+        int32 Offset = 0;
+        while (Offset < Source.Num())
+        {
+            const FRecordHeader* Header = (const FRecordHeader*)(Source.GetData() + Offset);
+            Visitor((const uint8*)(Header + 1), Header->Length);
+            Offset += GetRecordSpan(Header->Length);
+        }
+    }
+
+private:
+    static int32 GetRecordSpan(int64 Length)
+    {
+        return (int32)((sizeof(FRecordHeader) + Length + RecordAlignment - 1) & ~(int64)(RecordAlignment - 1));
+    }
+
+    /** Most bytes the queued records may take */
+    const int32 MaxSize;
+    /** Queued records, guarded by RecordsCritical */
+    TArray<uint8> Records;
+    /** Sync object for the Records array */
+    FCriticalSection RecordsCritical;
+    /** Number of drains that took records */
+    volatile int32 DrainCount;
+    /** Set while Records isn't empty */
+    volatile int32 bActive;
+};
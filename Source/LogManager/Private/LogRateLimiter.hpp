@@ -0,0 +1,143 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "HAL/PlatformAtomics.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/ThreadSingleton.h"
+
+/**
+ * Rate limit and sampling of the lines of one log file, checked before a line is formatted.
+ *
+ * The rate limit is a token bucket kept as a GCRA (generic cell rate algorithm): a single theoretical arrival
+ * time in cycles, pushed forward by one emission interval per admitted line with one compare-and-swap. A line is
+ * rejected when admitting it would put the arrival time more than the burst tolerance ahead of now. Sampling keeps
+ * a line with a fixed probability, drawn from a per-thread xorshift generator. With neither set up, Admit() is two
+ * loads and two branches.
+ */
+class FLogRateLimiter
+{
+    /** Per-thread state of the sampling generator */
+    struct FSampleState : public TThreadSingleton<FSampleState>
+    {
+        FSampleState()
+            : Random((uint32)FPlatformTime::Cycles() | 1)
+        {
+        }
+
+        uint32 Random;
+    };
+
+public:
+    FLogRateLimiter()
+        : EmissionInterval(0)
+        , BurstTolerance(0)
+        , TheoreticalArrival(0)
+        , bSampling(false)
+        , SampleThreshold(MAX_uint32)
+        , RejectedLines(0)
+        , SampledOutLines(0)
+    {
+    }
+
+    /**
+     * @param LinesPerSecond - sustained rate, 0 or less removes the limit
+     * @param Burst - lines admitted back to back after a quiet period
+     */
+    void SetRateLimit(float LinesPerSecond, int32 Burst)
+    {
+        if (LinesPerSecond <= 0.0f)
+        {
+            EmissionInterval = 0;
+            return;
+        }
+
+        const int64 Interval = FMath::Max<int64>(1, (int64)(1.0 / (LinesPerSecond * FPlatformTime::GetSecondsPerCycle64())));
+        BurstTolerance = Interval * (FMath::Max(Burst, 1) - 1);
+        // Written last, a non-zero interval turns the check on
+        EmissionInterval = Interval;
+    }
+
+    /** @param KeepRatio - share of the lines kept, 1 keeps every line */
+    void SetSampling(float KeepRatio)
+    {
+        KeepRatio = FMath::Clamp(KeepRatio, 0.0f, 1.0f);
+        SampleThreshold = (uint32)(KeepRatio * (double)MAX_uint32);
+        bSampling = KeepRatio < 1.0f;
+    }
+
+    /** [CLIENT THREAD] Whether a new line goes to the log file, counts it if it doesn't */
+    bool Admit()
+    {
+        if (bSampling && NextRandom() > SampleThreshold)
+        {
+            FPlatformAtomics::InterlockedIncrement(&SampledOutLines);
+            return false;
+        }
+
+        const int64 Interval = EmissionInterval;
+        if (Interval == 0)
+        {
+            return true;
+        }
+
+        const int64 Now = (int64)FPlatformTime::Cycles64();
+        for (;;)
+        {
+            const int64 Arrival = TheoreticalArrival;
+            const int64 NextArrival = FMath::Max(Arrival, Now) + Interval;
+            if (NextArrival - Now > BurstTolerance + Interval)
+            {
+                FPlatformAtomics::InterlockedIncrement(&RejectedLines);
+                return false;
+            }
+
+            if (FPlatformAtomics::InterlockedCompareExchange(&TheoreticalArrival, NextArrival, Arrival) == Arrival)
+            {
+                return true;
+            }
+        }
+    }
+
+    /** Whether lines were rejected or sampled out since the counters were last taken */
+    bool HasRejectedLines() const
+    {
+        return RejectedLines != 0 || SampledOutLines != 0;
+    }
+
+    /** Returns and resets the number of lines over the rate limit */
+    int32 TakeRejectedLines()
+    {
+        return FPlatformAtomics::InterlockedExchange(&RejectedLines, 0);
+    }
+
+    /** Returns and resets the number of lines sampled out */
+    int32 TakeSampledOutLines()
+    {
+        return FPlatformAtomics::InterlockedExchange(&SampledOutLines, 0);
+    }
+
+private:
+    static uint32 NextRandom()
+    {
+        uint32& Random = FSampleState::Get().Random;
+        Random ^= Random << 13;
+        Random ^= Random >> 17;
+        Random ^= Random << 5;
+        return Random;
+    }
+
+    /** Cycles between two lines at the sustained rate, 0 if there's no limit */
+    volatile int64 EmissionInterval;
+    /** How far ahead of now the theoretical arrival time may run, in cycles */
+    int64 BurstTolerance;
+    /** Cycle counter value at which the bucket is full again */
+    volatile int64 TheoreticalArrival;
+    bool bSampling;
+    /** A line is kept if the random number is not above this */
+    uint32 SampleThreshold;
+    /** Lines rejected by the rate limit since the last report */
+    volatile int32 RejectedLines;
+    /** Lines sampled out since the last report */
+    volatile int32 SampledOutLines;
+};
@@ -0,0 +1,285 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "HAL/PlatformAtomics.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/UnrealMemory.h"
+#include "Logging/LogVerbosity.h"
+#include "UObject/NameTypes.h"
+
+/** Repeats of a line held back by FLogRepeatTable */
+struct FLogHeldRepeats
+{
+    uint8 Verbosity;
+    /** Category printed in the line, NAME_None if the file leaves it out */
+    FName PrintedCategory;
+    int32 NumHeld;
+};
+
+/**
+ * Last line of every category logged to one file and the repeats of it held back, lock-free.
+ *
+ * A category gets a run the first time it's logged, in a fixed size open addressing hash table like the route
+ * cache. A run is a single 64-bit state word: a 44-bit hash of the last line (message, its length and verbosity),
+ * its verbosity and the number of repeats held back. A repeat is one compare-and-swap adding one, a different line
+ * swaps in its own hash and takes the count of the run it ends in the same compare-and-swap, so a count never
+ * lands on the wrong line. Lines are only compared by hash, two different lines look the same about once in 10^13.
+ *
+ * When the table is full, or the probe runs too long, the lines of a new category aren't coalesced.
+ */
+class FLogRepeatTable
+{
+    enum EConstants
+    {
+        /** Power of two */
+        Capacity = 1024,
+        MaxProbes = 32,
+        CountBits = 16,
+        VerbosityBits = 4,
+        TagShift = CountBits + VerbosityBits
+    };
+
+    struct FRun
+    {
+        /** MakeKey of the category, 0 for a free slot */
+        volatile int64 Key;
+        /** Tag, verbosity and repeat count, see MakeState */
+        volatile int64 State;
+        /** Cycle counter when the first repeat held back came in */
+        volatile int64 FirstHeldCycles;
+        /** Set once before bReady and never changed, a file prints a category the same way every time */
+        FName PrintedCategory;
+        volatile int32 bReady;
+    };
+
+public:
+    enum
+    {
+        /** Most repeats held back, the count is written and a new run started once reached */
+        MaxHeld = (1 << CountBits) - 1
+    };
+
+    FLogRepeatTable()
+        : Runs(new FRun[Capacity])
+        , NumRuns(0)
+    {
+        FMemory::Memzero(Runs, sizeof(FRun) * Capacity);
+        for (int32 RunIndex = 0; RunIndex < Capacity; ++RunIndex)
+        {
+            RunSlots[RunIndex] = INDEX_NONE;
+        }
+    }
+
+    ~FLogRepeatTable()
+    {
+        delete[] Runs;
+    }
+
+    /**
+     * [CLIENT THREAD] Holds the line back if it repeats the last line of its category, or makes it the new last line.
+     * @param OutEnded - repeats of the previous line the line ends, NumHeld 0 if there are none
+     * @param bOutFirstHeld - set if the line is the first repeat held back, the count is due RepeatIntervalSec from now
+     * @return true if the line is a repeat and must not be written
+     */
+    bool Coalesce(const class FName& Category, const class FName& PrintedCategory, ELogVerbosity::Type Verbosity,
+        const TCHAR* Message, int32 Length, FLogHeldRepeats& OutEnded, bool& bOutFirstHeld)
+    {
+        OutEnded.NumHeld = 0;
+        bOutFirstHeld = false;
+
+        FRun* Run = FindOrAddRun(Category, PrintedCategory);
+        if (!Run)
+        {
+            return false;
+        }
+
+        const uint64 Tag = MakeTag(Message, Length, Verbosity);
+        for (;;)
+        {
+            const int64 OldState = Run->State;
+            const int32 NumHeld = GetNumHeld(OldState);
+            const bool bRepeat = GetTag(OldState) == Tag && NumHeld < MaxHeld;
+            const int64 NewState = bRepeat ? OldState + 1 : MakeState(Tag, Verbosity, 0);
+
+            if (FPlatformAtomics::InterlockedCompareExchange(&Run->State, NewState, OldState) != OldState)
+            {
+                continue;
+            }
+
+            if (bRepeat)
+            {
+                if (NumHeld == 0)
+                {
+                    FPlatformAtomics::InterlockedExchange(&Run->FirstHeldCycles, (int64)FPlatformTime::Cycles64());
+                    bOutFirstHeld = true;
+                }
+                return true;
+            }
+
+            OutEnded = FLogHeldRepeats{ GetVerbosity(OldState), Run->PrintedCategory, NumHeld };
+            return false;
+        }
+    }
+
+    /** [ANY THREAD] Number of categories seen so far, runs are numbered in the order they were added */
+    int32 GetNumRuns() const
+    {
+        return FMath::Min((int32)NumRuns, (int32)Capacity);
+    }
+
+    /**
+     * [ANY THREAD] Gets the repeats held back by run RunIndex without taking them
+     * @return false if it holds none
+     */
+    bool PeekHeld(int32 RunIndex, FLogHeldRepeats& OutHeld, uint64& OutFirstHeldCycles) const
+    {
+        const FRun* Run = GetRun(RunIndex);
+        const int64 State = Run ? Run->State : 0;
+        if (GetNumHeld(State) == 0)
+        {
+            return false;
+        }
+
+        OutHeld = FLogHeldRepeats{ GetVerbosity(State), Run->PrintedCategory, GetNumHeld(State) };
+        OutFirstHeldCycles = (uint64)Run->FirstHeldCycles;
+        return true;
+    }
+
+    /**
+     * [ANY THREAD] Takes the repeats held back by run RunIndex, the run goes on and later repeats are counted from 0
+     * @return false if it holds none
+     */
+    bool TakeHeld(int32 RunIndex, FLogHeldRepeats& OutHeld)
+    {
+        FRun* Run = GetRun(RunIndex);
+        if (!Run)
+        {
+            return false;
+        }
+
+        for (;;)
+        {
+            const int64 OldState = Run->State;
+            if (GetNumHeld(OldState) == 0)
+            {
+                return false;
+            }
+
+            if (FPlatformAtomics::InterlockedCompareExchange(&Run->State, OldState & ~(int64)MaxHeld, OldState) == OldState)
+            {
+                OutHeld = FLogHeldRepeats{ GetVerbosity(OldState), Run->PrintedCategory, GetNumHeld(OldState) };
+                return true;
+            }
+        }
+    }
+
+private:
+    static uint64 MakeKey(const class FName& Category)
+    {
+        return (((uint64)(uint32)Category.GetNumber() << 32) | (uint32)Category.GetComparisonIndex()) + 1;
+    }
+
+    static uint32 GetHomeIndex(uint64 Key)
+    {
+        return (uint32)((Key * 0x9E3779B97F4A7C15ull) >> 54) & (Capacity - 1);
+    }
+
+    /** Hash of the line in the upper bits of a state, never 0 so it can't match a fresh run */
+    static uint64 MakeTag(const TCHAR* Message, int32 Length, ELogVerbosity::Type Verbosity)
+    {
+        const uint8* Bytes = (const uint8*)Message;
+        const int64 NumBytes = (int64)Length * sizeof(TCHAR);
+
+        uint64 Hash = 0xCBF29CE484222325ull ^ (uint64)NumBytes ^ ((uint64)Verbosity << 56);
+        int64 Offset = 0;
+        for (; Offset + 8 <= NumBytes; Offset += 8)
+        {
+            uint64 Word;
+            FMemory::Memcpy(&Word, Bytes + Offset, sizeof(Word));
+            Hash = (Hash ^ Word) * 0x9E3779B97F4A7C15ull;
+            Hash ^= Hash >> 29;
+        }
+        for (; Offset < NumBytes; ++Offset)
+        {
+            Hash = (Hash ^ Bytes[Offset]) * 0x100000001B3ull;
+        }
+
+        // Final mix of MurmurHash3, every input bit reaches the upper bits kept
+        Hash ^= Hash >> 33;
+        Hash *= 0xFF51AFD7ED558CCDull;
+        Hash ^= Hash >> 33;
+        Hash *= 0xC4CEB9FE1A85EC53ull;
+        Hash ^= Hash >> 33;
+
+        return (Hash >> TagShift) | 1;
+    }
+
+    static int64 MakeState(uint64 Tag, ELogVerbosity::Type Verbosity, int32 NumHeld)
+    {
+        return (int64)((Tag << TagShift) | ((uint64)(Verbosity & ((1 << VerbosityBits) - 1)) << CountBits) | (uint64)NumHeld);
+    }
+
+    static uint64 GetTag(int64 State)
+    {
+        return (uint64)State >> TagShift;
+    }
+
+    static uint8 GetVerbosity(int64 State)
+    {
+        return (uint8)(((uint64)State >> CountBits) & ((1 << VerbosityBits) - 1));
+    }
+
+    static int32 GetNumHeld(int64 State)
+    {
+        return (int32)(State & MaxHeld);
+    }
+
+    /** Run of Category, added if it's new. nullptr if the table has no room for it or another thread is still adding it. */
+    FRun* FindOrAddRun(const class FName& Category, const class FName& PrintedCategory)
+    {
+        const uint64 Key = MakeKey(Category);
+        for (uint32 Probe = 0, Index = GetHomeIndex(Key); Probe < MaxProbes; ++Probe, Index = (Index + 1) & (Capacity - 1))
+        {
+            FRun* Run = &Runs[Index];
+            int64 RunKey = Run->Key;
+            if (RunKey == 0)
+            {
+                RunKey = FPlatformAtomics::InterlockedCompareExchange(&Run->Key, (int64)Key, 0);
+                if (RunKey == 0)
+                {
+                    Run->PrintedCategory = PrintedCategory;
+                    RunSlots[FPlatformAtomics::InterlockedIncrement(&NumRuns) - 1] = (int32)Index;
+                    FPlatformAtomics::InterlockedExchange(&Run->bReady, 1);
+                    return Run;
+                }
+            }
+
+            if ((uint64)RunKey == Key)
+            {
+                return Run->bReady ? Run : nullptr;
+            }
+        }
+
+        return nullptr;
+    }
+
+    /** Run number RunIndex, nullptr while the thread adding it hasn't published it yet */
+    FRun* GetRun(int32 RunIndex) const
+    {
+        const int32 Index = RunSlots[RunIndex];
+        if (Index == INDEX_NONE || !Runs[Index].bReady)
+        {
+            return nullptr;
+        }
+
+        FPlatformMisc::MemoryBarrier();
+        return &Runs[Index];
+    }
+
+    FRun* Runs;
+    /** Slot index in Runs of every run, in the order they were added */
+    volatile int32 RunSlots[Capacity];
+    volatile int32 NumRuns;
+};
@@ -0,0 +1,214 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#include "LogManagerPrivatePCH.h"
+
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/ScopeLock.h"
+
+namespace
+{
+    /** First line of a manifest */
+    const TCHAR* GManifestHeader = TEXT("LogManagerSessions 1");
+
+    /** Serializes runs, two of them would measure and delete the same folders */
+    FCriticalSection GRetentionCritical;
+}
+
+void FLogRetention::Apply(const FString& LogDir, const FString& SessionPrefix, const FString& CurrentSession, const FLogRetentionPolicy& Policy)
+{
+    FScopeLock RetentionLock(&GRetentionCritical);
+
+    const FString ManifestFilename = GetManifestFilename(LogDir, SessionPrefix);
+
+    TArray<FSession> KnownSessions;
+    LoadManifest(ManifestFilename, KnownSessions);
+
+    TMap<FString, const FSession*> KnownByName;
+    for (const FSession& Session : KnownSessions)
+    {
+        KnownByName.Add(Session.Name, &Session);
+    }
+
+    // A single listing of the log directory, only folders missing from the manifest are walked
+    TArray<FString> Folders;
+    IFileManager::Get().FindFiles(Folders, *(LogDir / (SessionPrefix + TEXT("*"))), false, true);
+
+    TArray<FSession> Sessions;
+    TSet<FString> LiveSessions;
+    for (const FString& Folder : Folders)
+    {
+        const bool bCurrent = Folder.Equals(CurrentSession, ESearchCase::IgnoreCase);
+        const FSession* const* Known = KnownByName.Find(Folder);
+
+        FSession Session = Known ? **Known : FSession{ Folder, 0, FDateTime::MinValue(), false };
+        if (!Session.bComplete)
+        {
+            // Another instance may still be writing it, it's never deleted and measured again next time
+            const bool bLive = !bCurrent && IsSessionLive(LogDir / Folder);
+            if (bLive)
+            {
+                LiveSessions.Add(Folder);
+            }
+
+            MeasureSession(LogDir / Folder, Session);
+            Session.bComplete = !bCurrent && !bLive;
+        }
+        Sessions.Add(Session);
+    }
+
+    // Session folder names end in their start time, newest first
+    Sessions.Sort([](const FSession& Lhs, const FSession& Rhs)
+    {
+        return Lhs.Name > Rhs.Name;
+    });
+
+    const FDateTime Now = FDateTime::UtcNow();
+    // The current session counts whether its folder exists yet or not, MaxSessions includes it
+    int32 KeptSessions = 1;
+    int64 KeptBytes = 0;
+    bool bOverQuota = false;
+
+    TArray<FSession> RemainingSessions;
+    for (const FSession& Session : Sessions)
+    {
+        if (Session.Name.Equals(CurrentSession, ESearchCase::IgnoreCase))
+        {
+            KeptBytes += Session.Bytes;
+            RemainingSessions.Add(Session);
+            continue;
+        }
+
+        bool bExpired = false;
+        if (!LiveSessions.Contains(Session.Name))
+        {
+            // Once a session doesn't fit the quota no older one is kept either
+            bOverQuota |= Policy.MaxTotalBytes > 0 && KeptBytes + Session.Bytes > Policy.MaxTotalBytes;
+
+            bExpired = bOverQuota ||
+                (Policy.MaxSessions >= 0 && KeptSessions >= Policy.MaxSessions) ||
+                (Policy.MaxAgeDays > 0.0 && (Now - Session.LastWriteTime).GetTotalDays() > Policy.MaxAgeDays);
+        }
+
+        if (bExpired && IFileManager::Get().DeleteDirectory(*(LogDir / Session.Name), false, true))
+        {
+            continue;
+        }
+
+        ++KeptSessions;
+        KeptBytes += Session.Bytes;
+        RemainingSessions.Add(Session);
+    }
+
+    SaveManifest(ManifestFilename, RemainingSessions);
+}
+
+FString FLogRetention::GetManifestFilename(const FString& LogDir, const FString& SessionPrefix)
+{
+    return LogDir / (SessionPrefix + TEXT(".sessions"));
+}
+
+FString FLogRetention::GetMarkerFilename(const FString& SessionDir)
+{
+    return SessionDir / TEXT("Session.pid");
+}
+
+void FLogRetention::BeginSession(const FString& SessionDir)
+{
+    FFileHelper::SaveStringToFile(FString::Printf(TEXT("%u"), FPlatformProcess::GetCurrentProcessId()), *GetMarkerFilename(SessionDir));
+}
+
+void FLogRetention::EndSession(const FString& SessionDir)
+{
+    IFileManager::Get().Delete(*GetMarkerFilename(SessionDir), false, true, true);
+}
+
+bool FLogRetention::IsSessionLive(const FString& SessionDir)
+{
+    FString ProcessId;
+    if (!FFileHelper::LoadFileToString(ProcessId, *GetMarkerFilename(SessionDir)) || !ProcessId.IsNumeric())
+    {
+        return false;
+    }
+
+    return FPlatformProcess::IsApplicationRunning((uint32)FCString::Atoi64(*ProcessId));
+}
+
+void FLogRetention::LoadManifest(const FString& Filename, TArray<FSession>& OutSessions)
+{
+    FString Manifest;
+    if (!FFileHelper::LoadFileToString(Manifest, *Filename))
+    {
+        return;
+    }
+
+    TArray<FString> Lines;
+    Manifest.ParseIntoArrayLines(Lines);
+    if (Lines.Num() == 0 || Lines[0] != GManifestHeader)
+    {
+        return;
+    }
+
+    for (int32 LineIndex = 1; LineIndex < Lines.Num(); ++LineIndex)
+    {
+        TArray<FString> Fields;
+        Lines[LineIndex].ParseIntoArray(Fields, TEXT("\t"), false);
+        if (Fields.Num() == 4)
+        {
+            OutSessions.Add(FSession{ Fields[0], FCString::Atoi64(*Fields[1]), FDateTime(FCString::Atoi64(*Fields[2])), Fields[3] == TEXT("1") });
+        }
+    }
+}
+
+void FLogRetention::SaveManifest(const FString& Filename, const TArray<FSession>& Sessions)
+{
+    FString Manifest = GManifestHeader;
+    Manifest += LINE_TERMINATOR;
+    for (const FSession& Session : Sessions)
+    {
+        Manifest += FString::Printf(TEXT("%s\t%lld\t%lld\t%d"), *Session.Name, Session.Bytes, Session.LastWriteTime.GetTicks(), Session.bComplete ? 1 : 0);
+        Manifest += LINE_TERMINATOR;
+    }
+
+    // Written aside and moved over, a manifest cut short would make the next run measure everything again
+    const FString TempFilename = Filename + TEXT(".tmp");
+    if (FFileHelper::SaveStringToFile(Manifest, *TempFilename, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+    {
+        IFileManager::Get().Move(*Filename, *TempFilename, true, true);
+    }
+}
+
+void FLogRetention::MeasureSession(const FString& SessionDir, FSession& Session)
+{
+    class FSessionVisitor : public IPlatformFile::FDirectoryStatVisitor
+    {
+    public:
+        FSessionVisitor()
+            : Bytes(0)
+            , LastWriteTime(FDateTime::MinValue())
+        {
+        }
+
+        //~ Begin FDirectoryStatVisitor Interface.
+        virtual bool Visit(const TCHAR* FilenameOrDirectory, const FFileStatData& StatData) override
+        {
+            if (!StatData.bIsDirectory)
+            {
+                Bytes += FMath::Max<int64>(StatData.FileSize, 0);
+                LastWriteTime = FMath::Max(LastWriteTime, StatData.ModificationTime);
+            }
+
+            return true;
+        }
+
+        int64 Bytes;
+        FDateTime LastWriteTime;
+    } SessionVisitor;
+
+    IFileManager::Get().IterateDirectoryStatRecursively(*SessionDir, SessionVisitor);
+
+    Session.Bytes = SessionVisitor.Bytes;
+    // An empty folder ages from when it was created
+    Session.LastWriteTime = SessionVisitor.LastWriteTime != FDateTime::MinValue() ? SessionVisitor.LastWriteTime : IFileManager::Get().GetTimeStamp(*SessionDir);
+}
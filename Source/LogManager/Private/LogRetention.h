@@ -0,0 +1,64 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "Containers/Array.h"
+#include "Containers/UnrealString.h"
+#include "Misc/DateTime.h"
+
+#include "ILogManager.h"
+
+/**
+ * Deletes old session log folders by count, total size and age.
+ *
+ * The sizes and last write times of the session folders are kept in a manifest next to them, so a run only
+ * lists the log directory itself and measures the folders it hasn't seen yet, plus the ones still being
+ * written when the manifest was saved. Folders deleted by hand simply drop out of the manifest.
+ * Runs are serialized, they are meant to be started on a background thread.
+ *
+ * A running session leaves a marker file with its process ID in its folder, so another instance sharing the log
+ * directory keeps the sessions still being written. A marker left behind by a crash names a process that is gone.
+ */
+class FLogRetention
+{
+public:
+    /**
+     * @param LogDir - directory holding the session folders
+     * @param SessionPrefix - name prefix of the session folders, the game name
+     * @param CurrentSession - folder name of the running session, never deleted
+     * @param Policy - what to keep
+     */
+    static void Apply(const FString& LogDir, const FString& SessionPrefix, const FString& CurrentSession, const FLogRetentionPolicy& Policy);
+
+    /** Marks SessionDir as written by this process until EndSession, creating the folder if needed */
+    static void BeginSession(const FString& SessionDir);
+
+    /** Removes the marker of BeginSession */
+    static void EndSession(const FString& SessionDir);
+
+private:
+    struct FSession
+    {
+        /** Folder name */
+        FString Name;
+        int64 Bytes;
+        /** Last write to any file in the folder, UTC */
+        FDateTime LastWriteTime;
+        /** Whether the session had ended when it was measured, a session still running is measured again */
+        bool bComplete;
+    };
+
+    static FString GetManifestFilename(const FString& LogDir, const FString& SessionPrefix);
+
+    static FString GetMarkerFilename(const FString& SessionDir);
+
+    /** Whether the process that marked SessionDir is still running */
+    static bool IsSessionLive(const FString& SessionDir);
+
+    static void LoadManifest(const FString& Filename, TArray<FSession>& OutSessions);
+
+    static void SaveManifest(const FString& Filename, const TArray<FSession>& Sessions);
+
+    /** Measures the size and last write time of a session folder */
+    static void MeasureSession(const FString& SessionDir, FSession& Session);
+};
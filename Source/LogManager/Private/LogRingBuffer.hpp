@@ -0,0 +1,246 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "HAL/PlatformAtomics.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/UnrealMemory.h"
+#include "Math/UnrealMathUtility.h"
+
+/**
+ * Lock-free multi-producer single-consumer ring buffer of variable length records.
+ *
+ * Producers claim space with an atomic reserve (compare-and-swap on the reserve position), fill the
+ * claimed range without holding any lock and then commit it by publishing the record header.
+ * The single consumer walks the records in reservation order, stops at the first record that has
+ * not been committed yet and hands the consumed space back to the producers on Release().
+ *
+ * Records never wrap around the end of the buffer: when a record does not fit into the remaining tail
+ * the producer reserves the tail as well and marks it as padding, so payloads are always contiguous.
+ */
+class FLogRingBuffer
+{
+    enum EConstants
+    {
+        /** Records start on this boundary so a header never straddles the end of the buffer */
+        RecordAlignment = 8,
+        /** Header length value marking a padding record */
+        PaddingLength = -1,
+        /** Smallest capacity we allocate */
+        MinCapacity = 4 * 1024
+    };
+
+    struct FRecordHeader
+    {
+        /** Total bytes taken by the record including header and alignment. 0 until the record is committed. */
+        volatile int32 Span;
+        /** Payload length in bytes, or PaddingLength */
+        int32 Length;
+    };
+
+public:
+    /** A claimed, not yet committed range of the ring buffer */
+    struct FReservation
+    {
+        /** Where the producer copies its payload to */
+        uint8* Data;
+        /** Number of payload bytes reserved */
+        int32 Length;
+
+    private:
+        friend class FLogRingBuffer;
+
+        /** Header published on commit */
+        FRecordHeader* Header;
+        /** Bytes taken by the record */
+        int32 Span;
+    };
+
+    explicit FLogRingBuffer(int32 InCapacity)
+        : Capacity(FMath::RoundUpToPowerOfTwo(FMath::Max<uint32>(InCapacity, MinCapacity)))
+        , Buffer((uint8*)FMemory::Malloc(Capacity, RecordAlignment))
+        , ReservePos(0)
+        , ReleasePos(0)
+        , ReadPos(0)
+    {
+        FMemory::Memzero(Buffer, Capacity);
+    }
+
+    ~FLogRingBuffer()
+    {
+        FMemory::Free(Buffer);
+        Buffer = nullptr;
+    }
+
+    /** Size of the ring buffer in bytes */
+    int32 GetCapacity() const
+    {
+        return Capacity;
+    }
+
+    /** Largest payload that fits into a single record */
+    int32 GetMaxRecordLength() const
+    {
+        // A record that has to skip the tail takes less than twice its span, keep that within the capacity
+        return Capacity / 2 - sizeof(FRecordHeader);
+    }
+
+    /** Position right after the last reserved record. Everything before it has been claimed by a producer. */
+    int64 GetReservePos() const
+    {
+        return LoadAcquire(&ReservePos);
+    }
+
+    /** Position up to which the consumer has processed and released the records */
+    int64 GetReleasePos() const
+    {
+        return LoadAcquire(&ReleasePos);
+    }
+
+    /**
+     * [PRODUCER] Claims space for a record of Length bytes.
+     * @return false if the ring buffer doesn't have enough free space right now
+     */
+    bool Reserve(int32 Length, FReservation& OutReservation)
+    {
+        checkSlow(Length >= 0 && Length <= GetMaxRecordLength());
+
+        const int64 Span = (sizeof(FRecordHeader) + Length + RecordAlignment - 1) & ~(int64)(RecordAlignment - 1);
+
+        for (;;)
+        {
+            const int64 Head = LoadAcquire(&ReservePos);
+            const int64 Offset = Head & (Capacity - 1);
+            const int64 TailSpace = Capacity - Offset;
+            const int64 Needed = TailSpace < Span ? TailSpace + Span : Span;
+
+            if (Head + Needed - LoadAcquire(&ReleasePos) > Capacity)
+            {
+                return false;
+            }
+
+            if (FPlatformAtomics::InterlockedCompareExchange(&ReservePos, Head + Needed, Head) == Head)
+            {
+                int64 RecordOffset = Offset;
+                if (TailSpace < Span)
+                {
+                    // Skip the tail, the consumer will jump over it as soon as it is published
+                    Publish(HeaderAt(Offset), PaddingLength, (int32)TailSpace);
+                    RecordOffset = 0;
+                }
+
+                OutReservation.Header = HeaderAt(RecordOffset);
+                OutReservation.Data = (uint8*)(OutReservation.Header + 1);
+                OutReservation.Length = Length;
+                OutReservation.Span = (int32)Span;
+                return true;
+            }
+        }
+    }
+
+    /** [PRODUCER] Makes the reserved record visible to the consumer */
+    void Commit(const FReservation& Reservation)
+    {
+        Publish(Reservation.Header, Reservation.Length, Reservation.Span);
+    }
+
+    /** [CONSUMER] True if there is at least one committed record waiting */
+    bool HasCommittedData() const
+    {
+        return HeaderAt(ReadPos & (Capacity - 1))->Span != 0;
+    }
+
+    /**
+     * [CONSUMER] Gets the next committed record without consuming it.
+     * @return false if the consumer caught up with the producers
+     */
+    bool Peek(const uint8*& OutData, int32& OutLength)
+    {
+        for (;;)
+        {
+            const FRecordHeader* Header = HeaderAt(ReadPos & (Capacity - 1));
+            const int32 Span = Header->Span;
+            if (Span == 0)
+            {
+                return false;
+            }
+            FPlatformMisc::MemoryBarrier();
+
+            if (Header->Length == PaddingLength)
+            {
+                ReadPos += Span;
+                continue;
+            }
+
+            OutData = (const uint8*)(Header + 1);
+            OutLength = Header->Length;
+            return true;
+        }
+    }
+
+    /** [CONSUMER] Consumes the record returned by the last successful Peek */
+    void Pop()
+    {
+        ReadPos += HeaderAt(ReadPos & (Capacity - 1))->Span;
+    }
+
+    /** [CONSUMER] Number of consumed bytes not yet handed back to the producers */
+    int64 GetUnreleasedSize() const
+    {
+        return ReadPos - ReleasePos;
+    }
+
+    /** [CONSUMER] Hands the space of all consumed records back to the producers */
+    void Release()
+    {
+        const int64 From = ReleasePos;
+        const int64 Length = ReadPos - From;
+        if (Length > 0)
+        {
+            // Headers of future records may land anywhere in this range, they have to read as uncommitted
+            const int64 Offset = From & (Capacity - 1);
+            const int64 FirstPart = FMath::Min<int64>(Length, Capacity - Offset);
+            FMemory::Memzero(Buffer + Offset, FirstPart);
+            if (Length > FirstPart)
+            {
+                FMemory::Memzero(Buffer, Length - FirstPart);
+            }
+
+            FPlatformMisc::MemoryBarrier();
+            ReleasePos = ReadPos;
+        }
+    }
+
+private:
+    FORCEINLINE FRecordHeader* HeaderAt(int64 Offset) const
+    {
+        return (FRecordHeader*)(Buffer + Offset);
+    }
+
+    static FORCEINLINE void Publish(FRecordHeader* Header, int32 Length, int32 Span)
+    {
+        Header->Length = Length;
+        FPlatformAtomics::InterlockedExchange(&Header->Span, Span);
+    }
+
+    static FORCEINLINE int64 LoadAcquire(volatile const int64* Source)
+    {
+        const int64 Value = *Source;
+        FPlatformMisc::MemoryBarrier();
+        return Value;
+    }
+
+    /** Size of the buffer, power of two */
+    const int32 Capacity;
+    /** Record storage */
+    uint8* Buffer;
+
+    /** [PRODUCER THREADS] Position where the next record will be reserved */
+    volatile int64 ReservePos;
+    /** Keeps the producer and consumer positions on separate cache lines */
+    uint8 ProducerPadding[PLATFORM_CACHE_LINE_SIZE];
+    /** [CONSUMER THREAD] Position up to which space has been handed back to the producers */
+    volatile int64 ReleasePos;
+    /** [CONSUMER THREAD] Position of the next record to consume */
+    int64 ReadPos;
+};
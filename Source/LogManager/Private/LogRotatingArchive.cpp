@@ -0,0 +1,228 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#include "LogManagerPrivatePCH.h"
+
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+
+FLogRotatingArchive::FLogRotatingArchive(const FString& InFilename, const FLogWriterSettings& Settings, const TArray<uint8>& InSegmentHeader, FLogCompressor* InCompressor)
+    : BaseFilename(InFilename)
+    , RotateSize(Settings.RotateSize)
+    , RotateIntervalSec(Settings.RotateIntervalSec)
+    , bCompressLive(Settings.bCompressLive)
+    , bMemoryMapped(Settings.bMemoryMapped)
+    , bVectoredIO(Settings.bVectoredIO)
+    , Compressor(InCompressor)
+    , bCompressLastSegment(true)
+    , SegmentHeader(InSegmentHeader)
+    , Segment(nullptr)
+    , bSegmentMapped(false)
+    , SegmentIndex(0)
+    , SegmentBytes(0)
+    , SegmentOffset(0)
+    , SegmentStartTime(0.0)
+{
+    ArIsSaving = true;
+    SegmentFilename = GetSegmentFilename(0);
+}
+
+FLogRotatingArchive::~FLogRotatingArchive()
+{
+    if (NextSegment.IsValid())
+    {
+        // Opened ahead of time but never written, don't leave an empty segment behind
+        FArchive* UnusedSegment = NextSegment.Get().Archive;
+        if (UnusedSegment)
+        {
+            delete UnusedSegment;
+            IFileManager::Get().Delete(*GetSegmentFilename(SegmentIndex + 1));
+        }
+    }
+
+    for (TFuture<void>& ClosingSegment : ClosingSegments)
+    {
+        ClosingSegment.Wait();
+    }
+    ClosingSegments.Empty();
+
+    if (Segment)
+    {
+        delete Segment;
+        Segment = nullptr;
+
+        // Complete now, like any rotated out segment
+        if (Compressor && !bCompressLive && bCompressLastSegment)
+        {
+            Compressor->EnqueueFile(SegmentFilename);
+        }
+    }
+}
+
+bool FLogRotatingArchive::Open()
+{
+    // The first segment's header is written by the owner, like for any log file
+    const FOpenedSegment Opened = OpenSegment(SegmentFilename, TArray<uint8>(), bCompressLive, bMemoryMapped, bVectoredIO);
+    Segment = Opened.Archive;
+    bSegmentMapped = Opened.bMapped;
+    SegmentStartTime = FPlatformTime::Seconds();
+    return Segment != nullptr;
+}
+
+FString FLogRotatingArchive::GetSegmentFilename(int32 Index) const
+{
+    FString Filename = BaseFilename;
+    if (Index > 0)
+    {
+        const FString Extension = FPaths::GetExtension(BaseFilename, true);
+        Filename = FString::Printf(TEXT("%s.%d%s"), *FPaths::GetBaseFilename(BaseFilename, false), Index, *Extension);
+    }
+
+    if (bCompressLive)
+    {
+        Filename += FLogCompressedFormat::GetExtension();
+    }
+    return Filename;
+}
+
+void FLogRotatingArchive::Serialize(void* Data, int64 Length)
+{
+    Segment->Serialize(Data, Length);
+    SegmentBytes += Length;
+    SegmentOffset += Length;
+}
+
+void FLogRotatingArchive::Flush()
+{
+    Segment->Flush();
+
+    for (TFuture<void>& ClosingSegment : ClosingSegments)
+    {
+        ClosingSegment.Wait();
+    }
+    ClosingSegments.Empty();
+}
+
+void FLogRotatingArchive::FlushBuffers()
+{
+    if (!bSegmentMapped && !bCompressLive)
+    {
+        Segment->Flush();
+    }
+}
+
+FString FLogRotatingArchive::GetArchiveName() const
+{
+    return SegmentFilename;
+}
+
+void FLogRotatingArchive::RotateIfDue()
+{
+    if (RotateSize <= 0 && RotateIntervalSec <= 0.0)
+    {
+        return;
+    }
+
+    const double SegmentAge = RotateIntervalSec > 0.0 ? FPlatformTime::Seconds() - SegmentStartTime : 0.0;
+    const bool bSizeDue = RotateSize > 0 && SegmentBytes >= RotateSize;
+    const bool bAgeDue = RotateIntervalSec > 0.0 && SegmentAge >= RotateIntervalSec;
+
+    // Open the next segment while the current one fills its last quarter
+    if (!NextSegment.IsValid() &&
+        ((RotateSize > 0 && SegmentBytes >= RotateSize - RotateSize / 4) ||
+        (RotateIntervalSec > 0.0 && SegmentAge >= RotateIntervalSec * 0.75)))
+    {
+        PrepareNextSegment();
+    }
+
+    // Not open yet? Keep writing the current segment rather than stall, we'll switch on a later line
+    if (!(bSizeDue || bAgeDue) || !NextSegment.IsReady())
+    {
+        return;
+    }
+
+    const FOpenedSegment NewSegment = NextSegment.Get();
+    NextSegment = TFuture<FOpenedSegment>();
+    ++SegmentIndex;
+
+    if (!NewSegment.Archive)
+    {
+        // Couldn't create the file, give the current segment another full round before trying the next name
+        SegmentBytes = 0;
+        SegmentStartTime = FPlatformTime::Seconds();
+        return;
+    }
+
+    FArchive* OldSegment = Segment;
+    Segment = NewSegment.Archive;
+    bSegmentMapped = NewSegment.bMapped;
+    {
+        FScopeLock FilenameLock(&SegmentFilenameCritical);
+        SegmentFilename = GetSegmentFilename(SegmentIndex);
+    }
+    SegmentBytes = SegmentHeader.Num();
+    SegmentOffset = SegmentHeader.Num();
+    SegmentStartTime = FPlatformTime::Seconds();
+
+    ClosingSegments.RemoveAll([](const TFuture<void>& ClosingSegment)
+    {
+        return ClosingSegment.IsReady();
+    });
+
+    FLogCompressor* SegmentCompressor = bCompressLive ? nullptr : Compressor;
+    const FString OldSegmentFilename = GetSegmentFilename(SegmentIndex - 1);
+
+    ClosingSegments.Add(Async<void>(EAsyncExecution::ThreadPool, [OldSegment, SegmentCompressor, OldSegmentFilename]()
+    {
+        OldSegment->Flush();
+        delete OldSegment;
+
+        if (SegmentCompressor)
+        {
+            SegmentCompressor->EnqueueFile(OldSegmentFilename);
+        }
+    }));
+}
+
+void FLogRotatingArchive::PrepareNextSegment()
+{
+    const FString Filename = GetSegmentFilename(SegmentIndex + 1);
+    const TArray<uint8>& Header = SegmentHeader;
+    const bool bCompressed = bCompressLive;
+    const bool bMapped = bMemoryMapped;
+    const bool bVectored = bVectoredIO;
+
+    NextSegment = Async<FOpenedSegment>(EAsyncExecution::ThreadPool, [Filename, Header, bCompressed, bMapped, bVectored]()
+    {
+        return OpenSegment(Filename, Header, bCompressed, bMapped, bVectored);
+    });
+}
+
+FLogRotatingArchive::FOpenedSegment FLogRotatingArchive::OpenSegment(const FString& Filename, const TArray<uint8>& SegmentHeader, bool bCompressed, bool bMapped, bool bVectored)
+{
+    // Falls back to the file writer if the file can't be opened by the platform specific backend
+    FArchive* NewSegment = nullptr;
+    bool bIsMapped = false;
+    if (bMapped)
+    {
+        NewSegment = FLogMappedFileArchive::Create(Filename);
+        bIsMapped = NewSegment != nullptr;
+    }
+    else if (bVectored)
+    {
+        NewSegment = FLogVectoredFileArchive::Create(Filename);
+    }
+    if (!NewSegment)
+    {
+        NewSegment = IFileManager::Get().CreateFileWriter(*Filename, FILEWRITE_AllowRead);
+    }
+    if (NewSegment && bCompressed)
+    {
+        NewSegment = new FLogCompressedArchive(NewSegment);
+    }
+
+    if (NewSegment && SegmentHeader.Num() > 0)
+    {
+        NewSegment->Serialize((void*)SegmentHeader.GetData(), SegmentHeader.Num());
+    }
+    return FOpenedSegment{ NewSegment, bIsMapped };
+}
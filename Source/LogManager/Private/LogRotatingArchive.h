@@ -0,0 +1,147 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "Async/Future.h"
+#include "Containers/Array.h"
+#include "Containers/UnrealString.h"
+#include "HAL/CriticalSection.h"
+#include "Misc/ScopeLock.h"
+#include "Serialization/Archive.h"
+
+#include "LogWriterSettings.hpp"
+
+class FLogCompressor;
+
+/**
+ * Log file archive split into segments by size and/or age.
+ *
+ * The first segment is the file the log was opened with, the following ones are numbered before the
+ * extension (Game.log, Game.1.log, Game.2.log, ...). The next segment is opened on the thread pool ahead
+ * of time and the old one is flushed and closed there too, so rotating is a pointer swap for the writer.
+ * Rotation only happens in RotateIfDue(), which the writer calls between lines so a line never straddles
+ * two segments.
+ *
+ * Rotated out segments are handed to the compressor if there is one, and so is the last segment once the archive
+ * is closed. With live compression every segment is written as compressed frames right away and gets the
+ * compressed extension.
+ */
+class FLogRotatingArchive : public FArchive
+{
+public:
+    /**
+     * @param InFilename - first segment, uncompressed name
+     * @param Settings - rotation and compression settings
+     * @param InSegmentHeader - bytes written at the start of every segment after the first, e.g. a byte order mark
+     * @param InCompressor - compresses rotated out segments, may be nullptr
+     */
+    FLogRotatingArchive(const FString& InFilename, const FLogWriterSettings& Settings, const TArray<uint8>& InSegmentHeader, FLogCompressor* InCompressor);
+    virtual ~FLogRotatingArchive();
+
+    /** Opens the first segment, false if the file couldn't be created */
+    bool Open();
+
+    /** Starts a new segment if the current one is due and the next one is ready */
+    void RotateIfDue();
+
+    /**
+     * Hands buffered bytes to the OS without asking for durability, what the writer does on its flush cadence.
+     * A no-op if the current segment is mapped, its bytes are in the page cache as soon as they are written, or
+     * compressed live, every flush would cut a zlib frame. Compressed frames are cut when full or on Flush().
+     */
+    void FlushBuffers();
+
+    /** Path of the segment currently written */
+    const FString& GetSegmentFilename() const
+    {
+        return SegmentFilename;
+    }
+
+    /** [ANY THREAD] Copy of the path of the segment currently written, doesn't wait for the writer */
+    FString GetSegmentFilenameSnapshot() const
+    {
+        FScopeLock FilenameLock(&SegmentFilenameCritical);
+        return SegmentFilename;
+    }
+
+    /** Path of segment SegmentIndex */
+    FString GetSegmentFilename(int32 Index) const;
+
+    /** Bytes in the file of the segment currently written, segment header included */
+    int64 GetSegmentOffset() const
+    {
+        return SegmentOffset;
+    }
+
+    /** Index of the segment currently written, changes whenever a new file is started */
+    int32 GetSegmentIndex() const
+    {
+        return SegmentIndex;
+    }
+
+    /** Whether the segment open when the archive is closed goes to the compressor, false if something keeps writing to it */
+    void SetCompressLastSegment(bool bCompress)
+    {
+        bCompressLastSegment = bCompress;
+    }
+
+    //~ Begin FArchive Interface.
+    virtual void Serialize(void* Data, int64 Length) override;
+    /** Flushes the current segment and waits until the segments being closed are on disk */
+    virtual void Flush() override;
+    virtual FString GetArchiveName() const override;
+    //~ End FArchive Interface
+
+private:
+    /** A segment file just opened */
+    struct FOpenedSegment
+    {
+        /** nullptr if the file couldn't be created */
+        FArchive* Archive;
+        /** Whether it is written through a memory mapping, a segment that couldn't be mapped falls back to the file writer */
+        bool bMapped;
+    };
+
+    /** Starts opening the segment after the current one on the thread pool */
+    void PrepareNextSegment();
+
+    /** Opens a segment file and writes the segment header to it */
+    static FOpenedSegment OpenSegment(const FString& Filename, const TArray<uint8>& SegmentHeader, bool bCompressed, bool bMapped, bool bVectored);
+
+    /** Path of the first segment */
+    const FString BaseFilename;
+    const int64 RotateSize;
+    const double RotateIntervalSec;
+    /** Whether segments are written as compressed frames */
+    const bool bCompressLive;
+    /** Whether segments are written through a memory mapping */
+    const bool bMemoryMapped;
+    /** Whether segments are written with batched vectored writes */
+    const bool bVectoredIO;
+    /** Compresses rotated out segments, nullptr if they are kept as they are */
+    FLogCompressor* Compressor;
+    /** Whether the last segment is compressed on close */
+    bool bCompressLastSegment;
+    /** Written at the start of every segment after the first */
+    const TArray<uint8> SegmentHeader;
+
+    /** Segment currently written */
+    FArchive* Segment;
+    /** Whether the current segment is mapped */
+    bool bSegmentMapped;
+    FString SegmentFilename;
+    /** Guards changes of SegmentFilename against GetSegmentFilenameSnapshot, only ever held for a string copy */
+    mutable FCriticalSection SegmentFilenameCritical;
+    int32 SegmentIndex;
+    /** Bytes written to the current segment, starts over when a rotation fails */
+    int64 SegmentBytes;
+    /** Bytes in the file of the current segment */
+    int64 SegmentOffset;
+    /** Time the current segment was started */
+    double SegmentStartTime;
+
+    /** Segment being opened on the thread pool, not valid if none is */
+    TFuture<FOpenedSegment> NextSegment;
+    /** Segments being flushed and closed on the thread pool */
+    TArray<TFuture<void>> ClosingSegments;
+};
@@ -0,0 +1,720 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#include "LogManagerPrivatePCH.h"
+
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+    enum EConstants
+    {
+        /** Bytes scanned by one task */
+        ChunkSize = 4 * 1024 * 1024,
+        /** Most lines walked back from a continuation line to the line it continues */
+        MaxContinuationLines = 256
+    };
+
+    struct FSearchFile
+    {
+        /** Name without the directory */
+        FString Filename;
+        /** UTF-8 category of the lines printed without one, single category files leave it out and are named after it */
+        TArray<uint8> Category;
+        FLogMappedFileReader* Reader;
+    };
+
+    /** Line aligned byte range of a file scanned by one task */
+    struct FSearchChunk
+    {
+        int32 FileIndex;
+        int64 Begin;
+        int64 End;
+    };
+
+    struct FSearchHit
+    {
+        int64 Ticks;
+        int32 FileIndex;
+        int64 Offset;
+        int32 Length;
+    };
+
+    /** Timestamp order, file order between lines of the same time */
+    struct FHitOrder
+    {
+        bool operator()(const FSearchHit& Lhs, const FSearchHit& Rhs) const
+        {
+            if (Lhs.Ticks != Rhs.Ticks)
+            {
+                return Lhs.Ticks < Rhs.Ticks;
+            }
+            if (Lhs.FileIndex != Rhs.FileIndex)
+            {
+                return Lhs.FileIndex < Rhs.FileIndex;
+            }
+            return Lhs.Offset < Rhs.Offset;
+        }
+    };
+
+    /** What the chunks are scanned for, shared by every task */
+    struct FSearchContext
+    {
+        /** UTF-8 text, empty for any line */
+        TArray<uint8> Text;
+        int64 FromTicks;
+        int64 ToTicks;
+        ELogVerbosity::Type MaxVerbosity;
+        const TArray<FString>* Categories;
+        int32 MaxLines;
+        bool bTail;
+    };
+
+    /** Timestamp, verbosity and category of a line */
+    struct FLineInfo
+    {
+        int64 Ticks;
+        ELogVerbosity::Type Verbosity;
+        /** UTF-8 category printed in the line, nullptr if it has none */
+        const uint8* Category;
+        int32 CategoryLength;
+    };
+
+    /** Wildcard match of categories, remembering the last one as lines of a category tend to come in runs */
+    class FCategoryMatcher
+    {
+    public:
+        explicit FCategoryMatcher(const TArray<FString>& InPatterns)
+            : Patterns(InPatterns)
+            , bHasLast(false)
+            , bLastMatched(false)
+        {
+        }
+
+        bool Matches(const uint8* Name, int32 Length)
+        {
+            if (bHasLast && LastName.Num() == Length && FMemory::Memcmp(LastName.GetData(), Name, Length) == 0)
+            {
+                return bLastMatched;
+            }
+
+            LastName.Reset();
+            LastName.Append(Name, Length);
+            bHasLast = true;
+
+            const FUTF8ToTCHAR Converted((const ANSICHAR*)Name, Length);
+            const FString Category(Converted.Length(), Converted.Get());
+
+            bLastMatched = false;
+            for (const FString& Pattern : Patterns)
+            {
+                if (Category.MatchesWildcard(Pattern))
+                {
+                    bLastMatched = true;
+                    break;
+                }
+            }
+            return bLastMatched;
+        }
+
+    private:
+        const TArray<FString>& Patterns;
+        TArray<uint8> LastName;
+        bool bHasLast;
+        bool bLastMatched;
+    };
+
+    /** First occurrence of Needle in [Begin, End), nullptr if there is none */
+    const uint8* FindBytes(const uint8* Begin, const uint8* End, const uint8* Needle, int32 NeedleLength)
+    {
+        const uint8* Cursor = Begin;
+
+#if LOGMANAGER_WITH_SSE2
+        // The first and last byte of the needle are compared at 16 positions at once, only the positions matching both are compared whole
+        const __m128i First = _mm_set1_epi8((char)Needle[0]);
+        const __m128i Last = _mm_set1_epi8((char)Needle[NeedleLength - 1]);
+        while (End - Cursor >= NeedleLength - 1 + 16)
+        {
+            const __m128i BlockFirst = _mm_loadu_si128((const __m128i*)Cursor);
+            const __m128i BlockLast = _mm_loadu_si128((const __m128i*)(Cursor + NeedleLength - 1));
+            uint32 Candidates = (uint32)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(BlockFirst, First), _mm_cmpeq_epi8(BlockLast, Last)));
+            while (Candidates != 0)
+            {
+                const uint32 Position = FMath::CountTrailingZeros(Candidates);
+                if (NeedleLength <= 2 || FMemory::Memcmp(Cursor + Position + 1, Needle + 1, NeedleLength - 2) == 0)
+                {
+                    return Cursor + Position;
+                }
+                Candidates &= Candidates - 1;
+            }
+            Cursor += 16;
+        }
+#endif // LOGMANAGER_WITH_SSE2
+
+        // Scalar path for the tail
+        for (; End - Cursor >= NeedleLength; ++Cursor)
+        {
+            if (*Cursor == Needle[0] && FMemory::Memcmp(Cursor, Needle, NeedleLength) == 0)
+            {
+                return Cursor;
+            }
+        }
+        return nullptr;
+    }
+
+    /** The line feed ending the line Cursor is in, End if the line isn't terminated */
+    const uint8* FindLineEnd(const uint8* Cursor, const uint8* End)
+    {
+        static const uint8 LineFeed = '\n';
+        const uint8* LineEnd = FindBytes(Cursor, End, &LineFeed, 1);
+        return LineEnd ? LineEnd : End;
+    }
+
+    /** Skips the byte order mark in front of the first line of a file */
+    const uint8* SkipByteOrderMark(const uint8* FileData, const uint8* LineStart, const uint8* LineEnd)
+    {
+        if (LineStart == FileData && LineEnd - LineStart >= 3 && LineStart[0] == 0xEF && LineStart[1] == 0xBB && LineStart[2] == 0xBF)
+        {
+            return LineStart + 3;
+        }
+        return LineStart;
+    }
+
+    /** Reads the timestamp, verbosity and category of a line, false if it has no timestamp prefix */
+    bool ParseLine(const uint8* Line, int32 Length, FLineInfo& OutInfo)
+    {
+        uint32 FrameCounter = 0;
+        if (!FLogLineFormatter::ParseLinePrefix(Line, Length, OutInfo.Ticks, FrameCounter, OutInfo.Verbosity))
+        {
+            return false;
+        }
+
+        OutInfo.Category = nullptr;
+        OutInfo.CategoryLength = 0;
+
+        // Up to the first colon, unless it ends the verbosity of a line printed without category ("Warning: ")
+        const int32 NameStart = FLogLineFormatter::PrefixLength;
+        const int32 NameLimit = FMath::Min(Length, NameStart + (int32)FLogLineFormatter::MaxNameLength);
+        int32 Colon = NameStart;
+        while (Colon < NameLimit && Line[Colon] != ':' && Line[Colon] != ' ')
+        {
+            ++Colon;
+        }
+
+        const bool bNoCategory = Colon == NameLimit || Colon == NameStart || Line[Colon] != ':' ||
+            (OutInfo.Verbosity != ELogVerbosity::Log && Colon + 1 < Length && Line[Colon + 1] == ' ');
+        if (!bNoCategory)
+        {
+            OutInfo.Category = Line + NameStart;
+            OutInfo.CategoryLength = Colon - NameStart;
+        }
+        return true;
+    }
+
+    /** Timestamp, verbosity and category of a line, taken from the line it continues if it has no prefix of its own */
+    void GetLineInfo(const uint8* FileData, const uint8* LineStart, const uint8* LineEnd, FLineInfo& OutInfo)
+    {
+        if (ParseLine(LineStart, (int32)(LineEnd - LineStart), OutInfo))
+        {
+            return;
+        }
+
+        const uint8* Cursor = LineStart;
+        for (int32 Walked = 0; Walked < MaxContinuationLines && Cursor > FileData; ++Walked)
+        {
+            const uint8* PreviousEnd = Cursor - 1;
+            const uint8* PreviousStart = PreviousEnd;
+            while (PreviousStart > FileData && PreviousStart[-1] != '\n')
+            {
+                --PreviousStart;
+            }
+
+            Cursor = PreviousStart;
+
+            const uint8* PreviousText = SkipByteOrderMark(FileData, PreviousStart, PreviousEnd);
+            if (ParseLine(PreviousText, (int32)(PreviousEnd - PreviousText), OutInfo))
+            {
+                return;
+            }
+        }
+
+        OutInfo = FLineInfo{ 0, ELogVerbosity::Log, nullptr, 0 };
+    }
+
+    /** Keeps the MaxLines oldest hits, or newest if bTail */
+    void TrimHits(TArray<FSearchHit>& Hits, int32 MaxLines, bool bTail)
+    {
+        if (Hits.Num() <= MaxLines)
+        {
+            return;
+        }
+
+        Hits.Sort(FHitOrder());
+        if (bTail)
+        {
+            Hits.RemoveAt(0, Hits.Num() - MaxLines, false);
+        }
+        else
+        {
+            Hits.SetNum(MaxLines, false);
+        }
+    }
+
+    /** Cuts [Begin, End) of a file into chunks of about ChunkSize bytes, each ending at a line end */
+    void AddChunks(const FLogMappedFileReader& Reader, int32 FileIndex, int64 Begin, int64 End, TArray<FSearchChunk>& OutChunks)
+    {
+        const uint8* FileData = Reader.GetData();
+        while (Begin < End)
+        {
+            int64 ChunkEnd = FMath::Min<int64>(Begin + ChunkSize, End);
+            if (ChunkEnd < End)
+            {
+                ChunkEnd = FMath::Min<int64>(FindLineEnd(FileData + ChunkEnd, FileData + End) - FileData + 1, End);
+            }
+
+            OutChunks.Add(FSearchChunk{ FileIndex, Begin, ChunkEnd });
+            Begin = ChunkEnd;
+        }
+    }
+
+    /** Collects the matching lines starting in a chunk, holding on to MaxLines of them at most */
+    void ScanChunk(const FSearchFile& File, const FSearchChunk& Chunk, const FSearchContext& Context, TArray<FSearchHit>& OutHits, int64& OutNumMatches)
+    {
+        const uint8* FileData = File.Reader->GetData();
+        const uint8* ChunkBegin = FileData + Chunk.Begin;
+        const uint8* ChunkEnd = FileData + Chunk.End;
+        FCategoryMatcher CategoryMatcher(*Context.Categories);
+
+        const uint8* Cursor = ChunkBegin;
+        while (Cursor < ChunkEnd)
+        {
+            const uint8* LineStart = Cursor;
+            const uint8* Found = Cursor;
+            if (Context.Text.Num() > 0)
+            {
+                Found = FindBytes(Cursor, ChunkEnd, Context.Text.GetData(), Context.Text.Num());
+                if (!Found)
+                {
+                    break;
+                }
+
+                LineStart = Found;
+                while (LineStart > ChunkBegin && LineStart[-1] != '\n')
+                {
+                    --LineStart;
+                }
+            }
+
+            const uint8* LineEnd = FindLineEnd(Found, ChunkEnd);
+            Cursor = LineEnd + 1;
+
+            LineStart = SkipByteOrderMark(FileData, LineStart, LineEnd);
+            if (LineEnd > LineStart && LineEnd[-1] == '\r')
+            {
+                --LineEnd;
+            }
+            if (LineEnd == LineStart)
+            {
+                continue;
+            }
+
+            FLineInfo Info;
+            GetLineInfo(FileData, LineStart, LineEnd, Info);
+            if (Info.Ticks < Context.FromTicks || Info.Ticks > Context.ToTicks || Info.Verbosity > Context.MaxVerbosity)
+            {
+                continue;
+            }
+
+            if (Context.Categories->Num() > 0 &&
+                !(Info.Category ? CategoryMatcher.Matches(Info.Category, Info.CategoryLength) : CategoryMatcher.Matches(File.Category.GetData(), File.Category.Num())))
+            {
+                continue;
+            }
+
+            ++OutNumMatches;
+            OutHits.Add(FSearchHit{ Info.Ticks, Chunk.FileIndex, LineStart - FileData, (int32)(LineEnd - LineStart) });
+
+            // Only MaxLines hits make it overall, so no more than that is needed from any chunk either
+            if (Context.MaxLines > 0 && OutHits.Num() >= 2 * Context.MaxLines)
+            {
+                TrimHits(OutHits, Context.MaxLines, Context.bTail);
+            }
+        }
+
+        if (Context.MaxLines > 0)
+        {
+            TrimHits(OutHits, Context.MaxLines, Context.bTail);
+        }
+    }
+
+    /** "LogNet.3.log" is named after LogNet */
+    FString GetFileCategory(const FString& Filename)
+    {
+        FString Category = FPaths::GetBaseFilename(Filename);
+
+        int32 Dot = INDEX_NONE;
+        if (Category.FindLastChar(TEXT('.'), Dot) && Category.Mid(Dot + 1).IsNumeric())
+        {
+            Category = Category.Left(Dot);
+        }
+        return Category;
+    }
+}
+
+bool FLogSearch::Search(const FString& SessionDir, const FLogSearchQuery& Query, TArray<FLogSearchMatch>& OutMatches, FLogSearchStats& OutStats,
+    FLogSearchProgress* Progress)
+{
+    const double StartTime = FPlatformTime::Seconds();
+    OutStats = FLogSearchStats();
+
+    FSearchContext Context;
+    const FTCHARToUTF8 Text(*Query.Text);
+    Context.Text.Append((const uint8*)Text.Get(), Text.Length());
+    Context.FromTicks = Query.From.GetTicks();
+    Context.ToTicks = Query.To.GetTicks();
+    Context.MaxVerbosity = Query.MaxVerbosity;
+    Context.Categories = &Query.Categories;
+    Context.MaxLines = Query.MaxLines;
+    Context.bTail = Query.bTail;
+
+    // The indexes know nothing about categories or text, only time and verbosity narrow the ranges down
+    const bool bUseIndex = Query.From > FDateTime::MinValue() || Query.To < FDateTime::MaxValue() || Query.MaxVerbosity < ELogVerbosity::VeryVerbose;
+    FLogIndexQuery IndexQuery;
+    IndexQuery.From = Query.From;
+    IndexQuery.To = Query.To;
+    IndexQuery.MaxVerbosity = Query.MaxVerbosity;
+
+    TArray<FString> Filenames;
+    IFileManager::Get().FindFiles(Filenames, *(SessionDir / TEXT("*.log")), true, false);
+
+    TArray<FSearchFile> Files;
+    TArray<FSearchChunk> Chunks;
+    for (const FString& Filename : Filenames)
+    {
+        const FString Path = SessionDir / Filename;
+        FLogMappedFileReader* Reader = FLogMappedFileReader::Open(Path);
+        if (!Reader)
+        {
+            OutStats.UnreadableFiles.Add(Filename);
+            continue;
+        }
+
+        const FTCHARToUTF8 Category(*GetFileCategory(Filename));
+        FSearchFile File{ Filename, TArray<uint8>(), Reader };
+        File.Category.Append((const uint8*)Category.Get(), Category.Length());
+        const int32 FileIndex = Files.Add(MoveTemp(File));
+
+        TArray<FLogFileRange> Ranges;
+        if (!bUseIndex || !FLogIndexFormat::Query(Path, IndexQuery, Ranges))
+        {
+            Ranges.Reset();
+            Ranges.Add(FLogFileRange{ 0, Reader->GetSize() });
+        }
+
+        // The file may have grown since it was mapped, or end in zeroed pages the reader left out
+        int64 BytesScanned = 0;
+        for (const FLogFileRange& Range : Ranges)
+        {
+            const int64 RangeBegin = FMath::Min(Range.Offset, Reader->GetSize());
+            const int64 RangeEnd = FMath::Min(Range.Offset + Range.Length, Reader->GetSize());
+            AddChunks(*Reader, FileIndex, RangeBegin, RangeEnd, Chunks);
+            BytesScanned += RangeEnd - RangeBegin;
+        }
+
+        OutStats.BytesScanned += BytesScanned;
+        OutStats.BytesSkipped += Reader->GetSize() - BytesScanned;
+    }
+
+    TArray<TArray<FSearchHit>> ChunkHits;
+    ChunkHits.SetNum(Chunks.Num());
+    TArray<int64> ChunkMatches;
+    ChunkMatches.SetNumZeroed(Chunks.Num());
+
+    if (Progress)
+    {
+        FPlatformAtomics::InterlockedExchange(&Progress->BytesTotal, OutStats.BytesScanned);
+    }
+
+    ParallelFor(Chunks.Num(), [&Chunks, &Files, &Context, &ChunkHits, &ChunkMatches, Progress](int32 ChunkIndex)
+    {
+        if (Progress && Progress->bCancel)
+        {
+            return;
+        }
+
+        const FSearchChunk& Chunk = Chunks[ChunkIndex];
+        ScanChunk(Files[Chunk.FileIndex], Chunk, Context, ChunkHits[ChunkIndex], ChunkMatches[ChunkIndex]);
+
+        if (Progress)
+        {
+            FPlatformAtomics::InterlockedAdd(&Progress->BytesScanned, Chunk.End - Chunk.Begin);
+        }
+    });
+    OutStats.bCancelled = Progress && Progress->bCancel;
+
+    TArray<FSearchHit> Hits;
+    for (int32 ChunkIndex = 0; ChunkIndex < Chunks.Num(); ++ChunkIndex)
+    {
+        Hits.Append(ChunkHits[ChunkIndex]);
+        OutStats.NumMatches += ChunkMatches[ChunkIndex];
+    }
+
+    Hits.Sort(FHitOrder());
+    if (Query.MaxLines > 0)
+    {
+        TrimHits(Hits, Query.MaxLines, Query.bTail);
+    }
+
+    // Only the lines kept are turned into strings, while the files are still mapped
+    OutMatches.Reserve(OutMatches.Num() + Hits.Num());
+    for (const FSearchHit& Hit : Hits)
+    {
+        const FSearchFile& File = Files[Hit.FileIndex];
+        const FUTF8ToTCHAR Line((const ANSICHAR*)(File.Reader->GetData() + Hit.Offset), Hit.Length);
+        OutMatches.Add(FLogSearchMatch{ File.Filename, Hit.Ticks, FString(Line.Length(), Line.Get()) });
+    }
+
+    for (FSearchFile& File : Files)
+    {
+        delete File.Reader;
+    }
+
+    OutStats.NumFiles = Files.Num();
+    OutStats.Seconds = FPlatformTime::Seconds() - StartTime;
+    return Filenames.Num() > 0;
+}
+
+namespace
+{
+    /** What a LogManager.Search or LogManager.Tail command found, handed from its thread to the game thread */
+    struct FSearchCommandResult
+    {
+        FString SessionDir;
+        /** Empty to print the lines */
+        FString OutputFilename;
+        TArray<FLogSearchMatch> Matches;
+        FLogSearchStats Stats;
+        bool bFound;
+        bool bSaved;
+    };
+
+    /** The command running in the background, one at a time */
+    TFuture<void> GSearchTask;
+    FLogSearchProgress GSearchProgress;
+    /** Set by FLogSearch::CancelCommand, nothing is printed once the module is going away */
+    volatile int32 GSearchShutdown = 0;
+
+    bool IsSearchRunning()
+    {
+        return GSearchTask.IsValid() && !GSearchTask.IsReady();
+    }
+
+    /** Writes the lines found to OutputFilename, on the search thread */
+    bool SaveSearchResult(const FSearchCommandResult& Result)
+    {
+        FString Output;
+        for (const FLogSearchMatch& Match : Result.Matches)
+        {
+            Output += Match.Filename;
+            Output += TEXT(": ");
+            Output += Match.Line;
+            Output += LINE_TERMINATOR;
+        }
+
+        return FFileHelper::SaveStringToFile(Output, *Result.OutputFilename, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM);
+    }
+
+    /** Prints what a command found to the log, on the game thread. The console that ran the command may be gone by now. */
+    void PrintSearchResult(const FSearchCommandResult& Result)
+    {
+        static const FName SearchCategory(TEXT("LogManager"));
+
+        for (const FString& Filename : Result.Stats.UnreadableFiles)
+        {
+            GLog->Log(SearchCategory, ELogVerbosity::Warning, FString::Printf(TEXT("Couldn't open %s, it wasn't searched"), *Filename));
+        }
+
+        if (!Result.bFound)
+        {
+            GLog->Log(SearchCategory, ELogVerbosity::Display, FString::Printf(TEXT("No text log file in %s"), *Result.SessionDir));
+            return;
+        }
+
+        if (Result.OutputFilename.IsEmpty())
+        {
+            for (const FLogSearchMatch& Match : Result.Matches)
+            {
+                GLog->Log(SearchCategory, ELogVerbosity::Display, FString::Printf(TEXT("%s: %s"), *Match.Filename, *Match.Line));
+            }
+        }
+        else if (!Result.bSaved)
+        {
+            GLog->Log(SearchCategory, ELogVerbosity::Warning, FString::Printf(TEXT("Failed to write %s"), *Result.OutputFilename));
+        }
+
+        const FLogSearchStats& Stats = Result.Stats;
+        const double MB = 1024.0 * 1024.0;
+        GLog->Log(SearchCategory, ELogVerbosity::Display, FString::Printf(
+            TEXT("%s%lld matching lines, %d shown, in %d files of %s: %.1f MB scanned, %.1f MB skipped by the indexes, %d files unreadable, %.2f s"),
+            Stats.bCancelled ? TEXT("Cancelled, ") : TEXT(""), Stats.NumMatches, Result.Matches.Num(), Stats.NumFiles, *Result.SessionDir,
+            Stats.BytesScanned / MB, Stats.BytesSkipped / MB, Stats.UnreadableFiles.Num(), Stats.Seconds));
+    }
+
+    /**
+     * Runs LogManager.Search and LogManager.Tail. Key=Value arguments set the filters, every other argument is
+     * part of the text looked for.
+     */
+    void RunSearchCommand(const TArray<FString>& Args, FOutputDevice& Ar, bool bTail, int32 DefaultMaxLines)
+    {
+        const bool bStatus = Args.Num() == 1 && Args[0].Equals(TEXT("Status"), ESearchCase::IgnoreCase);
+        const bool bCancel = Args.Num() == 1 && Args[0].Equals(TEXT("Cancel"), ESearchCase::IgnoreCase);
+
+        if (!IsSearchRunning())
+        {
+            if (bStatus || bCancel)
+            {
+                Ar.Log(TEXT("No search is running"));
+                return;
+            }
+        }
+        else if (bCancel)
+        {
+            FPlatformAtomics::InterlockedExchange(&GSearchProgress.bCancel, 1);
+            Ar.Log(TEXT("Cancelling the search, what it found so far is printed"));
+            return;
+        }
+        else
+        {
+            const int64 BytesTotal = GSearchProgress.BytesTotal;
+            Ar.Logf(TEXT("%s: %.1f of %.1f MB scanned. LogManager.Search Cancel stops it."),
+                bStatus ? TEXT("Searching") : TEXT("A search is already running"),
+                GSearchProgress.BytesScanned / (1024.0 * 1024.0), BytesTotal / (1024.0 * 1024.0));
+            return;
+        }
+
+        FLogSearchQuery Query;
+        Query.bTail = bTail;
+        Query.MaxLines = DefaultMaxLines;
+
+        const FString CurrentLogDir = ILogManager::Get().GetCurrentLogDir();
+        FString SessionDir = CurrentLogDir;
+        FString OutputFilename;
+        TArray<FString> Words;
+
+        for (const FString& Arg : Args)
+        {
+            FString Key;
+            FString Value;
+            if (!Arg.Split(TEXT("="), &Key, &Value))
+            {
+                if (Arg.Equals(TEXT("Tail"), ESearchCase::IgnoreCase))
+                {
+                    Query.bTail = true;
+                }
+                else
+                {
+                    Words.Add(Arg);
+                }
+            }
+            else if (Key.Equals(TEXT("Dir"), ESearchCase::IgnoreCase))
+            {
+                // A session folder name is enough, it's looked for next to the current session
+                SessionDir = FPaths::IsRelative(Value) && !FPaths::DirectoryExists(Value) ? FPaths::GetPath(CurrentLogDir) / Value : Value;
+            }
+            else if (Key.Equals(TEXT("From"), ESearchCase::IgnoreCase) || Key.Equals(TEXT("To"), ESearchCase::IgnoreCase))
+            {
+                FDateTime& Time = Key.Equals(TEXT("From"), ESearchCase::IgnoreCase) ? Query.From : Query.To;
+                if (!FDateTime::Parse(Value, Time))
+                {
+                    Ar.Logf(TEXT("Can't read %s, times are written YYYY.MM.DD-HH.MM.SS"), *Value);
+                    return;
+                }
+            }
+            else if (Key.Equals(TEXT("Last"), ESearchCase::IgnoreCase))
+            {
+                Query.From = FDateTime::Now() - FTimespan::FromSeconds(FCString::Atod(*Value));
+            }
+            else if (Key.Equals(TEXT("Category"), ESearchCase::IgnoreCase))
+            {
+                Value.ParseIntoArray(Query.Categories, TEXT(","), true);
+            }
+            else if (Key.Equals(TEXT("Verbosity"), ESearchCase::IgnoreCase))
+            {
+                Query.MaxVerbosity = ParseLogVerbosityFromString(Value);
+            }
+            else if (Key.Equals(TEXT("Max"), ESearchCase::IgnoreCase) || Key.Equals(TEXT("Lines"), ESearchCase::IgnoreCase))
+            {
+                Query.MaxLines = FMath::Max(FCString::Atoi(*Value), 0);
+            }
+            else if (Key.Equals(TEXT("Output"), ESearchCase::IgnoreCase))
+            {
+                OutputFilename = Value;
+            }
+            else
+            {
+                Words.Add(Arg);
+            }
+        }
+        Query.Text = FString::Join(Words, TEXT(" ")).TrimQuotes();
+
+        // Lines still queued for the current session
+        ILogManager::Get().WaitForFlush(ILogManager::Get().RequestFlush(), 1000);
+
+        // A whole session can be gigabytes, the search runs on a thread of its own and the lines are printed when it's done
+        FPlatformAtomics::InterlockedExchange(&GSearchProgress.BytesTotal, 0);
+        FPlatformAtomics::InterlockedExchange(&GSearchProgress.BytesScanned, 0);
+        FPlatformAtomics::InterlockedExchange(&GSearchProgress.bCancel, 0);
+
+        GSearchTask = Async<void>(EAsyncExecution::Thread, [SessionDir, Query, OutputFilename]()
+        {
+            TSharedPtr<FSearchCommandResult, ESPMode::ThreadSafe> Result = MakeShareable(new FSearchCommandResult());
+            Result->SessionDir = SessionDir;
+            Result->OutputFilename = OutputFilename;
+            Result->bFound = FLogSearch::Search(SessionDir, Query, Result->Matches, Result->Stats, &GSearchProgress);
+            Result->bSaved = OutputFilename.IsEmpty() || SaveSearchResult(*Result);
+
+            if (!GSearchShutdown)
+            {
+                AsyncTask(ENamedThreads::GameThread, [Result]()
+                {
+                    PrintSearchResult(*Result);
+                });
+            }
+        });
+
+        Ar.Logf(TEXT("Searching %s, the lines are printed once it's done. LogManager.Search Status shows how far it got, LogManager.Search Cancel stops it."), *SessionDir);
+    }
+}
+
+void FLogSearch::CancelCommand()
+{
+    if (GSearchTask.IsValid())
+    {
+        FPlatformAtomics::InterlockedExchange(&GSearchShutdown, 1);
+        FPlatformAtomics::InterlockedExchange(&GSearchProgress.bCancel, 1);
+        GSearchTask.Wait();
+        GSearchTask = TFuture<void>();
+    }
+}
+
+/** Searches a session, e.g. "LogManager.Search Category=LogNet* Verbosity=Warning Last=600 connection lost" */
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogSearchCommand(
+    TEXT("LogManager.Search"),
+    TEXT("Searches every text log file of a session and prints the lines in timestamp order. Usage: LogManager.Search [Dir=Session] [From=YYYY.MM.DD-HH.MM.SS] [To=YYYY.MM.DD-HH.MM.SS] [Last=Seconds] [Category=Pattern[,Pattern...]] [Verbosity=Level] [Max=Lines] [Tail] [Output=File] [Text]. The search runs in the background, LogManager.Search Status|Cancel shows or stops it."),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+    {
+        RunSearchCommand(Args, Ar, false, 1000);
+    }));
+
+/** The newest lines of a session across its files, e.g. "LogManager.Tail Lines=100 Verbosity=Error" */
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogTailCommand(
+    TEXT("LogManager.Tail"),
+    TEXT("Prints the newest lines of every text log file of a session in timestamp order. Usage: LogManager.Tail [Lines=N] [Dir=Session] [From=YYYY.MM.DD-HH.MM.SS] [To=YYYY.MM.DD-HH.MM.SS] [Last=Seconds] [Category=Pattern[,Pattern...]] [Verbosity=Level] [Output=File] [Text]. The search runs in the background, LogManager.Tail Status|Cancel shows or stops it."),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& Args, UWorld*, FOutputDevice& Ar)
+    {
+        RunSearchCommand(Args, Ar, true, 50);
+    }));
@@ -0,0 +1,117 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "Containers/Array.h"
+#include "Containers/UnrealString.h"
+#include "Logging/LogVerbosity.h"
+#include "Misc/DateTime.h"
+
+/** What FLogSearch looks for, a line has to match every field */
+struct FLogSearchQuery
+{
+    /** Text the line has to contain, case sensitive, empty for any line */
+    FString Text;
+    /** Time range, local time like the timestamps printed in the log */
+    FDateTime From;
+    FDateTime To;
+    /** Wildcard patterns of the categories wanted, empty for every category */
+    TArray<FString> Categories;
+    /** Least severe verbosity wanted */
+    ELogVerbosity::Type MaxVerbosity;
+    /** Most lines returned, 0 for no limit */
+    int32 MaxLines;
+    /** Whether the newest MaxLines lines are returned rather than the oldest */
+    bool bTail;
+
+    FLogSearchQuery()
+        : From(FDateTime::MinValue())
+        , To(FDateTime::MaxValue())
+        , MaxVerbosity(ELogVerbosity::VeryVerbose)
+        , MaxLines(0)
+        , bTail(false)
+    {
+    }
+};
+
+/** A line found by FLogSearch */
+struct FLogSearchMatch
+{
+    /** Log file the line is in, without its directory */
+    FString Filename;
+    /** FDateTime ticks of the line, 0 if it has no timestamp */
+    int64 Ticks;
+    FString Line;
+};
+
+/** What a search went through */
+struct FLogSearchStats
+{
+    int32 NumFiles;
+    /** Bytes scanned, and bytes the sidecar indexes ruled out */
+    int64 BytesScanned;
+    int64 BytesSkipped;
+    /** Lines matching the query, MaxLines left aside */
+    int64 NumMatches;
+    double Seconds;
+    /** Log files that couldn't be opened, without their directory */
+    TArray<FString> UnreadableFiles;
+    /** Whether the search was cancelled before it scanned everything */
+    bool bCancelled;
+
+    FLogSearchStats()
+        : NumFiles(0)
+        , BytesScanned(0)
+        , BytesSkipped(0)
+        , NumMatches(0)
+        , Seconds(0.0)
+        , bCancelled(false)
+    {
+    }
+};
+
+/** How far a search running on another thread got, and the way to stop it */
+struct FLogSearchProgress
+{
+    /** Bytes to scan, known once every file is opened */
+    volatile int64 BytesTotal;
+    volatile int64 BytesScanned;
+    /** Set to stop the search, the chunks not started yet are left out */
+    volatile int32 bCancel;
+
+    FLogSearchProgress()
+        : BytesTotal(0)
+        , BytesScanned(0)
+        , bCancel(0)
+    {
+    }
+};
+
+/**
+ * Searches the text log files of a session directory, the "grep | sort" over every category file done in one go.
+ *
+ * The files are mapped and cut into line aligned chunks scanned in parallel, the text is looked for 16 bytes at a
+ * time with SSE2 where available. The sidecar indexes (FLogIndexFormat) rule out the blocks outside the time range
+ * or without the verbosities wanted before anything is read. Lines are then merged across files in timestamp
+ * order, lines with the same timestamp keep their file order. Lines without a timestamp, the continuation lines
+ * of a multi-line message, take the timestamp, verbosity and category of the line they continue.
+ *
+ * Binary and compressed log files aren't searched, decode them to text first.
+ */
+class FLogSearch
+{
+public:
+    /**
+     * @param SessionDir - directory holding the log files
+     * @param Query - what to look for
+     * @param OutMatches - receives the matching lines in timestamp order
+     * @param OutStats - receives what the search went through
+     * @param Progress - updated as the chunks are scanned and checked for cancellation, may be nullptr
+     * @return false if SessionDir holds no text log file
+     */
+    static bool Search(const FString& SessionDir, const FLogSearchQuery& Query, TArray<FLogSearchMatch>& OutMatches, FLogSearchStats& OutStats,
+        FLogSearchProgress* Progress = nullptr);
+
+    /** Stops the LogManager.Search or LogManager.Tail command running in the background, if any, and waits for it */
+    static void CancelCommand();
+};
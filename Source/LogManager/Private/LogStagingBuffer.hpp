@@ -0,0 +1,197 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "HAL/PlatformAtomics.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/UnrealMemory.h"
+#include "Containers/Array.h"
+
+/** Header in front of every staged line. Lines are stored back to back, each padded to LineAlignment. */
+struct FLogStagedLineHeader
+{
+    /** Position of the line in the writer's global order */
+    int64 Sequence;
+    /** Payload length in bytes */
+    int32 Length;
+    /** Keeps the payload 8 byte aligned */
+    int32 Padding;
+};
+
+/** A staged line as seen by the writer thread while merging batches */
+struct FLogStagedLine
+{
+    int64 Sequence;
+    const uint8* Data;
+    int32 Length;
+};
+
+/**
+ * Per-thread staging buffer of a single writer.
+ *
+ * Only the owning thread appends to it, so lines are staged without touching any shared cache line.
+ * The writer thread may steal the staged lines of a thread that went quiet, the State flag makes sure
+ * the two never work on the buffer at the same time. FirstStagedSequence is read by the writer to know
+ * which sequence numbers may still be hiding in here.
+ */
+class FLogStagingBuffer
+{
+public:
+    enum EState
+    {
+        Idle = 0,
+        Producing = 1,
+        Stealing = 2
+    };
+
+    enum EConstants
+    {
+        LineAlignment = 8
+    };
+
+    explicit FLogStagingBuffer(int32 InCapacity)
+        : Used(0)
+        , NumLines(0)
+        , FirstStagedCycles(0)
+        , State(Idle)
+        , FirstStagedSequence(MAX_int64)
+    {
+        Data.AddUninitialized(InCapacity);
+    }
+
+    /** Bytes taken by a staged line of Length bytes */
+    static int32 GetLineSpan(int64 Length)
+    {
+        return (int32)((sizeof(FLogStagedLineHeader) + Length + LineAlignment - 1) & ~(int64)(LineAlignment - 1));
+    }
+
+    /** Appends the lines stored in Source (back to back, as written by AppendWith) to OutLines */
+    static void ParseLines(const uint8* Source, int32 Length, TArray<FLogStagedLine>& OutLines)
+    {
+        int32 Offset = 0;
+        while (Offset < Length)
+        {
+            const FLogStagedLineHeader* Header = (const FLogStagedLineHeader*)(Source + Offset);
+            OutLines.Add(FLogStagedLine{ Header->Sequence, (const uint8*)(Header + 1), Header->Length });
+            Offset += GetLineSpan(Header->Length);
+        }
+    }
+
+    /** Tries to take exclusive access to the buffer */
+    bool TryAcquire(EState As)
+    {
+        return FPlatformAtomics::InterlockedCompareExchange(&State, (int32)As, (int32)Idle) == (int32)Idle;
+    }
+
+    /** Gives up exclusive access to the buffer */
+    void Release()
+    {
+        FPlatformAtomics::InterlockedExchange(&State, (int32)Idle);
+    }
+
+    bool IsEmpty() const
+    {
+        return Used == 0;
+    }
+
+    int32 GetUsed() const
+    {
+        return Used;
+    }
+
+    int32 GetNumLines() const
+    {
+        return NumLines;
+    }
+
+    const uint8* GetData() const
+    {
+        return Data.GetData();
+    }
+
+    /** Cycle counter at the time the oldest staged line was appended */
+    uint64 GetFirstStagedCycles() const
+    {
+        return FirstStagedCycles;
+    }
+
+    /** Lower bound of the sequence numbers staged in here, MAX_int64 if there are none */
+    int64 GetFirstStagedSequence() const
+    {
+        const int64 Value = FirstStagedSequence;
+        FPlatformMisc::MemoryBarrier();
+        return Value;
+    }
+
+    bool HasRoomFor(int64 Length) const
+    {
+        return Used + GetLineSpan(Length) <= Data.Num();
+    }
+
+    /**
+     * Announces that a line is about to be staged. Must be called before its sequence number is taken,
+     * with a value not greater than that number, so the writer never emits a later line ahead of it.
+     */
+    void BeginLine(int64 SequenceLowerBound, uint64 Cycles)
+    {
+        if (Used == 0)
+        {
+            FirstStagedCycles = Cycles;
+            FPlatformAtomics::InterlockedExchange(&FirstStagedSequence, SequenceLowerBound);
+        }
+    }
+
+    /**
+     * Appends a line whose payload is written by Fill(uint8* Dest), which returns the number of bytes written.
+     * There must be room for the largest payload Fill may write.
+     */
+    template<typename FillerType>
+    void AppendWith(int64 Sequence, FillerType&& Fill)
+    {
+        Used += WriteLineWith(Data.GetData() + Used, Sequence, Fill);
+        ++NumLines;
+    }
+
+    /** Writes a single line record to Dest and returns the bytes taken. Payload is written by Fill(uint8* Dest). */
+    template<typename FillerType>
+    static int32 WriteLineWith(uint8* Dest, int64 Sequence, FillerType&& Fill)
+    {
+        FLogStagedLineHeader* Header = (FLogStagedLineHeader*)Dest;
+        Header->Sequence = Sequence;
+        Header->Length = Fill((uint8*)(Header + 1));
+        Header->Padding = 0;
+        return GetLineSpan(Header->Length);
+    }
+
+    /** Writes a single line record to Dest, which must have room for GetLineSpan(Length) bytes */
+    static void WriteLine(uint8* Dest, int64 Sequence, const uint8* Line, int32 Length)
+    {
+        WriteLineWith(Dest, Sequence, [Line, Length](uint8* Payload)
+        {
+            FMemory::Memcpy(Payload, Line, Length);
+            return Length;
+        });
+    }
+
+    /** Forgets the staged lines once they are safely in the writer's hands */
+    void Reset()
+    {
+        Used = 0;
+        NumLines = 0;
+        FPlatformAtomics::InterlockedExchange(&FirstStagedSequence, MAX_int64);
+    }
+
+private:
+    /** Staged line records */
+    TArray<uint8> Data;
+    /** Bytes used in Data */
+    int32 Used;
+    /** Number of lines staged */
+    int32 NumLines;
+    /** Cycle counter at the time the oldest staged line was appended */
+    uint64 FirstStagedCycles;
+    /** EState, who is allowed to touch the buffer */
+    volatile int32 State;
+    /** Lower bound of the staged sequence numbers, MAX_int64 when empty */
+    volatile int64 FirstStagedSequence;
+};
@@ -0,0 +1,168 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "HAL/PlatformAtomics.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/ThreadSingleton.h"
+#include "Misc/DateTime.h"
+
+/**
+ * Cheap local time and timestamp text for log lines.
+ *
+ * The local time is derived from the cycle counter against a base sampled with FDateTime::Now(), which is
+ * re-sampled every few seconds so the clock follows wall clock adjustments. The "[YYYY.MM.DD-HH.MM.SS:"
+ * part of the timestamp is formatted once per second and thread, only the milliseconds are patched in.
+ */
+class FLogTimestampCache
+{
+    enum EConstants
+    {
+        /** Seconds between two samples of the wall clock */
+        CalibrationIntervalSec = 10,
+        /** Length of "[YYYY.MM.DD-HH.MM.SS:" */
+        SecondPrefixLength = 21
+    };
+
+    struct FCalibration
+    {
+        /** FDateTime ticks sampled at BaseCycles */
+        int64 BaseTicks;
+        /** Cycle counter sampled with BaseTicks */
+        uint64 BaseCycles;
+        /** FDateTime ticks per cycle */
+        double TicksPerCycle;
+    };
+
+    /** Formatted timestamp of the last second seen by a thread */
+    struct FThreadPrefix : public TThreadSingleton<FThreadPrefix>
+    {
+        FThreadPrefix()
+            : Second(-1)
+        {
+        }
+
+        /** Whole seconds (FDateTime ticks / TicksPerSecond) of the cached text */
+        int64 Second;
+        /** "[YYYY.MM.DD-HH.MM.SS:" of Second */
+        uint8 Text[SecondPrefixLength];
+    };
+
+public:
+    /** Current local time in FDateTime ticks, same clock as FDateTime::Now() */
+    static int64 NowTicks()
+    {
+        return Get().GetTicks(FPlatformTime::Cycles64());
+    }
+
+    /** Writes "[YYYY.MM.DD-HH.MM.SS:mmm]" for Ticks, the same text as ToString(TEXT("%Y.%m.%d-%H.%M.%S:%s")) */
+    static uint8* WriteTimestamp(uint8* Out, int64 Ticks)
+    {
+        const int64 Second = Ticks / ETimespan::TicksPerSecond;
+
+        FThreadPrefix& Prefix = FThreadPrefix::Get();
+        if (Prefix.Second != Second)
+        {
+            FormatSecondPrefix(Prefix.Text, FDateTime(Second * ETimespan::TicksPerSecond));
+            Prefix.Second = Second;
+        }
+
+        FMemory::Memcpy(Out, Prefix.Text, SecondPrefixLength);
+        Out += SecondPrefixLength;
+
+        uint32 Millisecond = (uint32)((Ticks % ETimespan::TicksPerSecond) / ETimespan::TicksPerMillisecond);
+        Out[2] = (uint8)('0' + Millisecond % 10);
+        Millisecond /= 10;
+        Out[1] = (uint8)('0' + Millisecond % 10);
+        Millisecond /= 10;
+        Out[0] = (uint8)('0' + Millisecond % 10);
+        Out[3] = ']';
+        return Out + 4;
+    }
+
+private:
+    FLogTimestampCache()
+        : CurrentCalibration(0)
+        , bCalibrating(0)
+    {
+        Calibrate(Calibrations[0]);
+        CalibrationIntervalCycles = (uint64)(CalibrationIntervalSec / FPlatformTime::GetSecondsPerCycle64());
+    }
+
+    static FLogTimestampCache& Get()
+    {
+        static FLogTimestampCache Instance;
+        return Instance;
+    }
+
+    static void Calibrate(FCalibration& Calibration)
+    {
+        Calibration.BaseCycles = FPlatformTime::Cycles64();
+        Calibration.BaseTicks = FDateTime::Now().GetTicks();
+        Calibration.TicksPerCycle = FPlatformTime::GetSecondsPerCycle64() * ETimespan::TicksPerSecond;
+    }
+
+    int64 GetTicks(uint64 Cycles)
+    {
+        const FCalibration* Calibration = &Calibrations[CurrentCalibration];
+        FPlatformMisc::MemoryBarrier();
+
+        if ((int64)(Cycles - Calibration->BaseCycles) > (int64)CalibrationIntervalCycles &&
+            FPlatformAtomics::InterlockedCompareExchange(&bCalibrating, 1, 0) == 0)
+        {
+            // Fill the unused slot and flip, readers still holding the old slot see consistent values
+            const int32 NextCalibration = 1 - CurrentCalibration;
+            Calibrate(Calibrations[NextCalibration]);
+            FPlatformMisc::MemoryBarrier();
+            CurrentCalibration = NextCalibration;
+            FPlatformAtomics::InterlockedExchange(&bCalibrating, 0);
+
+            Calibration = &Calibrations[NextCalibration];
+            Cycles = FMath::Max(Cycles, Calibration->BaseCycles);
+        }
+
+        return Calibration->BaseTicks + (int64)((double)(int64)(Cycles - Calibration->BaseCycles) * Calibration->TicksPerCycle);
+    }
+
+    static void FormatSecondPrefix(uint8* Out, const FDateTime& Timestamp)
+    {
+        int32 Year = 0;
+        int32 Month = 0;
+        int32 Day = 0;
+        Timestamp.GetDate(Year, Month, Day);
+
+        *Out++ = '[';
+        Out = WriteDigits(Out, Year, 4);
+        *Out++ = '.';
+        Out = WriteDigits(Out, Month, 2);
+        *Out++ = '.';
+        Out = WriteDigits(Out, Day, 2);
+        *Out++ = '-';
+        Out = WriteDigits(Out, Timestamp.GetHour(), 2);
+        *Out++ = '.';
+        Out = WriteDigits(Out, Timestamp.GetMinute(), 2);
+        *Out++ = '.';
+        Out = WriteDigits(Out, Timestamp.GetSecond(), 2);
+        *Out++ = ':';
+    }
+
+    /** Writes Value zero padded to Width digits */
+    static uint8* WriteDigits(uint8* Out, uint32 Value, int32 Width)
+    {
+        for (int32 Index = Width - 1; Index >= 0; --Index)
+        {
+            Out[Index] = (uint8)('0' + Value % 10);
+            Value /= 10;
+        }
+        return Out + Width;
+    }
+
+    /** Double buffered calibration, CurrentCalibration indexes the live one */
+    FCalibration Calibrations[2];
+    volatile int32 CurrentCalibration;
+    /** Set while a thread re-samples the wall clock */
+    volatile int32 bCalibrating;
+    /** Cycles between two samples of the wall clock */
+    uint64 CalibrationIntervalCycles;
+};
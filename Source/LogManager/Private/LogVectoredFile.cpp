@@ -0,0 +1,195 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#include "LogManagerPrivatePCH.h"
+
+#include "HAL/FileManager.h"
+
+#if LOGMANAGER_WITH_PWRITEV
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+#endif // LOGMANAGER_WITH_PWRITEV
+
+#if LOGMANAGER_WITH_PWRITEV
+
+FLogVectoredFileArchive* FLogVectoredFileArchive::Create(const FString& Filename)
+{
+    IFileManager::Get().MakeDirectory(*FPaths::GetPath(Filename), true);
+
+    const FString AbsoluteFilename = IFileManager::Get().ConvertToAbsolutePathForExternalAppForWrite(*Filename);
+    const int32 FileHandle = open(TCHAR_TO_UTF8(*AbsoluteFilename), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0644);
+    if (FileHandle < 0)
+    {
+        return nullptr;
+    }
+
+    return new FLogVectoredFileArchive(Filename, FileHandle);
+}
+
+FLogVectoredFileArchive::FLogVectoredFileArchive(const FString& InFilename, int32 InFileHandle)
+    : Filename(InFilename)
+    , FileHandle(InFileHandle)
+    , FileOffset(0)
+{
+    ArIsSaving = true;
+    Batch.Reserve(BatchSize);
+}
+
+FLogVectoredFileArchive::~FLogVectoredFileArchive()
+{
+    Close();
+}
+
+void FLogVectoredFileArchive::Serialize(void* Data, int64 Length)
+{
+    if (Length >= DirectWriteSize)
+    {
+        Submit((const uint8*)Data, Length);
+        return;
+    }
+
+    if (Batch.Num() + Length > BatchSize)
+    {
+        Submit(nullptr, 0);
+    }
+    Batch.Append((const uint8*)Data, (int32)Length);
+}
+
+void FLogVectoredFileArchive::Submit(const uint8* DirectData, int64 DirectLength)
+{
+    iovec Vectors[2];
+    int32 NumVectors = 0;
+
+    if (Batch.Num() > 0)
+    {
+        Vectors[NumVectors].iov_base = Batch.GetData();
+        Vectors[NumVectors].iov_len = Batch.Num();
+        ++NumVectors;
+    }
+
+    if (DirectLength > 0)
+    {
+        Vectors[NumVectors].iov_base = (void*)DirectData;
+        Vectors[NumVectors].iov_len = DirectLength;
+        ++NumVectors;
+    }
+
+    iovec* Pending = Vectors;
+    while (NumVectors > 0 && FileHandle >= 0)
+    {
+        const ssize_t Written = pwritev(FileHandle, Pending, NumVectors, FileOffset);
+        if (Written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            ArIsError = true;
+            break;
+        }
+        FileOffset += Written;
+
+        // Partial write, skip what made it to the file
+        size_t Remaining = Written;
+        while (NumVectors > 0 && Remaining >= Pending->iov_len)
+        {
+            Remaining -= Pending->iov_len;
+            ++Pending;
+            --NumVectors;
+        }
+        if (NumVectors > 0)
+        {
+            Pending->iov_base = (uint8*)Pending->iov_base + Remaining;
+            Pending->iov_len -= Remaining;
+        }
+    }
+
+    Batch.Reset();
+}
+
+void FLogVectoredFileArchive::Flush()
+{
+    if (Batch.Num() > 0)
+    {
+        Submit(nullptr, 0);
+    }
+}
+
+bool FLogVectoredFileArchive::Close()
+{
+    if (FileHandle >= 0)
+    {
+        Flush();
+        close(FileHandle);
+        FileHandle = -1;
+    }
+    return !ArIsError;
+}
+
+int64 FLogVectoredFileArchive::Tell()
+{
+    return FileOffset + Batch.Num();
+}
+
+int64 FLogVectoredFileArchive::TotalSize()
+{
+    return Tell();
+}
+
+FString FLogVectoredFileArchive::GetArchiveName() const
+{
+    return Filename;
+}
+
+#else
+
+FLogVectoredFileArchive* FLogVectoredFileArchive::Create(const FString& Filename)
+{
+    return nullptr;
+}
+
+FLogVectoredFileArchive::FLogVectoredFileArchive(const FString& InFilename, int32 InFileHandle)
+    : Filename(InFilename)
+    , FileHandle(InFileHandle)
+    , FileOffset(0)
+{
+}
+
+FLogVectoredFileArchive::~FLogVectoredFileArchive()
+{
+}
+
+void FLogVectoredFileArchive::Serialize(void* Data, int64 Length)
+{
+}
+
+void FLogVectoredFileArchive::Submit(const uint8* DirectData, int64 DirectLength)
+{
+}
+
+void FLogVectoredFileArchive::Flush()
+{
+}
+
+bool FLogVectoredFileArchive::Close()
+{
+    return false;
+}
+
+int64 FLogVectoredFileArchive::Tell()
+{
+    return 0;
+}
+
+int64 FLogVectoredFileArchive::TotalSize()
+{
+    return 0;
+}
+
+FString FLogVectoredFileArchive::GetArchiveName() const
+{
+    return Filename;
+}
+
+#endif // LOGMANAGER_WITH_PWRITEV
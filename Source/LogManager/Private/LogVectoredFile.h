@@ -0,0 +1,61 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "Containers/Array.h"
+#include "Containers/UnrealString.h"
+#include "Serialization/Archive.h"
+
+#if PLATFORM_LINUX
+    #define LOGMANAGER_WITH_PWRITEV 1
+#else
+    #define LOGMANAGER_WITH_PWRITEV 0
+#endif
+
+/**
+ * Log file written with positioned vectored writes (pwritev).
+ *
+ * Small writes, the log lines, are gathered in a large batch buffer. Large writes aren't copied: they go out
+ * together with the batched bytes in front of them, as the second vector of the same pwritev. A batch is
+ * submitted once the buffer is full, on Flush() and when the archive is closed, so a burst of lines costs one
+ * syscall per BatchSize bytes instead of one per small file writer buffer.
+ */
+class FLogVectoredFileArchive : public FArchive
+{
+public:
+    enum EConstants
+    {
+        /** Bytes gathered before a batch is submitted */
+        BatchSize = 1024 * 1024,
+        /** Writes at least this big skip the batch buffer */
+        DirectWriteSize = 64 * 1024
+    };
+
+    /** Creates Filename, nullptr if the platform or the file doesn't allow it */
+    static FLogVectoredFileArchive* Create(const FString& Filename);
+
+    virtual ~FLogVectoredFileArchive();
+
+    //~ Begin FArchive Interface.
+    virtual void Serialize(void* Data, int64 Length) override;
+    /** Submits the batched bytes */
+    virtual void Flush() override;
+    virtual bool Close() override;
+    virtual int64 Tell() override;
+    virtual int64 TotalSize() override;
+    virtual FString GetArchiveName() const override;
+    //~ End FArchive Interface
+
+private:
+    FLogVectoredFileArchive(const FString& InFilename, int32 InFileHandle);
+
+    /** Writes the batch, followed by DirectLength bytes of DirectData, with as few pwritev calls as the kernel allows */
+    void Submit(const uint8* DirectData, int64 DirectLength);
+
+    FString Filename;
+    int32 FileHandle;
+    /** File offset of the first batched byte */
+    int64 FileOffset;
+    /** Bytes waiting for the next submission */
+    TArray<uint8> Batch;
+};
@@ -0,0 +1,109 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "HAL/PlatformAtomics.h"
+#include "HAL/PlatformTime.h"
+
+#include "ILogManager.h"
+
+/**
+ * Telemetry of one log writer, always on.
+ *
+ * Nothing here is touched per line by the logging threads: lines and bytes are counted by whoever holds the
+ * archive lock, which is the writer thread in steady state, and the client side counters only move on slow
+ * paths (a stall, a full queue, a spill, a drop). Readers take a racy snapshot, every field is read whole.
+ */
+struct FLogWriterCounters
+{
+    /** [ARCHIVE LOCK] */
+    int64 LinesWritten;
+    /** [ARCHIVE LOCK] */
+    int64 BytesWritten;
+    /** [ARCHIVE LOCK] */
+    int64 BufferResizes;
+    /** [ARCHIVE LOCK] */
+    int64 ArchiveFlushes;
+    /** [ARCHIVE LOCK] */
+    uint64 ArchiveFlushCycles;
+    /** [ARCHIVE LOCK] */
+    uint64 MaxArchiveFlushCycles;
+
+    volatile int64 PeakBufferOccupancy;
+    volatile int64 OverflowRecords;
+    volatile int64 FlushStalls;
+    volatile int64 FlushStallCycles;
+    volatile int64 FullBufferWaits;
+    volatile int64 FullBufferWaitCycles;
+    /** Lines reported by the "lines dropped" markers, the ones not reported yet are added by the writer */
+    volatile int64 DroppedLines;
+    volatile int64 RejectedLines;
+    volatile int64 SampledOutLines;
+    volatile int64 DisabledLines;
+
+    FLogWriterCounters()
+    {
+        FMemory::Memzero(this, sizeof(*this));
+    }
+
+    /** [ARCHIVE LOCK] */
+    void AddWrite(int64 Length)
+    {
+        ++LinesWritten;
+        BytesWritten += Length;
+    }
+
+    /** [ARCHIVE LOCK] */
+    void AddArchiveFlush(uint64 Cycles)
+    {
+        ++ArchiveFlushes;
+        ArchiveFlushCycles += Cycles;
+        MaxArchiveFlushCycles = FMath::Max(MaxArchiveFlushCycles, Cycles);
+    }
+
+    void AddFlushStall(uint64 Cycles)
+    {
+        FPlatformAtomics::InterlockedIncrement(&FlushStalls);
+        FPlatformAtomics::InterlockedAdd(&FlushStallCycles, (int64)Cycles);
+    }
+
+    void AddFullBufferWait(uint64 Cycles)
+    {
+        FPlatformAtomics::InterlockedIncrement(&FullBufferWaits);
+        FPlatformAtomics::InterlockedAdd(&FullBufferWaitCycles, (int64)Cycles);
+    }
+
+    void UpdatePeakOccupancy(int64 Occupancy)
+    {
+        for (int64 Peak = PeakBufferOccupancy; Occupancy > Peak; Peak = PeakBufferOccupancy)
+        {
+            if (FPlatformAtomics::InterlockedCompareExchange(&PeakBufferOccupancy, Occupancy, Peak) == Peak)
+            {
+                break;
+            }
+        }
+    }
+
+    /** Fills the counter fields of OutStats */
+    void GetStats(FLogWriterStats& OutStats) const
+    {
+        const double SecondsPerCycle = FPlatformTime::GetSecondsPerCycle64();
+
+        OutStats.LinesWritten = LinesWritten;
+        OutStats.BytesWritten = BytesWritten;
+        OutStats.PeakBufferOccupancy = PeakBufferOccupancy;
+        OutStats.BufferResizes = BufferResizes;
+        OutStats.OverflowRecords = OverflowRecords;
+        OutStats.FlushStalls = FlushStalls;
+        OutStats.FlushStallSeconds = FlushStallCycles * SecondsPerCycle;
+        OutStats.FullBufferWaits = FullBufferWaits;
+        OutStats.FullBufferWaitSeconds = FullBufferWaitCycles * SecondsPerCycle;
+        OutStats.ArchiveFlushes = ArchiveFlushes;
+        OutStats.ArchiveFlushSeconds = ArchiveFlushCycles * SecondsPerCycle;
+        OutStats.MaxArchiveFlushSeconds = MaxArchiveFlushCycles * SecondsPerCycle;
+        OutStats.DroppedLines = DroppedLines;
+        OutStats.RejectedLines = RejectedLines;
+        OutStats.SampledOutLines = SampledOutLines;
+        OutStats.DisabledLines = DisabledLines;
+    }
+};
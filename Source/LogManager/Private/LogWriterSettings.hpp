@@ -0,0 +1,139 @@
+// Copyright 2016 wang jie(newzeadev@gmail.com). All Rights Reserved.
+
+#pragma once
+
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+
+#include "ILogManager.h"
+#include "LogMappedFile.h"
+#include "LogVectoredFile.h"
+
+/** Per-writer queueing limits, read from the command line once and handed to every writer */
+struct FLogWriterSettings
+{
+    /** What to do with a line when the queue is full (-LOGBACKPRESSURE=Block|DropNewest|DropLowestVerbosity|Grow) */
+    ELogBackpressure::Type BackpressurePolicy;
+    /** How long Block waits for room before dropping the line, MAX_uint32 waits forever (-LOGBLOCKTIMEOUT=ms) */
+    uint32 BlockTimeoutMs;
+    /** Size of the ring buffer in bytes (-LOGBUFFERSIZE=KB) */
+    int32 BufferSize;
+    /** Most bytes Grow may queue on the heap once the ring buffer is full (-LOGOVERFLOWCAP=KB) */
+    int32 MaxOverflowSize;
+    /** Start a new log file segment once the current one holds this many bytes, 0 to disable (-LOGROTATESIZE=MB) */
+    int64 RotateSize;
+    /** Start a new log file segment once the current one is this old, 0 to disable (-LOGROTATEINTERVAL=seconds) */
+    double RotateIntervalSec;
+    /** Compress log segments in the background once they are rotated out (-LOGCOMPRESS) */
+    bool bCompressSegments;
+    /** Write log files as compressed frames right away (-LOGCOMPRESSLIVE) */
+    bool bCompressLive;
+    /** Write log files through a memory mapping where the platform allows it, not with live compression (-LOGMMAP) */
+    bool bMemoryMapped;
+    /** Write log files with batched pwritev calls where the platform allows it, unless they are mapped (-LOGPWRITEV) */
+    bool bVectoredIO;
+    /** Hold back lines repeating the previous line of their category and write a repeat count instead (-LOGCOALESCE) */
+    bool bCoalesceRepeats;
+    /** Longest time repeats are held back before their count is written (-LOGREPEATINTERVAL=seconds) */
+    double RepeatIntervalSec;
+    /** Bytes of lines per entry of the sidecar index of text log files, 0 to write no index (-LOGINDEXKB=KB) */
+    int32 IndexBlockSize;
+    /** Write FLogBinaryFormat records instead of text, picked per category by the manager (-LOGBINARY) */
+    bool bBinary;
+
+    FLogWriterSettings()
+        : BackpressurePolicy(ELogBackpressure::Block)
+        , BlockTimeoutMs(MAX_uint32)
+        , BufferSize(128 * 1024)
+        , MaxOverflowSize(8 * 1024 * 1024)
+        , RotateSize(0)
+        , RotateIntervalSec(0.0)
+        , bCompressSegments(false)
+        , bCompressLive(false)
+        , bMemoryMapped(false)
+        , bVectoredIO(false)
+        , bCoalesceRepeats(false)
+        , RepeatIntervalSec(1.0)
+        , IndexBlockSize(0)
+        , bBinary(false)
+    {
+    }
+
+    static FLogWriterSettings FromCommandLine()
+    {
+        FLogWriterSettings Settings;
+
+        FString PolicyName;
+        if (FParse::Value(FCommandLine::Get(), TEXT("LOGBACKPRESSURE="), PolicyName))
+        {
+            for (int32 Policy = ELogBackpressure::Block; Policy <= ELogBackpressure::Grow; ++Policy)
+            {
+                if (PolicyName.Equals(GetPolicyName((ELogBackpressure::Type)Policy), ESearchCase::IgnoreCase))
+                {
+                    Settings.BackpressurePolicy = (ELogBackpressure::Type)Policy;
+                }
+            }
+        }
+
+        FParse::Value(FCommandLine::Get(), TEXT("LOGBLOCKTIMEOUT="), Settings.BlockTimeoutMs);
+
+        int32 SizeKB = 0;
+        if (FParse::Value(FCommandLine::Get(), TEXT("LOGBUFFERSIZE="), SizeKB))
+        {
+            Settings.BufferSize = FMath::Clamp(SizeKB, 4, 256 * 1024) * 1024;
+        }
+
+        if (FParse::Value(FCommandLine::Get(), TEXT("LOGOVERFLOWCAP="), SizeKB))
+        {
+            Settings.MaxOverflowSize = FMath::Clamp(SizeKB, 0, 1024 * 1024) * 1024;
+        }
+
+        int32 RotateSizeMB = 0;
+        if (FParse::Value(FCommandLine::Get(), TEXT("LOGROTATESIZE="), RotateSizeMB))
+        {
+            Settings.RotateSize = (int64)FMath::Max(RotateSizeMB, 0) * 1024 * 1024;
+        }
+
+        float RotateInterval = 0.0f;
+        if (FParse::Value(FCommandLine::Get(), TEXT("LOGROTATEINTERVAL="), RotateInterval))
+        {
+            Settings.RotateIntervalSec = FMath::Max(RotateInterval, 0.0f);
+        }
+
+        Settings.bCompressLive = FParse::Param(FCommandLine::Get(), TEXT("LOGCOMPRESSLIVE"));
+        Settings.bCompressSegments = !Settings.bCompressLive && FParse::Param(FCommandLine::Get(), TEXT("LOGCOMPRESS"));
+        Settings.bMemoryMapped = LOGMANAGER_WITH_MMAP && !Settings.bCompressLive && FParse::Param(FCommandLine::Get(), TEXT("LOGMMAP"));
+        Settings.bVectoredIO = LOGMANAGER_WITH_PWRITEV && !Settings.bMemoryMapped && FParse::Param(FCommandLine::Get(), TEXT("LOGPWRITEV"));
+
+        Settings.bCoalesceRepeats = FParse::Param(FCommandLine::Get(), TEXT("LOGCOALESCE"));
+        float RepeatInterval = 0.0f;
+        if (FParse::Value(FCommandLine::Get(), TEXT("LOGREPEATINTERVAL="), RepeatInterval))
+        {
+            Settings.RepeatIntervalSec = FMath::Max(RepeatInterval, 0.01f);
+        }
+
+        int32 IndexBlockKB = 0;
+        if (FParse::Value(FCommandLine::Get(), TEXT("LOGINDEXKB="), IndexBlockKB))
+        {
+            Settings.IndexBlockSize = FMath::Clamp(IndexBlockKB, 0, 1024 * 1024) * 1024;
+        }
+
+        return Settings;
+    }
+
+    static const TCHAR* GetPolicyName(ELogBackpressure::Type Policy)
+    {
+        switch (Policy)
+        {
+        case ELogBackpressure::Block:
+            return TEXT("Block");
+        case ELogBackpressure::DropNewest:
+            return TEXT("DropNewest");
+        case ELogBackpressure::DropLowestVerbosity:
+            return TEXT("DropLowestVerbosity");
+        case ELogBackpressure::Grow:
+            return TEXT("Grow");
+        }
+        return TEXT("Unknown");
+    }
+};
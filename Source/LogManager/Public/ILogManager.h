@@ -3,7 +3,134 @@
 #pragma once
 
 #include "ModuleManager.h"
+#include "Misc/DateTime.h"
 
+/** What a log writer does with a new line when its queue is full */
+namespace ELogBackpressure
+{
+    enum Type
+    {
+        /** Wait for the writer to make room, up to the block timeout, then drop the line */
+        Block,
+        /** Drop the line right away */
+        DropNewest,
+        /** Drop verbose lines first as the queue fills up, wait like Block for errors */
+        DropLowestVerbosity,
+        /** Queue the line on the heap, up to the overflow cap, then drop it */
+        Grow
+    };
+}
+
+/** Which old session log folders are deleted, see ILogManager::ApplyLogRetention */
+struct FLogRetentionPolicy
+{
+    /** Most session folders kept, the current one included, negative for no limit */
+    int32 MaxSessions;
+    /** Most bytes the session folders may take together, newer sessions are kept first, 0 for no limit */
+    int64 MaxTotalBytes;
+    /** Sessions not written to for longer than this are deleted, 0 for no limit */
+    double MaxAgeDays;
+
+    FLogRetentionPolicy()
+        : MaxSessions(-1)
+        , MaxTotalBytes(0)
+        , MaxAgeDays(0.0)
+    {
+    }
+};
+
+/** What ILogManager::QueryLogIndex looks for, a line has to match every field */
+struct FLogIndexQuery
+{
+    /** Time range, local time like the timestamps printed in the log */
+    FDateTime From;
+    FDateTime To;
+    /** Frame counter range */
+    uint64 FirstFrame;
+    uint64 LastFrame;
+    /** Least severe verbosity wanted, e.g. Warning for fatal errors, errors and warnings */
+    ELogVerbosity::Type MaxVerbosity;
+
+    FLogIndexQuery()
+        : From(FDateTime::MinValue())
+        , To(FDateTime::MaxValue())
+        , FirstFrame(0)
+        , LastFrame(MAX_uint64)
+        , MaxVerbosity(ELogVerbosity::VeryVerbose)
+    {
+    }
+};
+
+/** Byte range of a log file */
+struct FLogFileRange
+{
+    int64 Offset;
+    int64 Length;
+};
+
+/** Counters of one log file since it was opened, see ILogManager::GetWriterStats */
+struct FLogWriterStats
+{
+    /** Category or sink name of the filter, empty for the default log file */
+    FString Category;
+    /** Segment currently written */
+    FString Filename;
+
+    /** Lines written to the file, raw writes like the byte order mark included */
+    int64 LinesWritten;
+    /** Bytes handed to the file */
+    int64 BytesWritten;
+    /** Size of the ring buffer in bytes */
+    int64 BufferCapacity;
+    /** Most bytes queued in the ring buffer at once, as seen by the writer or by a client finding it full */
+    int64 PeakBufferOccupancy;
+    /** Times the writer's scratch buffers had to grow */
+    int64 BufferResizes;
+    /** Records spilled over to the heap by the Grow policy */
+    int64 OverflowRecords;
+
+    /** Times a client waited in a flush for the writer to catch up, and the total time spent waiting */
+    int64 FlushStalls;
+    double FlushStallSeconds;
+    /** Times a client waited for room in a full ring buffer, and the total time spent waiting */
+    int64 FullBufferWaits;
+    double FullBufferWaitSeconds;
+
+    /** Flushes of the file archive, their total and longest duration */
+    int64 ArchiveFlushes;
+    double ArchiveFlushSeconds;
+    double MaxArchiveFlushSeconds;
+
+    /** Lines dropped by the backpressure policy */
+    int64 DroppedLines;
+    /** Lines rejected by the rate limit */
+    int64 RejectedLines;
+    /** Lines sampled out */
+    int64 SampledOutLines;
+    /** Lines dropped while the filter was disabled */
+    int64 DisabledLines;
+
+    FLogWriterStats()
+        : LinesWritten(0)
+        , BytesWritten(0)
+        , BufferCapacity(0)
+        , PeakBufferOccupancy(0)
+        , BufferResizes(0)
+        , OverflowRecords(0)
+        , FlushStalls(0)
+        , FlushStallSeconds(0.0)
+        , FullBufferWaits(0)
+        , FullBufferWaitSeconds(0.0)
+        , ArchiveFlushes(0)
+        , ArchiveFlushSeconds(0.0)
+        , MaxArchiveFlushSeconds(0.0)
+        , DroppedLines(0)
+        , RejectedLines(0)
+        , SampledOutLines(0)
+        , DisabledLines(0)
+    {
+    }
+};
 
 /**
  * The public interface to this module.  In most cases, this interface is only public to sibling modules
@@ -37,11 +164,47 @@ public:
 
     /**
      * @brief Adds a log filter to the list of filters.
+     * There is no limit on the number of log files, but lines going to log files past the first 63, the default one included,
+     * match the routing rules again for every line instead of once per category.
      * @param Category - category name
      * @param FlushOn - flush log to file immediately when log level >= FlushOn
      */
     virtual void AddFilter(const FString& Category, ELogVerbosity::Type FlushOn) = 0;
 
+    /**
+     * @brief Routes every category matching a pattern to one or more log files, on top of the categories' own filters.
+     * Lines of a category matched by no filter or rule go to the default log file. Sinks count towards the log files
+     * of AddFilter.
+     * @param Pattern - case-insensitive category pattern, '*' matches any run of characters, e.g. "LogNet*"
+     * @param Sinks - names of the log files the lines go to, created as needed
+     * @param FlushOn - flush level of the log files created
+     */
+    virtual void AddRoute(const FString& Pattern, const TArray<FString>& Sinks, ELogVerbosity::Type FlushOn) = 0;
+
+    /**
+     * @brief Removes the routing rules of a pattern, and closes the log files no other rule routes to.
+     * @param Pattern - pattern passed to AddRoute
+     */
+    virtual void RemoveRoute(const FString& Pattern) = 0;
+
+    /**
+     * @brief Removes a log filter and closes its file, the category's lines go to the default log file again.
+     * @param Category - category name
+     */
+    virtual void RemoveFilter(const FString& Category) = 0;
+
+    /**
+     * @brief Lets a disabled log filter write its category's lines again.
+     * @param Category - category name, empty for the default log file
+     */
+    virtual void EnableFilter(const FString& Category) = 0;
+
+    /**
+     * @brief Drops a log filter's lines until it is enabled again, its file stays open.
+     * @param Category - category name, empty for the default log file
+     */
+    virtual void DisableFilter(const FString& Category) = 0;
+
 	/**
 	 * @brief Change a log category's flush-on log level.
 	 * @param Category - category name
@@ -49,14 +212,89 @@ public:
 	 */
 	virtual void ChangeLogFlushOnLevel(const FString& Category, ELogVerbosity::Type FlushOn) = 0;
 
+	/**
+	 * @brief Change what a log category's file does with new lines when its queue is full.
+	 * @param Category - category name, empty for the default log file
+	 * @param Policy - backpressure policy
+	 */
+	virtual void SetBackpressurePolicy(const FString& Category, ELogBackpressure::Type Policy) = 0;
+
+	/**
+	 * @brief Limit the rate of lines written to a log category's file, lines over the limit are counted and reported.
+	 * @param Category - category name, empty for the default log file
+	 * @param LinesPerSecond - sustained rate, 0 to remove the limit
+	 * @param Burst - lines allowed back to back after a quiet period
+	 */
+	virtual void SetRateLimit(const FString& Category, float LinesPerSecond, int32 Burst) = 0;
+
+	/**
+	 * @brief Write only a random share of a log category's lines, the others are counted and reported.
+	 * @param Category - category name, empty for the default log file
+	 * @param KeepRatio - share of the lines kept, 1 keeps every line
+	 */
+	virtual void SetSampling(const FString& Category, float KeepRatio) = 0;
+
     /**
      * @brief Gets current absolute log directory.
      */
     virtual const FString& GetCurrentLogDir() const = 0;
 
     /**
-     * @brief Remains the number of log folders to LogFolderCount.
+     * @brief Remains the number of log folders to LogFolderCount, the current one included, in the background.
+     * Folders still being written by another running instance are never deleted.
      */
     virtual void RemainsLogCount(int32 LogFolderCount) = 0;
+
+    /**
+     * @brief Deletes the old session log folders the policy doesn't keep, in the background. The current session is always kept,
+     * and so are the sessions of other instances still running.
+     * @param Policy - session count, total size and age limits
+     */
+    virtual void ApplyLogRetention(const FLogRetentionPolicy& Policy) = 0;
+
+    /**
+     * @brief Asks every log file to be flushed to disk without waiting for it.
+     * @return ticket to pass to WaitForFlush
+     */
+    virtual int64 RequestFlush() = 0;
+
+    /**
+     * @brief Waits until the flush identified by Ticket, and every flush requested before it, is on disk.
+     * @param Ticket - ticket returned by RequestFlush
+     * @param WaitTimeMs - maximum time to wait in milliseconds, MAX_uint32 to wait forever
+     * @return false if the time ran out first
+     */
+    virtual bool WaitForFlush(int64 Ticket, uint32 WaitTimeMs = MAX_uint32) = 0;
+
+    /**
+     * @brief Gets the counters of every open log file, the default log file first. Cheap enough to call every frame.
+     * @param OutStats - receives one entry per log file
+     */
+    virtual void GetWriterStats(TArray<FLogWriterStats>& OutStats) const = 0;
+
+    /**
+     * @brief Turns a binary log file (-LOGBINARY) back into a text log file.
+     * @param BinaryFilename - binary log file, compressed or not
+     * @param TextFilename - text log file to write
+     * @return false if the file couldn't be read or decoded completely
+     */
+    virtual bool DecodeBinaryLog(const FString& BinaryFilename, const FString& TextFilename) = 0;
+
+    /**
+     * @brief Writes the lines kept by a flight recorder file, e.g. one left behind by a crashed session, to a text log file.
+     * @param RecorderFilename - FlightRecorder.bin of a session directory
+     * @param TextFilename - text log file to write
+     * @return false if the file couldn't be read or isn't a flight recorder file
+     */
+    virtual bool RecoverFlightRecorder(const FString& RecorderFilename, const FString& TextFilename) = 0;
+
+    /**
+     * @brief Finds the parts of a text log file that may hold lines matching a query, using the index written next to it.
+     * @param LogFilename - log file, or one of its rotated segments
+     * @param Query - time, frame and verbosity the lines have to match
+     * @param OutRanges - receives the byte ranges to read, in file order, a tail the index doesn't cover yet is always included
+     * @return false if the file has no usable index and has to be read whole
+     */
+    virtual bool QueryLogIndex(const FString& LogFilename, const FLogIndexQuery& Query, TArray<FLogFileRange>& OutRanges) const = 0;
 };
 